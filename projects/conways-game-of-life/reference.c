@@ -4,22 +4,54 @@
  * More info at: https://en.wikipedia.org/wiki/Conway%27s_Game_of_Life
  *
  * Converted to C from Python original by Al Sweigart
+ *
+ * Build: gcc -O2 -pthread reference.c -o life
  */
 
+// Ask the C library for POSIX/GNU extensions such as pthread barriers
+#define _GNU_SOURCE
+
 #include <stdio.h>      // Standard I/O functions: printf, putchar
-#include <stdlib.h>     // Standard library: rand, srand, system, exit
-#include <string.h>     // String functions: memcpy
-#include <time.h>       // Time functions: time (for seeding random)
+#include <stdlib.h>     // Standard library: rand, srand, aligned_alloc, free, atoi
+#include <string.h>     // String functions: memcpy, memset, strcmp
+#include <stdint.h>     // Fixed-width integers: uint64_t (packed grid words)
+#include <stddef.h>     // size_t for buffer offsets on very large boards
+#include <limits.h>     // LLONG_MAX: an empty bounding box
+#include <time.h>       // Time functions: time (for seeding random), clock_nanosleep
 #include <signal.h>     // Signal handling: signal, SIGINT (for Ctrl-C)
-#include <unistd.h>     // POSIX functions: sleep
+#include <unistd.h>     // POSIX functions: sysconf, write, isatty
+#include <pthread.h>    // POSIX threads: pthread_create, pthread_barrier_wait
+#include <stdatomic.h>  // C11 atomics for the work-stealing deques
+#include <setjmp.h>     // setjmp/longjmp: HashLife recovers from a full node cache
+#include <errno.h>      // errno, EINTR: retrying an interrupted write
+#include <poll.h>       // poll: wait for a key or the next frame
+#include <termios.h>    // tcgetattr/tcsetattr: read keys without Enter
+#include <sys/ioctl.h>  // ioctl(TIOCGWINSZ): terminal size for --view
+#include <fcntl.h>      // open: pattern files
+#include <sys/stat.h>   // fstat: size of a pattern file
+#include <sys/mman.h>   // mmap: read pattern files in place
+#include <sys/uio.h>    // writev: flush several dump buffers in one call
+
+// x86 only: CPU feature detection and SIMD intrinsics for the vector kernels
+// The kernels are compiled with per-function target attributes, so the
+// program still builds with plain "gcc reference.c" and runs on any x86-64
+#if defined(__x86_64__) || defined(__i386__)
+#define HAVE_X86_SIMD 1
+#include <cpuid.h>      // __get_cpuid, __get_cpuid_count
+#include <immintrin.h>  // SSE2/AVX2/AVX-512 intrinsics
+#endif
 
 // ============================================================================
 // CONSTANTS
 // ============================================================================
 
-// Grid dimensions - these define the simulation space
-#define WIDTH 79        // Number of cells horizontally (fits terminal width)
-#define HEIGHT 20       // Number of cells vertically
+// Default grid dimensions - override at runtime with --size WIDTHxHEIGHT
+#define DEFAULT_WIDTH 79    // Number of cells horizontally (fits terminal width)
+#define DEFAULT_HEIGHT 20   // Number of cells vertically
+
+// Grid buffers are aligned to, and rows padded to a multiple of, one
+// cache line so that rows never share a line and vector loads line up
+#define CACHE_LINE 64
 
 // Character representations for cells
 // Note: In C, we use char to represent single characters
@@ -28,264 +60,9605 @@
 #define ALIVE '#'       // Living cell representation
 #define DEAD ' '        // Dead cell representation
 
+// Generations rules (--rule /2/3) give a cell that stops living a few
+// dying states before it is dead. Dying state s (2, 3, ...) is stored as
+// the char with code s - 1, which keeps clear of ALIVE and DEAD
+#define GENERATIONS_MAX_STATES 32
+#define DYING(s) ((char)((s) - 1))
+
+// Packed storage: one bit per cell, 64 cells per uint64_t word
+// Cell x of a row lives in word x / 64 at bit position x % 64
+#define WORD_BITS 64
+
+// Tile size for change tracking and --schedule steal, in cells
+// TILE_WIDTH is a multiple of 64 so packed tiles always own whole words
+#define TILE_WIDTH 256
+#define TILE_HEIGHT 64
+
 // ============================================================================
 // GLOBAL VARIABLES
 // ============================================================================
 
-// The game state is stored in a 2D character array
-// In C, we use static arrays allocated on the stack for simplicity
-// cells[y][x] gives us the cell at position (x, y)
-// We store by [y][x] (row-major order) which is more cache-friendly in C
-char cells[HEIGHT][WIDTH];      // Current generation
-char nextCells[HEIGHT][WIDTH];  // Next generation being calculated
+// Board size in cells, chosen at startup
+int width = DEFAULT_WIDTH;
+int height = DEFAULT_HEIGHT;
+
+// The game state is stored in heap-allocated character grids
+// Rows are stored one after another (row-major order), which is the most
+// cache-friendly layout in C. Every row has one extra "ghost" cell on each
+// side, and there is one extra ghost row above and below the board:
+//
+//     ghost row   (copy of the last row)
+//     G cells G   (G = copy of the cell at the other end of the row)
+//     ...
+//     ghost row   (copy of the first row)
+//
+// With the ghosts refreshed once per generation, the neighbors of every
+// cell are simply the surrounding bytes: no modulo, no bounds checks.
+// Use cellRow() to get a pointer to cell (0, y) of a grid.
+char *cells = NULL;         // Current generation
+char *nextCells = NULL;     // Next generation being calculated
+size_t stride;              // Bytes per row, a multiple of CACHE_LINE
+
+// The same two generations in packed form (used by STORAGE_PACKED)
+// Each row takes wordsPerRow words instead of width bytes: 8x less memory.
+// Packed grids have ghost rows above and below; left/right wraparound is
+// handled with bit shifts (see packedWest/packedEast). Use packedRow().
+uint64_t *packedCells = NULL;
+uint64_t *packedNextCells = NULL;
+int wordsPerRow;            // Words holding real cells in each row
+size_t packedStride;        // Words per row, a multiple of one cache line
+uint64_t lastWordMask;      // Bits of the last word that hold real cells
+
+// The same two generations as sorted lists of live cells (STORAGE_SPARSE)
+// A cell is stored as the key y * width + x, so sorting the keys sorts
+// the cells row by row. Memory and step time grow with the population,
+// not with the board area, which pays off below about 1% density
+uint64_t *liveCells = NULL;         // Current generation
+uint64_t *nextLiveCells = NULL;     // Next generation being calculated
+size_t numLiveCells;
+size_t numNextLiveCells;
+size_t liveCapacity;                // Keys that fit in each list
+uint64_t *neighborKeys = NULL;      // Scratch for stepSparse: two halves,
+size_t neighborCapacity;            // sorted back and forth by radixSort
+
+// Temporal blocking (--temporal K, packed storage only)
+// A plain step streams the whole board through memory once per
+// generation. With K > 1 the board is cut into blocks instead; each block
+// is copied with a halo of K cells into a small per-thread buffer,
+// advanced K generations there while it stays in cache, and only then
+// written back, so DRAM sees one pass over the board every K generations.
+// The halo is one word wide, which caps K at 64
+#define TEMPORAL_WORDS 32               // Block width in words (2048 cells)
+#define TEMPORAL_ROWS 128               // Block height in rows
+#define TEMPORAL_MAX_DEPTH WORD_BITS
+#define TEMPORAL_STRIDE (TEMPORAL_WORDS + 4)    // Pad, halo, block, halo, pad
+#define TEMPORAL_MAX_ROWS (TEMPORAL_ROWS + 2 * TEMPORAL_MAX_DEPTH)
+int temporalDepth = 1;                  // Generations per calculateNextGeneration()
+uint64_t *temporalScratch = NULL;       // Two block buffers per thread
+
+// Unbounded plane (STORAGE_CHUNKED): no wraparound at all
+// The plane is cut into CHUNK_SIZE x CHUNK_SIZE chunks of packed cells,
+// and only chunks with live cells (or about to get some) exist. They are
+// found through an open-addressing hash map keyed by chunk coordinates
+// and recycled through a pool, so memory follows the live area rather
+// than its bounding box. The board (width x height from cell (0, 0)) is
+// only the window that is seeded and printed
+#define CHUNK_SIZE 64       // One uint64_t per chunk row
+// Aligning the rows pads the struct to whole cache lines, as aligned_alloc requires
+struct Chunk {
+    _Alignas(CACHE_LINE) uint64_t rows[2][CHUNK_SIZE];  // Two generations; chunkCurrent picks one
+    int32_t cx, cy;                 // Chunk coordinates: cell x / CHUNK_SIZE, rounded down
+    struct Chunk *nextFree;         // Link while the chunk sits in the pool
+};
+struct Chunk **chunkMap = NULL;     // Linear probing; NULL marks an empty slot
+size_t chunkMapCapacity;            // Slots, a power of two
+size_t numChunks;
+struct Chunk *chunkPool = NULL;     // Free chunks, kept for reuse
+size_t numPooledChunks;
+int chunkCurrent;                   // rows[chunkCurrent] is the current generation
+struct Chunk **chunkList = NULL;    // The chunks being stepped this generation
+size_t chunkListCapacity;
+
+// Which representation the simulation runs on
+// STORAGE_CHAR is the original one-char-per-cell reference implementation
+enum StorageMode {
+    STORAGE_CHAR,       // cells/nextCells, one char per cell
+    STORAGE_PACKED,     // packedCells/packedNextCells, one bit per cell
+    STORAGE_SPARSE,     // liveCells/nextLiveCells, one key per live cell
+    STORAGE_CHUNKED     // chunkMap, an unbounded plane of 64x64 chunks
+};
+enum StorageMode storageMode = STORAGE_CHAR;
+
+// Instruction set levels, ordered from narrowest to widest
+enum CpuLevel {
+    CPU_BASELINE,       // Plain C, runs anywhere
+    CPU_SSE2,           // 16 cells per instruction
+    CPU_AVX2,           // 32 cells per instruction
+    CPU_AVX512          // 64 cells per instruction (needs AVX-512BW)
+};
+
+// What a step kernel learned about the region it just wrote
+// The box is inclusive and empty (min > max) while population is 0
+struct RegionStats {
+    long long population;   // Live cells in the region of nextCells (--stats only)
+    long long changed;      // Cells that differ between cells and nextCells (--stats only)
+    long long xMin, yMin;   // Box around the live cells of the region
+    long long xMax, yMax;
+};
+#define EMPTY_REGION { 0, 0, LLONG_MAX, LLONG_MAX, LLONG_MIN, LLONG_MIN }
+
+// A step kernel for the char grid: reads the rectangle of cells from
+// (xBegin, yBegin) up to but not including (xEnd, yEnd) and writes the
+// same rectangle of nextCells. Kernels only write their own rectangle,
+// so several threads can run one kernel on different regions at once.
+// The ghost cells of cells must be fresh when it is called
+typedef struct RegionStats (*StepKernel)(int xBegin, int yBegin, int xEnd, int yEnd);
+
+// Every char kernel, with the instruction set it needs
+struct KernelInfo {
+    const char *name;
+    StepKernel step;
+    enum CpuLevel level;
+};
+
+// Kernels used by calculateNextGeneration for STORAGE_CHAR and
+// STORAGE_PACKED. Chosen once at startup by selectKernel()
+StepKernel charKernel = NULL;
+StepKernel packedKernel = NULL;
+const char *charKernelName = NULL;
+
+// The rule (--rule, or the rule of a pattern or checkpoint), compiled by
+// compileRule() into tables every kernel can use without branching.
+// lifeRule is a bit mask: bit n = birth on n live neighbors, bit 16 + n =
+// survival on n. The kernels keep a hard-wired copy of B3/S23 and only
+// read the tables when the rule is something else
+#define CONWAY_RULE ((1u << 3) | (1u << (16 + 2)) | (1u << (16 + 3)))   // B3/S23
+#define RULE_SURVIVAL(n) (1u << (16 + (n)))
+#define RULE_BIRTH(n) (1u << (n))
+uint32_t lifeRule = CONWAY_RULE;
+int ruleStates = 2;                     // More than 2: a Generations rule
+int ruleGiven = 0;                      // --rule was given; patterns and checkpoints must agree
+char ruleText[64] = "B3/S23";           // Canonical rulestring
+char ruleTable[256][9];                 // Next char of a cell, by its char and live neighbor count
+char ruleBirthLanes[16];                // Byte n = 0xFF if a dead cell with n neighbors is born
+char ruleSurvivalLanes[16];             // Byte n = 0xFF if a live cell with n neighbors survives
+uint64_t ruleBirthWords[9];             // All ones if a dead cell with n neighbors is born
+uint64_t ruleFlipWords[9];              // All ones where survival on n differs from birth on n
+
+// Larger-than-Life rules (--rule R5,C0,M1,S34..58,B34..45,NM) count the
+// live cells in the (2r+1)x(2r+1) box around a cell, the cell itself
+// only with M1. A cell is born or survives when its count lies in the
+// range. They replace the kernels with the summed-area engine (see
+// stepLtlWorker); radius 0 means a range-1 rule from above
+#define LTL_MAX_RADIUS 500
+struct LtlRule {
+    int radius;
+    int middle;                         // The cell counts itself (M1)
+    int birthMin, birthMax;
+    int survivalMin, survivalMax;
+};
+struct LtlRule ltlRule = { 0, 0, 0, 0, 0, 0 };
+uint32_t *ltlSums = NULL;               // Summed-area table of the wrapped board
+size_t ltlSumsStride;                   // Entries per row of ltlSums
+pthread_barrier_t ltlPhase;             // Between the table passes and the step
+
+// Lookup table for the lut kernel, built at startup by buildLifeTable()
+// Index: a 4x4 block of cells, bit 4 * row + column. Entry: the next
+// state of the middle 2x2 cells in bits 0-3 (row by row), and how many
+// of them are alive in bits 4-6. 64 KB, small enough to stay in L2
+uint8_t lifeTable[1 << 16];
+
+// Worker pool for --threads: numThreads - 1 helper threads plus the main
+// thread each step one band of rows. The helpers are created once and
+// reused for every generation; two barriers mark the start and the end of
+// each step, so no thread reads a generation while another still writes it
+int numThreads = 1;
+pthread_t *workers = NULL;
+pthread_barrier_t stepStart;    // Main thread releases the workers
+pthread_barrier_t stepDone;     // Everyone has finished their band
+int poolShutdown = 0;           // Read by the workers after stepStart
+pthread_mutex_t poolGateLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t poolGateChanged = PTHREAD_COND_INITIALIZER;
+int poolGate = 0;               // New workers wait while 0; 1 runs them, -1 sends them home
+
+// How the work of one generation is split between the threads
+enum Schedule {
+    SCHEDULE_BANDS,     // One fixed band of rows (or run of tiles) per thread
+    SCHEDULE_STEAL      // Tiles in per-thread deques, idle threads steal
+};
+enum Schedule schedule = SCHEDULE_BANDS;
+
+// Active-region tracking (--track-changes, on by default)
+// A tile is only stepped if it or one of its 8 neighbor tiles changed in
+// the last generation. After the first chaos of a random soup most of the
+// board is empty or still, so most tiles are skipped outright
+int trackChanges = 1;
+
+// Tile bookkeeping for change tracking and SCHEDULE_STEAL
+int tileCols;                           // Tiles across the board
+int tileRows;                           // Tiles down the board
+int numTiles;
+unsigned char *tileChanged = NULL;      // Tile differs between cells and the generation before
+unsigned char *tileChangedNext = NULL;  // Tile differs between nextCells and cells
+int *activeTiles = NULL;            // Tiles to step this generation
+int numActiveTiles;
+
+// A work-stealing deque (Chase-Lev) holding tile numbers
+// The owner pops from the bottom, thieves take from the top. The tiles of
+// a generation are all pushed before the workers start, so the deques
+// never grow while they are being used. Each deque gets its own cache
+// line so the owner and the thieves do not fight over unrelated counters
+struct TileDeque {
+    _Alignas(CACHE_LINE) atomic_long top;
+    atomic_long bottom;
+    int *tiles;
+};
+struct TileDeque *deques = NULL;    // One per thread
+int *dequeStorage = NULL;           // numThreads * numTiles slots
+
+// HashLife (--hashlife N) stores the board as a hash-consed quadtree.
+// A node of level k is a 2^k x 2^k square built from four level k-1
+// quadrants; level 0 nodes are single cells. Identical squares are stored
+// only once, and every node remembers its own future (result), so a
+// pattern that repeats in space or in time is only ever computed once.
+// Nodes are referred to by their index in hashNodes
+struct HashNode {
+    uint32_t nw, ne, sw, se;    // Quadrants (unused for level 0)
+    uint32_t next;              // Next node in the hash chain or free list
+    uint32_t result;            // Memoized hashSuccessor result
+    uint8_t level;              // HASH_FREE while on the free list
+    int8_t resultStep;          // log2 of the generations result is for, -1 = none
+    uint8_t marked;             // Reachable, during garbage collection
+};
+#define HASH_NONE UINT32_MAX    // "No node"
+#define HASH_FREE 0xFF          // level of a node on the free list
+#define HASH_MAX_LEVEL 66       // 2^64 generations need levels up to 66
+
+struct HashNode *hashNodes = NULL;
+uint32_t hashCapacity;              // Node slots that fit in the cache cap
+uint32_t hashUsed;                  // Slots handed out so far
+uint32_t hashLiveNodes;             // Slots not on the free list
+uint32_t hashFreeList = HASH_NONE;  // Slots released by garbage collection
+uint32_t *hashBuckets = NULL;       // Hash table heads, chained through next
+uint32_t hashBucketMask;
+uint32_t hashEmpty[HASH_MAX_LEVEL]; // Canonical all-dead node of each level
+uint32_t hashRoot;                  // The board, a node of level hashRootLevel
+int hashRootLevel;
+jmp_buf *hashOutOfMemory;           // Where to go when the cache is full
+
+// Memory cap for the HashLife node cache, set with --node-cache MB
+size_t nodeCacheMegabytes = 512;
+
+// Generations to fast-forward with HashLife before stepping (--hashlife)
+unsigned long long hashLifeGenerations = 0;
+
+// How frames reach the terminal (--render)
+enum RenderMode {
+    RENDER_DIFF,        // drawFrame: redraw only the cells that changed
+    RENDER_FULL         // clearScreen + printGrid: the original putchar loop
+};
+enum RenderMode renderMode = RENDER_DIFF;
+
+// State of the differential renderer
+// The renderer draws a screen of screenCols x screenRows glyphs (Unicode
+// code points). shownGlyphs holds what is on the terminal now, so each
+// frame only moves the cursor to glyphs that differ from it. The whole
+// frame is assembled in frameBuffer and handed to a single write()
+int screenCols;                     // The board width, or the terminal width with --view
+int screenRows;                     // The board height, or the terminal height minus a status line
+uint32_t *shownGlyphs = NULL;       // screenCols * screenRows, 0 = nothing drawn yet
+uint32_t *renderRowGlyphs = NULL;   // The screen row being drawn
+char *renderRowBuffer = NULL;       // One board row as ALIVE/DEAD chars
+char *frameBuffer = NULL;           // Escapes and UTF-8 glyphs of one frame
+size_t frameCapacity;               // Bytes the worst frame can need
+
+// Simulation and rendering run on separate threads
+// The simulation thread steps the board at --rate generations per second
+// and after each generation copies the board, one bit per cell, into a
+// free slot of a single-producer/single-consumer ring. The main thread
+// draws the newest frame in the ring --fps times a second and skips the
+// older ones; when the ring is full the simulation does not wait but
+// drops the frame. Neither side ever blocks the other, so a slow
+// terminal no longer slows the simulation down
+#define FRAME_SLOTS 4
+struct FrameRing {
+    _Alignas(CACHE_LINE) atomic_size_t head;    // Frames published (written by the simulation)
+    _Alignas(CACHE_LINE) atomic_size_t tail;    // Oldest frame the renderer holds on to
+    uint64_t *bits[FRAME_SLOTS];                // frameRows rows of frameWords words
+    unsigned long long generation[FRAME_SLOTS];
+    uint8_t *blocks[FRAME_SLOTS];               // --view: level 0 of the pyramid
+    uint32_t *pyramid[FRAME_SLOTS];             // --view: levels 1 and up, back to back
+    int windowX[FRAME_SLOTS];                   // --view: board cell of the first bit in bits,
+    int windowY[FRAME_SLOTS];                   // a multiple of WORD_BITS across
+    int windowWidth[FRAME_SLOTS];               // --view: cells in bits, 0 = none
+    int windowHeight[FRAME_SLOTS];
+};
+struct FrameRing frameRing;
+int frameWords;                     // Words per frame row
+int frameRows;                      // Rows per frame: the board, or a --view window
+const uint64_t *shownFrame = NULL;  // The frame being drawn, held by the renderer
+int shownSlot;                      // Its slot in frameRing
+unsigned long long shownGeneration;
+atomic_ullong framesDropped;        // Generations never drawn
+double targetFps = 10;              // --fps
+double simulationRate = 1;          // --rate, generations per second (0 = flat out)
+
+// Zoomed-out viewport (--view) for boards larger than the terminal
+// The screen is a grid of dots, each standing for a zoom x zoom block of
+// cells. A dot's population is counted with popcounts on the frame's
+// words, 64 cells at a time, and a glyph shows a few dots: a 2x4 braille
+// pattern, a 1x2 half block, or for density one ramp character for the
+// share of live cells. Arrow keys or hjkl pan, + and - zoom, 0 fits the
+// whole board again
+enum ViewGlyphs {
+    VIEW_OFF,           // One char per cell, the whole board
+    VIEW_DENSITY,       // " .:-=+*#%@" by population, 1x2 dots
+    VIEW_HALF,          // Upper/lower half blocks, 1x2 dots
+    VIEW_BRAILLE        // Braille patterns, 2x4 dots
+};
+enum ViewGlyphs viewGlyphs = VIEW_OFF;
+int viewZoom = 0;                   // Cells per dot side, 0 = fit the board
+int viewX, viewY;                   // Board cell at the top-left of the screen
+int dotsAcross, dotsDown;           // Dots per glyph
+int *viewCounts = NULL;             // Population of every dot on the screen
+
+// With --view the frames carry no copy of the board. Each one holds a
+// population pyramid instead: level 0 counts the cells of every
+// VIEW_BLOCK x VIEW_BLOCK block, a byte each, and every level above adds
+// up 2x2 blocks of the one below. Dots are counted from the coarsest
+// level whose blocks fit in a dot, a few blocks per dot, so drawing a
+// frame costs the same on any board. Zoomed in closer than one block,
+// a frame also carries the cells around the view, one bit each
+#define VIEW_BLOCK 8
+#define VIEW_LEVELS_MAX 32
+int viewLevels;                                 // Pyramid levels, level 0 included
+int viewLevelCols[VIEW_LEVELS_MAX];             // Blocks across and down each level
+int viewLevelRows[VIEW_LEVELS_MAX];
+size_t viewLevelOffset[VIEW_LEVELS_MAX];        // Of levels 1 and up in pyramid
+uint64_t *viewBlockSums = NULL;                 // Per-byte counts of one row of blocks
+atomic_int wantedViewX, wantedViewY, wantedZoom; // The view, for the simulation thread
+struct termios savedTermios;        // Terminal settings to restore at exit
+int rawTerminal = 0;                // Keys are read one at a time from stdin
+
+// A pattern file mapped into memory (--pattern)
+struct Pattern {
+    const char *data;       // The whole file, mapped read-only
+    size_t length;
+    const char *body;       // First byte after the header
+    int isRle;              // RLE, or plaintext .cells
+    int width, height;      // Size of the pattern's box
+    const char *rule;       // RLE "rule = ..." value, not NUL-terminated
+    size_t ruleLength;
+};
+const char *patternPath = NULL;     // --pattern: seed from this file instead of at random
+struct Pattern pattern;
+const char *savePath = NULL;        // --save: write the final board here as RLE
+
+// Checkpoints (--checkpoint FILE, --restore FILE)
+// A checkpoint file is a one-page header followed by the board laid out
+// exactly like a packed grid buffer: height + 2 rows of packedStride
+// words, ghost rows included. Because the board starts on a page
+// boundary, --restore can mmap it and use the mapping as the packed grid
+// itself; the pages are only read in as the first generation touches them.
+// Checkpoints are taken every --checkpoint-every generations: the
+// simulation copies the board into a snapshot buffer and goes on, and a
+// background thread writes the snapshot out (to FILE.tmp, then renamed
+// over FILE, so a crash never leaves a half-written checkpoint)
+#define CHECKPOINT_MAGIC "LIFECKPT"
+#define CHECKPOINT_VERSION 1
+#define CHECKPOINT_HEADER_BYTES 4096
+struct CheckpointHeader {
+    char magic[8];              // CHECKPOINT_MAGIC, not NUL-terminated
+    uint32_t version;
+    uint32_t headerBytes;       // Where the board starts
+    uint32_t width, height;
+    uint64_t rowWords;          // packedStride of the board
+    uint32_t rule;              // lifeRule the board was run with
+    uint32_t reserved;
+    uint64_t generation;
+};
+const char *checkpointPath = NULL;
+unsigned long long checkpointEvery = 10000;
+unsigned long long nextCheckpoint;      // Generation the next checkpoint is due at
+const char *restorePath = NULL;
+struct CheckpointHeader restoreHeader;  // Read by openCheckpoint
+int restoreFd = -1;
+unsigned long long startGeneration = 0; // Generation of the restored board
+unsigned long long currentGeneration;   // Of the current board, kept by simulationMain
+uint64_t *mappedGrid = NULL;            // A packed grid that is really a checkpoint mapping
+size_t mappedGridBytes;
+
+// The checkpoint writer thread and its one-slot mailbox
+pthread_t checkpointThread;
+pthread_mutex_t checkpointLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t checkpointWake = PTHREAD_COND_INITIALIZER;
+unsigned char *checkpointBuffer = NULL; // Header page + board snapshot
+size_t checkpointBytes;
+int checkpointBusy = 0;                 // A snapshot is waiting or being written
+int checkpointQuit = 0;
+int checkpointWriterRunning = 0;
+
+// Generation dumps (--dump FILE) for offline analysis
+// Every --dump-every generations the simulation encodes the board into
+// one of DUMP_BUFFERS reusable buffers and goes on. A writer thread
+// takes all the filled buffers at once and hands them to a single
+// writev(), so the simulation never waits for the disk. If every buffer
+// is still waiting to be written, the dump is retried on the next
+// generation. Each frame is tagged with its generation
+enum DumpFormat {
+    DUMP_PBM,           // Binary PBM (P4) images, one after another
+    DUMP_RAW            // 8-byte generation, then the rows as 64-bit words
+};
+#define DUMP_BUFFERS 8
+const char *dumpPath = NULL;
+enum DumpFormat dumpFormat = DUMP_PBM;
+unsigned long long dumpEvery = 1;
+unsigned long long nextDump;            // Generation the next dump is due at
+int dumpFd = -1;
+unsigned char *dumpBuffers[DUMP_BUFFERS];
+size_t dumpLengths[DUMP_BUFFERS];       // Bytes of each encoded frame
+size_t dumpCapacity;                    // Bytes each buffer can hold
+uint64_t *dumpScratch = NULL;           // The board as packed rows, for PBM encoding
+pthread_t dumpThread;
+pthread_mutex_t dumpLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t dumpWake = PTHREAD_COND_INITIALIZER;
+size_t dumpHead;                        // Frames encoded (buffers up to here are full)
+size_t dumpTail;                        // Frames written (buffers from here on are full)
+int dumpQuit = 0;
+int dumpWriterRunning = 0;
+int dumpFailed = 0;                     // A write failed; later frames are thrown away
+unsigned long long dumpRetries;         // Dumps put off because every buffer was full
+
+// Cycle detection (--cycles report|stop|jump)
+// Every generation gets a 64-bit hash, kept in a ring of the last
+// CYCLE_HISTORY generations. When a hash turns up again p generations
+// later, and keeps doing so for a whole period, the board is in a
+// period-p cycle (p = 1 is a still life): it can be reported, the run
+// stopped, or whole periods skipped, since the board at generation
+// g + k * p is the board at g. On tiles the hash is the XOR of one hash
+// per tile, so only the tiles that changed are hashed again; other
+// layouts hash the whole board with boardChecksum()
+#define CYCLE_HISTORY 1024      // Longest period that can be found, plus one
+enum CycleMode {
+    CYCLES_OFF,
+    CYCLES_REPORT,      // Say so and go on
+    CYCLES_STOP,        // Say so and stop
+    CYCLES_JUMP         // Skip whole periods up to --generations or --jump-to
+};
+enum CycleMode cycleMode = CYCLES_OFF;
+unsigned long long jumpTarget;          // --jump-to: where an animation jumps to
+uint64_t *tileHashes = NULL;            // Hash of each tile of the last hashed generation
+uint64_t *tileHashesNext = NULL;        // Of each changed tile of nextCells, set by stepTile
+uint64_t tileHashSum;                   // XOR of tileHashes
+struct CycleEntry {
+    unsigned long long generation;
+    uint64_t hash;
+} cycleHistory[CYCLE_HISTORY];
+unsigned long long cycleObservations;   // Generations hashed so far
+int cycleCandidate;                     // Period being confirmed, 0 = none
+unsigned long long candidateSince;      // Observation where it first matched
+atomic_int cyclePeriod;                 // Confirmed period, 0 = none yet
+unsigned long long cycleStart;          // First generation of the cycle
+unsigned long long cycleJumpFrom, cycleJumpTo;  // The jump taken, if any
+
+// Per-generation statistics (--stats FILE)
+// The step kernels count the live cells and the cells that changed, and
+// find the box around the live cells, while they write each region, so
+// the numbers come without a second pass over the board. After a step
+// the regions are added up - bands per thread, or tiles, where a skipped
+// tile keeps the numbers of the last time it was stepped - and one record
+// per generation is appended to FILE. Births and deaths follow from the
+// cells that changed and the change in population
+enum StatsFormat {
+    STATS_CSV,          // A header line, then one line per generation
+    STATS_BINARY        // struct StatsRecord after struct StatsRecord
+};
+const char *statsPath = NULL;
+enum StatsFormat statsFormat = STATS_CSV;
+int collectStats = 0;                   // The kernels also count the cells that changed
+FILE *statsFile = NULL;
+struct RegionStats *workerStats = NULL; // Each thread's band (or temporal blocks)
+struct RegionStats *tileStats = NULL;   // Each tile, as of the last time it was stepped
+struct RegionStats stepStats;           // The whole board, after the last step
+int stepStatsValid = 0;                 // stepStats belongs to the current board
+long long statsPopulation;              // Population in the previous record
+int statsFailed = 0;
+
+// One --stats-format binary record, in the machine's byte order
+// The box is inclusive; it is empty (0, 0, -1, -1) when nothing lives
+struct StatsRecord {
+    uint64_t generation;
+    int64_t population;
+    int64_t births;         // Dead in the previous record, alive now
+    int64_t deaths;         // Alive in the previous record, dead now
+    int64_t xMin, yMin, xMax, yMax;
+};
+
+// Phase timings (--trace FILE, --histograms)
+// Every thread times its phases into a buffer of its own. A buffer has
+// a single writer, so recording takes no lock; the buffers are only read
+// once the threads are done. The timers are always compiled in: while
+// tracing is off each one costs a single relaxed load. SIGUSR1 (or t in
+// the view) switches tracing on and off while the program runs
+enum TracePhase {
+    TRACE_STEP,         // calculateNextGeneration, one whole step
+    TRACE_TILE,         // stepTile, one tile
+    TRACE_BAND,         // stepBand / stepTemporalBand, one thread's band
+    TRACE_WAIT,         // A thread waiting for the others at stepDone
+    TRACE_COPY,         // copyGrid
+    TRACE_CLEAR,        // clearScreen
+    TRACE_PRINT,        // printGrid
+    TRACE_DRAW,         // drawFrame
+    TRACE_CHECKPOINT,   // Writing one checkpoint file
+    TRACE_DUMP,         // Writing a batch of dump buffers
+    TRACE_SOUP,         // One soup of the census, run to the end
+    NUM_TRACE_PHASES
+};
+#define TRACE_EVENTS (1 << 18)  // Events kept per thread; later ones only reach the histograms
+#define TRACE_BUCKETS 40        // Histogram bucket i counts durations in [2^i, 2^(i+1)) ns
+struct TraceEvent {
+    uint64_t start, end;    // Nanoseconds on CLOCK_MONOTONIC
+    int32_t phase;
+    int32_t arg;            // Tile or worker number, -1 for none
+};
+struct TraceBuffer {
+    char name[32];          // Thread name shown in the trace viewer
+    atomic_size_t count;    // Events recorded so far
+    size_t dropped;         // Events that found the buffer full
+    uint64_t histogram[NUM_TRACE_PHASES][TRACE_BUCKETS];
+    uint64_t totalNanos[NUM_TRACE_PHASES];
+    uint64_t longestNanos[NUM_TRACE_PHASES];
+    struct TraceEvent events[TRACE_EVENTS];
+};
+const char *tracePath = NULL;
+int showHistograms = 0;
+int tracePaused = 0;                    // --trace-paused: start with the timers off
+atomic_int tracing = 0;                 // The timers record while this is set
+struct TraceBuffer **traceBuffers = NULL;   // One per thread, in the order they started
+int traceCapacity;
+atomic_int numTraceBuffers = 0;
+uint64_t traceOrigin;                   // Time 0 of the trace
+_Thread_local struct TraceBuffer *threadTrace = NULL;  // This thread's buffer
+
+// Soup census (--census SOUPS): every thread runs random soups on a small
+// torus of its own until they settle, then names the objects left over.
+// The board is CENSUS_SIZE cells square; spaceships that reach the outer
+// CENSUS_BORDER cells are counted and removed before they wrap around.
+// What is left is split into objects that run the same on their own, so
+// neighbouring still lifes and oscillators are counted one by one.
+// Objects are named by apgcode: a prefix (xs<cells> still life, xp<period>
+// oscillator, xq<period> spaceship) and the canonical extended Wechsler
+// form of the object, the same over every phase and orientation
+#define CENSUS_SIZE 256
+#define CENSUS_WORDS (CENSUS_SIZE / WORD_BITS)
+#define CENSUS_BORDER 16
+#define CENSUS_MAX_PERIOD 60            // Longest period looked for
+#define CENSUS_HISTORY 256              // Populations kept for the period test
+#define CENSUS_MAX_GENERATIONS 30000    // A soup still running then counts as unsettled
+#define CENSUS_OBJECT_MAX 128           // Widest and tallest object that is named
+#define CENSUS_PLANE (CENSUS_OBJECT_MAX + 2 * (CENSUS_MAX_PERIOD + 2))
+#define CENSUS_CODE_MAX 4096
+#define CENSUS_SHAPES 4096              // Shapes each thread remembers the names of
+#define CENSUS_PSEUDO_MAX 256           // Biggest still life checked for being made of others
+struct CensusEntry {
+    uint64_t hash;                      // FNV-1a of code; 0 marks a free slot
+    char *code;
+    unsigned long long count;
+};
+struct CensusTable {
+    struct CensusEntry *entries;
+    size_t capacity;                    // A power of two
+    size_t used;
+};
+struct CensusPlane {                    // An object simulated on its own
+    unsigned char *cells[2];            // CENSUS_PLANE cells per row; cells[current] is the object
+    int current;
+    int box[4];                         // x0, y0, x1, y1 of the live cells; empty if x0 > x1
+    int dirty[2][4];                    // Where each of cells may have live cells left
+    int population;
+};
+struct CensusShape {                    // A shape that has been named before
+    uint64_t key;                       // Hash of its cells, see classifyObject; 0 marks a free slot
+    char *code;                         // NULL if it could not be named
+};
+struct CensusWorker {
+    int index;
+    int current;                        // Which of board holds the soup
+    uint64_t board[2][CENSUS_SIZE][CENSUS_WORDS];
+    uint64_t mask[CENSUS_SIZE][CENSUS_WORDS];       // Cells still to be sorted into objects
+    uint64_t partMask[CENSUS_SIZE][CENSUS_WORDS];   // Cells of one group still to be split into parts
+    uint32_t population[CENSUS_HISTORY];            // By generation modulo CENSUS_HISTORY
+    uint32_t live;                      // Population of the current board
+    uint16_t changed[CENSUS_SIZE];      // Per row, the words the last censusStep changed; see censusStepBody
+    int *queue;                         // Flood fill: torus x, y and unwrapped x, y per cell
+    int *partQueue;                     // The same while splitting a group into parts
+    int *partStart;                     // Each part's first cell in partCells, and one past the last
+    int *partCells;                     // Live cells of the parts, unwrapped x, y per cell
+    int *partBox;                       // x0, y0, x1, y1 of each part over all its phases
+    int *partGroup;                     // Union-find of the parts that make one object
+    int *objectCells;                   // One object, unwrapped x, y per cell
+    struct CensusPlane plane[3];
+    unsigned char *firstPhase;          // The object as it started, bounding box only
+    struct CensusShape *shapes;         // CENSUS_SHAPES slots, by key
+    char **codes;                       // Objects settleSoup has named so far
+    size_t numCodes;
+    size_t codeCapacity;
+    char code[CENSUS_CODE_MAX];
+    char candidate[CENSUS_CODE_MAX];
+    char strip[CENSUS_OBJECT_MAX + 1];
+    struct CensusTable table;
+    unsigned long long soups;
+    unsigned long long unsettled;
+    int failed;                         // Out of memory
+};
+int censusSoupSize = 16;                // --soup-size: side of each random soup
+atomic_ullong censusNextSoup;           // Next soup number to hand out
+unsigned long long censusSoups;         // --census: how many soups
+unsigned int censusSeed;
+
+// What runBenchmark measured (--headless)
+struct BenchResult {
+    int generations;        // Generations run: --generations, rounded up to whole --temporal steps
+    int stepped;            // Generations actually computed (fewer after a cycle stop or jump)
+    double seconds;         // Wall time of the stepping alone
+    double jumpSeconds;     // Wall time of the --hashlife jump before it
+    uint64_t checksum;      // boardChecksum() of the final board
+};
 
 // Flag to track if we should exit (set by signal handler)
-volatile sig_atomic_t shouldExit = 0;
+atomic_int shouldExit = 0;
+
+// Set by the simulation thread when memory ran out for the next
+// generation; read after the thread is joined
+int simulationFailed = 0;
 
 // ============================================================================
 // FUNCTION PROTOTYPES
 // ============================================================================
 
-void initializeGrid(void);
+int allocateGrids(int needChar, int needPacked);
+char *allocateCharGrid(void);
+uint64_t *allocatePackedGrid(void);
+void freeGrids(void);
+int initializeGrid(void);
 void printGrid(void);
-void calculateNextGeneration(void);
+int allocateFrames(void);
+void freeFrames(void);
+void captureFrame(uint64_t *bits, size_t rowWords);
+int takeNewestFrame(void);
+void showNewestFrame(void);
+void *simulationMain(void *arg);
+void sleepUntil(double deadline);
+int allocateRenderer(void);
+void freeRenderer(void);
+void drawFrame(void);
+void fitView(void);
+void requestView(void);
+int handleViewKeys(void);
+void waitForFrameTime(double deadline);
+void restoreTerminal(void);
+int calculateNextGeneration(void);
+int stepSparse(void);
+int stepChunks(void);
+void freeChunks(void);
+struct Chunk *findChunk(int32_t cx, int32_t cy);
+struct Chunk *ensureChunk(int32_t cx, int32_t cy);
+int reserveLiveCells(size_t count);
+int sortNextLiveCells(void);
+struct RegionStats calculateNextGenerationChar(int xBegin, int yBegin, int xEnd, int yEnd);
+struct RegionStats calculateNextGenerationPacked(int xBegin, int yBegin, int xEnd, int yEnd);
+struct RegionStats calculateNextGenerationPackedPopcnt(int xBegin, int yBegin, int xEnd, int yEnd);
+struct RegionStats calculateNextGenerationLut(int xBegin, int yBegin, int xEnd, int yEnd);
+struct RegionStats calculateNextGenerationWindow(int xBegin, int yBegin, int xEnd, int yEnd);
+struct RegionStats calculateNextGenerationSse2(int xBegin, int yBegin, int xEnd, int yEnd);
+void buildLifeTable(void);
+int parseRule(const char *text, size_t length, uint32_t *rule, int *states);
+void formatRule(char *text, size_t size, uint32_t rule, int states);
+void setRule(uint32_t rule, int states);
+void compileRule(void);
+int parseLtlRule(const char *text, size_t length, struct LtlRule *rule);
+void formatLtlRule(char *text, size_t size, const struct LtlRule *rule);
+void setLtlRule(const struct LtlRule *rule);
+int allocateLtlSums(void);
+void stepLtlWorker(int worker);
+int verifyLtl(int generations);
+int runCensus(unsigned long long soups, unsigned int seed);
+struct RegionStats calculateNextGenerationAvx2(int xBegin, int yBegin, int xEnd, int yEnd);
+struct RegionStats calculateNextGenerationAvx512(int xBegin, int yBegin, int xEnd, int yEnd);
+enum CpuLevel detectCpuLevel(void);
+int selectKernel(const char *name);
+struct RegionStats stepRegion(int xBegin, int yBegin, int xEnd, int yEnd);
+void stepBand(int worker);
+int allocateTiles(void);
+void freeTiles(void);
+void scheduleTiles(void);
+int usingTiles(void);
+void markAllTilesChanged(void);
+void stepTile(int tile);
+void runTiles(int worker);
+void stepWorker(int worker);
+void stepTemporalBand(int worker);
+uint64_t boardChecksum(void);
+uint64_t hashTile(int tile, int next);
+int hashLifeSupported(void);
+int hashLifeJump(unsigned long long generations);
+int jumpAhead(void);
+void hashCollectGarbage(int keepMemos);
+void *workerMain(void *arg);
+int startWorkerPool(void);
+void stopWorkerPool(void);
 void copyGrid(void);
+void refreshGhostCells(char *grid);
+void refreshPackedGhostRows(uint64_t *grid);
+int verifyKernels(int generations);
+double monotonicSeconds(void);
+const char *kernelLabel(void);
+int runBenchmark(int generations, unsigned int seed, struct BenchResult *result);
+int reportBenchmark(int generations, unsigned int seed);
+int runSweep(int generations, unsigned int seed);
+int verifyPlane(int generations, unsigned int seed);
+void printUsage(const char *programName);
 void handleSignal(int signal);
 void clearScreen(void);
+int openPattern(const char *path, struct Pattern *pattern);
+void closePattern(struct Pattern *pattern);
+int loadPattern(const struct Pattern *pattern);
+int savePattern(const char *path);
+int seedBoard(void);
+int startDumpWriter(void);
+void maybeDump(unsigned long long generation);
+void stopDumpWriter(void);
+int openCheckpoint(const char *path);
+int restoreCheckpoint(void);
+int startCheckpointWriter(void);
+void maybeCheckpoint(unsigned long long generation);
+void stopCheckpointWriter(unsigned long long generation);
+void resetCycles(void);
+unsigned long long watchForCycles(unsigned long long generation, unsigned long long target);
+int describeCycle(char *text, size_t size);
+int openStats(void);
+void recordStats(unsigned long long generation);
+void closeStats(void);
+void gatherStats(void);
+int openTrace(void);
+void traceThread(const char *name);
+uint64_t traceBegin(void);
+void traceEnd(enum TracePhase phase, uint64_t start, int arg);
+void toggleTracing(int signal);
+int finishTrace(void);
 
 // ============================================================================
 // MAIN FUNCTION
 // ============================================================================
 
-int main(void) {
+int main(int argc, char *argv[]) {
+    // Number of generations to cross-check when --verify is given (0 = off)
+    int verifyGenerations = 0;
+
+    // Char kernel requested with --kernel ("auto" = widest the CPU supports)
+    const char *kernelName = "auto";
+
+    // --headless: time the simulation instead of animating it
+    int headless = 0;
+    int sweep = 0;                  // --sweep: CSV over board sizes and thread counts
+    int benchGenerations = 100;     // --generations
+
     // Seed the random number generator with current time
     // time(NULL) returns seconds since Unix epoch (Jan 1, 1970)
-    // This ensures different random patterns each run
-    srand(time(NULL));
+    // This ensures different random patterns each run; --seed makes a
+    // run repeatable
+    unsigned int seed = (unsigned int)time(NULL);
+
+    // Whether --size was given; otherwise a large --pattern grows the board
+    int sizeGiven = 0;
+
+    // Parse command-line options
+    // argv[0] is the program name, so the options start at index 1
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--storage") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "char") == 0) {
+                storageMode = STORAGE_CHAR;
+            } else if (strcmp(argv[i], "packed") == 0) {
+                storageMode = STORAGE_PACKED;
+            } else if (strcmp(argv[i], "sparse") == 0) {
+                storageMode = STORAGE_SPARSE;
+            } else if (strcmp(argv[i], "chunked") == 0) {
+                storageMode = STORAGE_CHUNKED;
+            } else {
+                fprintf(stderr, "Unknown storage mode: %s\n", argv[i]);
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            // sscanf parses "WIDTHxHEIGHT", e.g. "1024x1024"
+            i++;
+            if (sscanf(argv[i], "%dx%d", &width, &height) != 2 || width < 1 || height < 1) {
+                fprintf(stderr, "Invalid board size: %s\n", argv[i]);
+                printUsage(argv[0]);
+                return 1;
+            }
+            sizeGiven = 1;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            // 0 means one thread per online CPU
+            numThreads = atoi(argv[++i]);
+            if (numThreads == 0) {
+                numThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+            }
+            if (numThreads < 1) {
+                fprintf(stderr, "Invalid thread count\n");
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--schedule") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "bands") == 0) {
+                schedule = SCHEDULE_BANDS;
+            } else if (strcmp(argv[i], "steal") == 0) {
+                schedule = SCHEDULE_STEAL;
+            } else {
+                fprintf(stderr, "Unknown schedule: %s\n", argv[i]);
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--track-changes") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "on") == 0) {
+                trackChanges = 1;
+            } else if (strcmp(argv[i], "off") == 0) {
+                trackChanges = 0;
+            } else {
+                fprintf(stderr, "Expected on or off for --track-changes: %s\n", argv[i]);
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--temporal") == 0 && i + 1 < argc) {
+            temporalDepth = atoi(argv[++i]);
+            if (temporalDepth < 1 || temporalDepth > TEMPORAL_MAX_DEPTH) {
+                fprintf(stderr, "Temporal blocking depth must be 1 to %d\n", TEMPORAL_MAX_DEPTH);
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--kernel") == 0 && i + 1 < argc) {
+            kernelName = argv[++i];
+        } else if (strcmp(argv[i], "--rule") == 0 && i + 1 < argc) {
+            // e.g. B36/S23 (HighLife), 23/36, /2/3 (Brian's Brain) or
+            // R5,C0,M1,S34..58,B34..45,NM (Bosco's Rule, Larger than Life)
+            uint32_t rule;
+            int states;
+            struct LtlRule ltl;
+            i++;
+            if (parseRule(argv[i], strlen(argv[i]), &rule, &states)) {
+                setRule(rule, states);
+            } else if (parseLtlRule(argv[i], strlen(argv[i]), &ltl)) {
+                setLtlRule(&ltl);
+            } else {
+                fprintf(stderr, "Invalid rule: %s\n", argv[i]);
+                printUsage(argv[0]);
+                return 1;
+            }
+            ruleGiven = 1;
+        } else if (strcmp(argv[i], "--hashlife") == 0 && i + 1 < argc) {
+            // strtoull handles counts beyond int, e.g. 1073741824 (2^30)
+            hashLifeGenerations = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--node-cache") == 0 && i + 1 < argc) {
+            nodeCacheMegabytes = (size_t)atoi(argv[++i]);
+            if (nodeCacheMegabytes < 1) {
+                fprintf(stderr, "Invalid node cache size\n");
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--render") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "diff") == 0) {
+                renderMode = RENDER_DIFF;
+            } else if (strcmp(argv[i], "full") == 0) {
+                renderMode = RENDER_FULL;
+            } else {
+                fprintf(stderr, "Unknown renderer: %s\n", argv[i]);
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--view") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "braille") == 0) {
+                viewGlyphs = VIEW_BRAILLE;
+            } else if (strcmp(argv[i], "half") == 0) {
+                viewGlyphs = VIEW_HALF;
+            } else if (strcmp(argv[i], "density") == 0) {
+                viewGlyphs = VIEW_DENSITY;
+            } else {
+                fprintf(stderr, "Unknown view: %s\n", argv[i]);
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--zoom") == 0 && i + 1 < argc) {
+            viewZoom = atoi(argv[++i]);
+            if (viewZoom < 1) {
+                fprintf(stderr, "Invalid zoom\n");
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+            targetFps = atof(argv[++i]);
+            if (targetFps <= 0) {
+                fprintf(stderr, "Invalid frame rate\n");
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            simulationRate = atof(argv[++i]);
+            if (simulationRate < 0) {
+                fprintf(stderr, "Invalid generation rate\n");
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--pattern") == 0 && i + 1 < argc) {
+            patternPath = argv[++i];
+        } else if (strcmp(argv[i], "--save") == 0 && i + 1 < argc) {
+            savePath = argv[++i];
+        } else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+            checkpointPath = argv[++i];
+        } else if (strcmp(argv[i], "--checkpoint-every") == 0 && i + 1 < argc) {
+            checkpointEvery = strtoull(argv[++i], NULL, 10);
+            if (checkpointEvery < 1) {
+                fprintf(stderr, "Invalid checkpoint interval\n");
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--restore") == 0 && i + 1 < argc) {
+            restorePath = argv[++i];
+        } else if (strcmp(argv[i], "--dump") == 0 && i + 1 < argc) {
+            dumpPath = argv[++i];
+        } else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc) {
+            statsPath = argv[++i];
+            collectStats = 1;
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            tracePath = argv[++i];
+        } else if (strcmp(argv[i], "--histograms") == 0) {
+            showHistograms = 1;
+        } else if (strcmp(argv[i], "--trace-paused") == 0) {
+            tracePaused = 1;
+        } else if (strcmp(argv[i], "--stats-format") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "csv") == 0) {
+                statsFormat = STATS_CSV;
+            } else if (strcmp(argv[i], "binary") == 0) {
+                statsFormat = STATS_BINARY;
+            } else {
+                fprintf(stderr, "Unknown stats format: %s\n", argv[i]);
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--dump-every") == 0 && i + 1 < argc) {
+            dumpEvery = strtoull(argv[++i], NULL, 10);
+            if (dumpEvery < 1) {
+                fprintf(stderr, "Invalid dump interval\n");
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--dump-format") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "pbm") == 0) {
+                dumpFormat = DUMP_PBM;
+            } else if (strcmp(argv[i], "raw") == 0) {
+                dumpFormat = DUMP_RAW;
+            } else {
+                fprintf(stderr, "Unknown dump format: %s\n", argv[i]);
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--cycles") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "off") == 0) {
+                cycleMode = CYCLES_OFF;
+            } else if (strcmp(argv[i], "report") == 0) {
+                cycleMode = CYCLES_REPORT;
+            } else if (strcmp(argv[i], "stop") == 0) {
+                cycleMode = CYCLES_STOP;
+            } else if (strcmp(argv[i], "jump") == 0) {
+                cycleMode = CYCLES_JUMP;
+            } else {
+                fprintf(stderr, "Unknown cycle mode: %s\n", argv[i]);
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--jump-to") == 0 && i + 1 < argc) {
+            jumpTarget = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--headless") == 0) {
+            headless = 1;
+        } else if (strcmp(argv[i], "--sweep") == 0) {
+            headless = 1;
+            sweep = 1;
+        } else if (strcmp(argv[i], "--census") == 0 && i + 1 < argc) {
+            censusSoups = strtoull(argv[++i], NULL, 10);
+            if (censusSoups < 1) {
+                fprintf(stderr, "Invalid soup count\n");
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--soup-size") == 0 && i + 1 < argc) {
+            censusSoupSize = atoi(argv[++i]);
+            if (censusSoupSize < 1 || censusSoupSize > WORD_BITS) {
+                fprintf(stderr, "Soup size must be 1 to %d\n", WORD_BITS);
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--generations") == 0 && i + 1 < argc) {
+            benchGenerations = atoi(argv[++i]);
+            if (benchGenerations < 0) {
+                fprintf(stderr, "Invalid generation count\n");
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--verify") == 0 && i + 1 < argc) {
+            verifyGenerations = atoi(argv[++i]);
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    // A checkpoint brings its own board size
+    if (restorePath != NULL) {
+        int givenWidth = width;
+        int givenHeight = height;
+        if (patternPath != NULL || sweep) {
+            fprintf(stderr, "--restore cannot be combined with --pattern or --sweep\n");
+            return 1;
+        }
+        if (!openCheckpoint(restorePath)) {
+            return 1;
+        }
+        if (sizeGiven && (width != givenWidth || height != givenHeight)) {
+            fprintf(stderr, "%s holds a %dx%d board, not %dx%d\n",
+                    restorePath, width, height, givenWidth, givenHeight);
+            return 1;
+        }
+    }
+    if ((checkpointPath != NULL || dumpPath != NULL || cycleMode != CYCLES_OFF || statsPath != NULL
+         || tracePath != NULL || showHistograms || hashLifeGenerations > 0) && sweep) {
+        fprintf(stderr, "--checkpoint, --dump, --cycles, --stats, --trace, --histograms and --hashlife"
+                        " cannot be combined with --sweep\n");
+        return 1;
+    }
+
+    // Map the pattern file now: without --size, the board grows to fit it
+    if (patternPath != NULL) {
+        if (!openPattern(patternPath, &pattern)) {
+            return 1;
+        }
+        if (!sizeGiven) {
+            width = pattern.width > width ? pattern.width : width;
+            height = pattern.height > height ? pattern.height : height;
+        }
+        // The pattern's rule applies unless --rule says otherwise
+        if (pattern.rule != NULL) {
+            uint32_t rule;
+            int states;
+            struct LtlRule ltl;
+            char text[sizeof ruleText] = "";
+            if (parseRule(pattern.rule, pattern.ruleLength, &rule, &states)) {
+                formatRule(text, sizeof text, rule, states);
+                if (!ruleGiven) {
+                    setRule(rule, states);
+                }
+            } else if (parseLtlRule(pattern.rule, pattern.ruleLength, &ltl)) {
+                formatLtlRule(text, sizeof text, &ltl);
+                if (!ruleGiven) {
+                    setLtlRule(&ltl);
+                }
+            }
+            if (strcmp(text, ruleText) != 0) {
+                fprintf(stderr, "Warning: %s is for rule %.*s; running it as %s\n",
+                        patternPath, (int)pattern.ruleLength, pattern.rule, ruleText);
+            }
+        }
+    }
+    if (savePath != NULL && sweep) {
+        fprintf(stderr, "--save cannot be combined with --sweep\n");
+        return 1;
+    }
+
+    // Nothing to time without stepping, but --generations 0 after a
+    // HashLife jump gives that board's checksum and --save
+    if (benchGenerations == 0 && (sweep || hashLifeGenerations == 0)) {
+        fprintf(stderr, "--generations 0 needs --hashlife, without --sweep\n");
+        return 1;
+    }
+
+    // An animation has no --generations to jump to
+    if (cycleMode == CYCLES_JUMP && !headless && jumpTarget == 0) {
+        fprintf(stderr, "--cycles jump needs --jump-to outside --headless\n");
+        return 1;
+    }
+
+    // The viewport is drawn by the differential renderer
+    if (viewGlyphs != VIEW_OFF && renderMode != RENDER_DIFF) {
+        fprintf(stderr, "--view needs --render diff\n");
+        return 1;
+    }
+
+    // Temporal blocking is built on the packed step
+    if (temporalDepth > 1 && storageMode != STORAGE_PACKED && verifyGenerations == 0) {
+        fprintf(stderr, "--temporal needs --storage packed\n");
+        return 1;
+    }
+
+    // Under B0 every empty neighborhood comes alive, so there is no
+    // sparse board and no finite plane
+    if ((lifeRule & RULE_BIRTH(0))
+        && (storageMode == STORAGE_SPARSE || storageMode == STORAGE_CHUNKED)) {
+        fprintf(stderr, "Rule %s needs --storage char or packed\n", ruleText);
+        return 1;
+    }
+
+    // Dying states need more than a bit per cell: Generations rules run
+    // on the char grid, with any char kernel, and nothing that stores or
+    // compares boards as bits
+    if (ruleStates > 2) {
+        if (storageMode != STORAGE_CHAR || temporalDepth > 1) {
+            fprintf(stderr, "Rule %s needs --storage char\n", ruleText);
+            return 1;
+        }
+        if (checkpointPath != NULL || restorePath != NULL || savePath != NULL || cycleMode != CYCLES_OFF
+            || hashLifeGenerations > 0) {
+            fprintf(stderr, "--checkpoint, --restore, --save, --cycles and --hashlife"
+                            " cannot be used with rule %s\n", ruleText);
+            return 1;
+        }
+    }
+
+    // Larger-than-Life rules run on the char grid with their own engine;
+    // checkpoints only have room for a range-1 rule
+    if (ltlRule.radius > 0) {
+        if (storageMode != STORAGE_CHAR || temporalDepth > 1 || hashLifeGenerations > 0) {
+            fprintf(stderr, "Rule %s needs --storage char, without --temporal or --hashlife\n",
+                    ruleText);
+            return 1;
+        }
+        if (checkpointPath != NULL || restorePath != NULL) {
+            fprintf(stderr, "--checkpoint and --restore cannot be used with rule %s\n", ruleText);
+            return 1;
+        }
+    }
+
+    // A census runs soups of its own on a small torus of bits: no board,
+    // and no rule that fills empty space or needs dying states
+    if (censusSoups > 0) {
+        if (patternPath != NULL || restorePath != NULL || sweep || verifyGenerations > 0
+            || hashLifeGenerations > 0 || checkpointPath != NULL || savePath != NULL) {
+            fprintf(stderr, "--census cannot be combined with --pattern, --restore, --sweep, --verify,"
+                            " --hashlife, --checkpoint or --save\n");
+            return 1;
+        }
+        if ((lifeRule & RULE_BIRTH(0)) || ruleStates > 2 || ltlRule.radius > 0) {
+            fprintf(stderr, "--census cannot be used with rule %s\n", ruleText);
+            return 1;
+        }
+    }
+
+    // Compile the rule, then precompute the lookup table for the lut
+    // kernel from it
+    compileRule();
+    buildLifeTable();
+
+    // Pick the char step kernel using the CPU's feature flags
+    if (!selectKernel(kernelName)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    srand(seed);
+
+    // The trace buffers must exist before the threads that fill them
+    if (!openTrace()) {
+        return 1;
+    }
+
+    // Census mode runs its own threads, one soup at a time each
+    if (censusSoups > 0) {
+        int ok = runCensus(censusSoups, seed);
+        ok = finishTrace() && ok;
+        return ok ? 0 : 1;
+    }
+
+    // Create the worker threads once; they live until the program exits
+    int requestedThreads = numThreads;
+    if (!startWorkerPool()) {
+        fprintf(stderr, "Could not start %d threads, running on 1\n", requestedThreads);
+    }
+
+    // In verify mode we run every kernel next to the char reference
+    // implementation and exit, instead of animating
+    if (verifyGenerations > 0) {
+        int ok = verifyKernels(verifyGenerations);
+        stopWorkerPool();
+        freeGrids();
+        ok = finishTrace() && ok;
+        return ok ? 0 : 1;
+    }
+
+    // Headless mode: no printing, no sleeping, just the timing report
+    if (headless) {
+        int ok = sweep ? runSweep(benchGenerations, seed)
+                       : reportBenchmark(benchGenerations, seed);
+        stopWorkerPool();
+        ok = finishTrace() && ok;
+        return ok ? 0 : 1;
+    }
+
+    // Allocate the grids for the selected storage mode only, so a large
+    // packed board never pays for the char grids
+    if (!allocateGrids(storageMode == STORAGE_CHAR, storageMode == STORAGE_PACKED)
+        || (renderMode == RENDER_DIFF && !allocateRenderer()) || !allocateFrames()) {
+        fprintf(stderr, "Not enough memory for a %dx%d board\n", width, height);
+        stopWorkerPool();
+        freeGrids();
+        freeRenderer();
+        freeFrames();
+        return 1;
+    }
 
     // Set up signal handler for graceful exit on Ctrl-C (SIGINT)
     // signal() registers a function to be called when a signal is received
+    // SIGTERM (a machine shutting down) exits the same way, so the last
+    // checkpoint gets written
     signal(SIGINT, handleSignal);
+    signal(SIGTERM, handleSignal);
 
-    // Initialize the grid with random alive/dead cells
-    initializeGrid();
+    // Initialize the grid with random alive/dead cells, the pattern or
+    // the checkpoint, optionally jumping far into the future before
+    // showing anything
+    if (!seedBoard() || !jumpAhead() || !openStats() || !startDumpWriter() || !startCheckpointWriter()) {
+        stopDumpWriter();
+        closeStats();
+        stopWorkerPool();
+        freeGrids();
+        freeRenderer();
+        freeFrames();
+        return 1;
+    }
+
+    // The simulation runs on its own thread from here on; this thread
+    // only draws frames
+    pthread_t simulationThread;
+    if (pthread_create(&simulationThread, NULL, simulationMain, NULL) != 0) {
+        fprintf(stderr, "Could not start the simulation thread\n");
+        closeStats();
+        stopWorkerPool();
+        freeGrids();
+        freeRenderer();
+        freeFrames();
+        return 1;
+    }
 
-    // Main simulation loop - runs indefinitely until Ctrl-C
+    // Render loop - runs indefinitely until Ctrl-C
+    double nextFrame = monotonicSeconds();
     while (!shouldExit) {
-        // Clear the screen for the new frame
-        clearScreen();
+        // Draw the newest generation, if the simulation has made one
+        showNewestFrame();
 
-        // Copy nextCells to cells for this generation
-        // We need to do this because we calculate the next generation
-        // based on the current one
-        copyGrid();
+        // Wait for the next frame, --fps times a second
+        // A frame that ran late pushes the schedule back rather than
+        // being followed by a burst of quick ones
+        nextFrame += 1.0 / targetFps;
+        double now = monotonicSeconds();
+        if (nextFrame < now) {
+            nextFrame = now;
+        }
+        waitForFrameTime(nextFrame);
+    }
+    pthread_join(simulationThread, NULL);
 
-        // Display the current state of the simulation
-        printGrid();
+    // --cycles stop ends the loop from the simulation thread, often before
+    // the last generation was drawn: show the board that stopped
+    if (cycleMode == CYCLES_STOP && atomic_load(&cyclePeriod) > 0) {
+        showNewestFrame();
+    }
 
-        // Compute what the next generation will look like
-        // based on Conway's rules
-        calculateNextGeneration();
+    // Hand the last generation to other tools
+    stopCheckpointWriter(currentGeneration);
+    stopDumpWriter();
+    closeStats();
+    int saved = savePath == NULL || savePattern(savePath);
 
-        // Pause for 1 second to make the animation visible
-        // sleep() is a POSIX function that suspends execution
-        sleep(1);
-    }
+    // Stop the workers and release the grid buffers
+    stopWorkerPool();
+    freeGrids();
+    freeRenderer();
+    freeFrames();
+    closePattern(&pattern);
 
     // Print exit message
     printf("\nConway's Game of Life\n");
     printf("C implementation based on original by Al Sweigart\n");
+    char cycle[128];
+    if (describeCycle(cycle, sizeof cycle)) {
+        printf("%s\n", cycle);
+    }
+    if (simulationFailed) {
+        fprintf(stderr, "Out of memory after generation %llu\n", currentGeneration);
+    }
+    saved = finishTrace() && saved;
 
     // Return 0 to indicate successful execution
     // This is the standard way to exit a C program normally
-    return 0;
+    return saved && !simulationFailed ? 0 : 1;
 }
 
 // ============================================================================
 // FUNCTION IMPLEMENTATIONS
 // ============================================================================
 
+/*
+ * cellRow - Pointer to cell (0, y) of a char grid
+ *
+ * y may be -1 or height to reach the ghost rows, and the returned
+ * pointer may be indexed from -1 to width to reach the ghost columns.
+ */
+static inline char *cellRow(char *grid, int y) {
+    return grid + (size_t)(y + 1) * stride + 1;
+}
+
+/*
+ * packedRow - Pointer to the first word of row y of a packed grid
+ *
+ * y may be -1 or height to reach the ghost rows.
+ */
+static inline uint64_t *packedRow(uint64_t *grid, int y) {
+    return grid + (size_t)(y + 1) * packedStride;
+}
+
+/*
+ * chunkWord - Current cells x = 64 * i .. 64 * i + 63 of row y of the plane
+ *
+ * Chunks are one word wide, so this is one row of one chunk, or 0 where
+ * no chunk exists.
+ */
+static inline uint64_t chunkWord(int i, int y) {
+    const struct Chunk *chunk = findChunk(i, y / CHUNK_SIZE);
+    return chunk != NULL ? chunk->rows[chunkCurrent][y % CHUNK_SIZE] : 0;
+}
+
+/*
+ * cellKey - Sparse storage key of cell (x, y)
+ */
+static inline uint64_t cellKey(int x, int y) {
+    return (uint64_t)y * (uint64_t)width + (uint64_t)x;
+}
+
+/*
+ * nextCellAlive / setNextCell - Read or write one cell of the next
+ *                               generation, whatever the storage mode
+ *
+ * Used by code that loads or stores whole boards (HashLife, patterns),
+ * not by the step kernels. A sparse board can only be written from an
+ * empty list: setNextCell appends the live cells in any order, and the
+ * writer calls sortNextLiveCells() when it is done. setNextCell returns
+ * 1 on success, 0 if memory ran out.
+ */
+static inline int nextCellAlive(int x, int y) {
+    if (storageMode == STORAGE_CHUNKED) {
+        const struct Chunk *chunk = findChunk(x / CHUNK_SIZE, y / CHUNK_SIZE);
+        return chunk != NULL && (chunk->rows[!chunkCurrent][y % CHUNK_SIZE] >> (x % CHUNK_SIZE)) & 1;
+    }
+    if (storageMode == STORAGE_SPARSE) {
+        // Binary search the sorted keys
+        uint64_t key = cellKey(x, y);
+        size_t low = 0;
+        size_t high = numNextLiveCells;
+        while (low < high) {
+            size_t mid = low + (high - low) / 2;
+            if (nextLiveCells[mid] < key) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        return low < numNextLiveCells && nextLiveCells[low] == key;
+    }
+    if (storageMode == STORAGE_PACKED) {
+        return (packedRow(packedNextCells, y)[x / WORD_BITS] >> (x % WORD_BITS)) & 1;
+    }
+    return cellRow(nextCells, y)[x] == ALIVE;
+}
+
+static inline int setNextCell(int x, int y, int alive) {
+    if (storageMode == STORAGE_CHUNKED) {
+        // Dead cells never need a chunk of their own
+        struct Chunk *chunk = alive ? ensureChunk(x / CHUNK_SIZE, y / CHUNK_SIZE)
+                                    : findChunk(x / CHUNK_SIZE, y / CHUNK_SIZE);
+        if (chunk != NULL) {
+            uint64_t *word = &chunk->rows[!chunkCurrent][y % CHUNK_SIZE];
+            uint64_t bit = UINT64_C(1) << (x % CHUNK_SIZE);
+            *word = alive ? (*word | bit) : (*word & ~bit);
+        } else if (alive) {
+            return 0;
+        }
+    } else if (storageMode == STORAGE_SPARSE) {
+        if (alive) {
+            if (!reserveLiveCells(numNextLiveCells + 1)) {
+                return 0;
+            }
+            nextLiveCells[numNextLiveCells++] = cellKey(x, y);
+        }
+    } else if (storageMode == STORAGE_PACKED) {
+        uint64_t *word = &packedRow(packedNextCells, y)[x / WORD_BITS];
+        uint64_t bit = UINT64_C(1) << (x % WORD_BITS);
+        *word = alive ? (*word | bit) : (*word & ~bit);
+    } else {
+        cellRow(nextCells, y)[x] = alive ? ALIVE : DEAD;
+    }
+    return 1;
+}
+
+/*
+ * allocateGrids - Allocate the grid buffers for the current board size
+ *
+ * Parameters:
+ *   needChar   - Allocate cells/nextCells
+ *   needPacked - Allocate packedCells/packedNextCells
+ *
+ * Returns:
+ *   1 on success, 0 if memory ran out
+ */
+int allocateGrids(int needChar, int needPacked) {
+    // A char row holds the cells plus a ghost on each side. It is rounded
+    // up to whole cache lines with one spare line, so a vector kernel may
+    // run past the last cell without touching the next row
+    stride = ((size_t)width + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE + CACHE_LINE;
+
+    // A packed row is rounded up to whole cache lines of words
+    size_t wordsPerLine = CACHE_LINE / sizeof(uint64_t);
+    wordsPerRow = (width + WORD_BITS - 1) / WORD_BITS;
+    packedStride = ((size_t)wordsPerRow + wordsPerLine - 1) / wordsPerLine * wordsPerLine;
+
+    // Bits past the last cell must always stay 0 so they never count
+    // as neighbors
+    lastWordMask = (width % WORD_BITS) == 0 ? ~UINT64_C(0)
+                 : (UINT64_C(1) << (width % WORD_BITS)) - 1;
+
+    if (needChar) {
+        cells = allocateCharGrid();
+        nextCells = allocateCharGrid();
+        if (cells == NULL || nextCells == NULL) {
+            freeGrids();
+            return 0;
+        }
+    }
+    if (needPacked) {
+        packedCells = allocatePackedGrid();
+        packedNextCells = allocatePackedGrid();
+        if (packedCells == NULL || packedNextCells == NULL) {
+            freeGrids();
+            return 0;
+        }
+    }
+    if (needChar && ltlRule.radius > 0 && !allocateLtlSums()) {
+        freeGrids();
+        return 0;
+    }
+    if (needPacked && temporalDepth > 1) {
+        temporalScratch = aligned_alloc(CACHE_LINE, sizeof(uint64_t) * 2 * TEMPORAL_MAX_ROWS
+                                                    * TEMPORAL_STRIDE * (size_t)numThreads);
+        if (temporalScratch == NULL) {
+            freeGrids();
+            return 0;
+        }
+    }
+    // The live cell lists start empty and grow with the population
+    numLiveCells = numNextLiveCells = 0;
+
+    // One slot per thread for the stats of its band
+    workerStats = malloc(sizeof(struct RegionStats) * (size_t)numThreads);
+    if (workerStats == NULL) {
+        freeGrids();
+        return 0;
+    }
+
+    // The sparse and chunked engines have no grid to tile. Cycle
+    // detection hashes tile by tile even when the board is stepped in bands
+    if (storageMode != STORAGE_SPARSE && storageMode != STORAGE_CHUNKED
+        && (usingTiles() || cycleMode != CYCLES_OFF) && !allocateTiles()) {
+        freeGrids();
+        return 0;
+    }
+    return 1;
+}
+
+/*
+ * allocateCharGrid - Allocate one all-DEAD char grid with ghost cells
+ *
+ * aligned_alloc (C11) returns memory starting on a cache line boundary.
+ * The size must be a multiple of the alignment, which stride already is.
+ *
+ * Returns:
+ *   The grid, or NULL if memory ran out
+ */
+char *allocateCharGrid(void) {
+    size_t bytes = (size_t)(height + 2) * stride;
+    char *grid = aligned_alloc(CACHE_LINE, bytes);
+    if (grid != NULL) {
+        memset(grid, DEAD, bytes);
+    }
+    return grid;
+}
+
+/*
+ * allocatePackedGrid - Allocate one all-dead packed grid with ghost rows
+ *
+ * Returns:
+ *   The grid, or NULL if memory ran out
+ */
+uint64_t *allocatePackedGrid(void) {
+    size_t bytes = (size_t)(height + 2) * packedStride * sizeof(uint64_t);
+    uint64_t *grid = aligned_alloc(CACHE_LINE, bytes);
+    if (grid != NULL) {
+        memset(grid, 0, bytes);
+    }
+    return grid;
+}
+
+/*
+ * freePackedGrid - Release a packed grid, heap-allocated or mapped
+ *
+ * A grid restored from a checkpoint is a mapping of the file (see
+ * restoreCheckpoint), which has to be unmapped rather than freed.
+ */
+static void freePackedGrid(uint64_t *grid) {
+    if (grid != NULL && grid == mappedGrid) {
+        munmap(grid, mappedGridBytes);
+        mappedGrid = NULL;
+    } else {
+        free(grid);
+    }
+}
+
+/*
+ * freeGrids - Release every grid buffer
+ *
+ * free(NULL) does nothing, so this is safe for grids never allocated.
+ */
+void freeGrids(void) {
+    free(cells);
+    free(nextCells);
+    freePackedGrid(packedCells);
+    freePackedGrid(packedNextCells);
+    free(temporalScratch);
+    temporalScratch = NULL;
+    free(ltlSums);
+    ltlSums = NULL;
+    free(workerStats);
+    workerStats = NULL;
+    free(liveCells);
+    free(nextLiveCells);
+    free(neighborKeys);
+    cells = nextCells = NULL;
+    packedCells = packedNextCells = NULL;
+    liveCells = nextLiveCells = neighborKeys = NULL;
+    liveCapacity = neighborCapacity = 0;
+    freeChunks();
+    freeTiles();
+}
+
 /*
  * initializeGrid - Initialize the grid with random alive/dead cells
  *
  * This function loops through every position in the grid and randomly
  * sets each cell to either ALIVE or DEAD with 50% probability.
+ * Every allocated storage mode receives the same pattern.
+ *
+ * Returns:
+ *   1 on success, 0 if memory ran out for the live cells
  */
-void initializeGrid(void) {
+int initializeGrid(void) {
+    numNextLiveCells = 0;
+
     // Loop through each row (y coordinate)
-    for (int y = 0; y < HEIGHT; y++) {
+    for (int y = 0; y < height; y++) {
+        char *row = nextCells != NULL ? cellRow(nextCells, y) : NULL;
+        uint64_t *packed = packedNextCells != NULL ? packedRow(packedNextCells, y) : NULL;
+
         // Loop through each column (x coordinate)
-        for (int x = 0; x < WIDTH; x++) {
+        for (int x = 0; x < width; x++) {
             // rand() returns a pseudo-random integer
             // rand() % 2 gives us either 0 or 1 (50/50 chance)
             // We use this to randomly set cells to alive or dead
-            if (rand() % 2 == 0) {
-                nextCells[y][x] = ALIVE;
-            } else {
-                nextCells[y][x] = DEAD;
+            int alive = rand() % 2 == 0;
+
+            if (row != NULL) {
+                row[x] = alive ? ALIVE : DEAD;
+            }
+            if (packed != NULL) {
+                uint64_t bit = UINT64_C(1) << (x % WORD_BITS);
+                if (alive) {
+                    packed[x / WORD_BITS] |= bit;
+                } else {
+                    packed[x / WORD_BITS] &= ~bit;
+                }
+            }
+            if (storageMode == STORAGE_SPARSE || storageMode == STORAGE_CHUNKED) {
+                // Sparse: cells are visited in key order, so the list
+                // stays sorted
+                if (!setNextCell(x, y, alive)) {
+                    return 0;
+                }
             }
         }
     }
+
+    // Nothing is known about the tiles yet
+    markAllTilesChanged();
+    return 1;
 }
 
 /*
- * printGrid - Display the current grid state to the console
+ * printGrid - Display the shown frame on the console
  *
  * Prints each cell character followed by a newline at the end of each row.
  */
 void printGrid(void) {
     // Iterate through each row
-    for (int y = 0; y < HEIGHT; y++) {
+    for (int y = 0; y < height; y++) {
+        const uint64_t *words = shownFrame + (size_t)y * (size_t)frameWords;
         // Iterate through each column in this row
-        for (int x = 0; x < WIDTH; x++) {
+        for (int x = 0; x < width; x++) {
             // putchar() outputs a single character to stdout
             // It's more efficient than printf() for single characters
-            putchar(cells[y][x]);
+            uint64_t bit = (words[x / WORD_BITS] >> (x % WORD_BITS)) & 1;
+            putchar(bit ? ALIVE : DEAD);
         }
         // Print newline at end of row to move to next line
         // putchar('\n') is equivalent to printf("\n")
         putchar('\n');
     }
-    // Print instructions for the user
+    // Print instructions for the user, and the cycle once one is found
     printf("Press Ctrl-C to quit.\n");
+    char cycle[128];
+    if (describeCycle(cycle, sizeof cycle)) {
+        printf("%s\n", cycle);
+    }
 }
 
+// Longest cursor escape drawFrame writes: ESC [ row ; column H
+#define CURSOR_ESCAPE_MAX 24
+
+// Longest UTF-8 encoding of a glyph (every glyph is in the Basic Multilingual Plane)
+#define GLYPH_BYTES_MAX 3
+
+// Room for the status line under a --view screen
+#define STATUS_MAX 256
+
 /*
- * calculateNextGeneration - Apply Conway's Game of Life rules
+ * allocateRenderer - Allocate the buffers of the differential renderer
  *
- * Conway's Rules:
- * 1. Any live cell with 2 or 3 live neighbors survives
- * 2. Any dead cell with exactly 3 live neighbors becomes alive
- * 3. All other cells die or remain dead
+ * Without --view the screen is the board, one glyph per cell. With
+ * --view it is the terminal, less one row for the status line.
  *
- * This function examines each cell and its 8 neighbors to determine
- * the cell's state in the next generation.
- */
-void calculateNextGeneration(void) {
-    // Loop through every cell in the grid
-    for (int y = 0; y < HEIGHT; y++) {
-        for (int x = 0; x < WIDTH; x++) {
-            // Calculate neighbor coordinates with wraparound (toroidal topology)
-            // The modulo operator (%) ensures coordinates wrap around the edges
-            // Example: if x=0, then left=(0-1)%WIDTH = WIDTH-1 (rightmost column)
-            int left = (x - 1 + WIDTH) % WIDTH;   // Column to the left
-            int right = (x + 1) % WIDTH;          // Column to the right
-            int above = (y - 1 + HEIGHT) % HEIGHT; // Row above
-            int below = (y + 1) % HEIGHT;         // Row below
+ * The frame buffer is sized for the worst case up front, so drawing a
+ * frame never allocates. Each row costs at most one cursor escape plus
+ * one glyph per column, because drawFrame only skips over unchanged
+ * glyphs with an escape when the escape is shorter than the glyphs it
+ * skips.
+ *
+ * Returns:
+ *   1 on success, 0 if memory ran out
+ */
+int allocateRenderer(void) {
+    screenCols = width;
+    screenRows = height;
+    if (viewGlyphs != VIEW_OFF) {
+        // Fall back to 80x24 when stdout is not a terminal
+        struct winsize size;
+        screenCols = 80;
+        screenRows = 24 - 1;
+        if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_col > 0 && size.ws_row > 1) {
+            screenCols = size.ws_col;
+            screenRows = size.ws_row - 1;
+        }
+        dotsAcross = viewGlyphs == VIEW_BRAILLE ? 2 : 1;
+        dotsDown = viewGlyphs == VIEW_BRAILLE ? 4 : 2;
+        viewCounts = malloc((size_t)screenCols * dotsAcross * (size_t)screenRows * dotsDown
+                            * sizeof(int));
+        if (viewCounts == NULL) {
+            return 0;
+        }
+        if (viewZoom == 0) {
+            fitView();
+        }
+        requestView();
+    }
 
-            // Count living neighbors among the 8 surrounding cells
-            // We check each of the 8 positions around (x, y)
-            int numNeighbors = 0;
+    frameCapacity = 16 + (size_t)screenRows
+                  * (CURSOR_ESCAPE_MAX + GLYPH_BYTES_MAX * (size_t)screenCols)
+                  + 2 * CURSOR_ESCAPE_MAX + STATUS_MAX + 64;
+    shownGlyphs = calloc((size_t)screenCols * (size_t)screenRows, sizeof(uint32_t));
+    renderRowGlyphs = malloc((size_t)screenCols * sizeof(uint32_t));
+    renderRowBuffer = malloc((size_t)width);
+    frameBuffer = malloc(frameCapacity);
+    if (shownGlyphs == NULL || renderRowGlyphs == NULL || renderRowBuffer == NULL
+        || frameBuffer == NULL) {
+        freeRenderer();
+        return 0;
+    }
 
-            // Top-left neighbor
-            if (cells[above][left] == ALIVE) {
-                numNeighbors++;
+    // Read the pan and zoom keys as they are pressed, without echo
+    // ISIG stays on, so Ctrl-C still raises SIGINT
+    if (viewGlyphs != VIEW_OFF && isatty(STDIN_FILENO)
+        && tcgetattr(STDIN_FILENO, &savedTermios) == 0) {
+        struct termios raw = savedTermios;
+        raw.c_lflag &= ~(tcflag_t)(ICANON | ECHO);
+        raw.c_cc[VMIN] = 0;
+        raw.c_cc[VTIME] = 0;
+        rawTerminal = tcsetattr(STDIN_FILENO, TCSANOW, &raw) == 0;
+    }
+    return 1;
+}
+
+/*
+ * freeRenderer - Release the differential renderer's buffers
+ */
+void freeRenderer(void) {
+    restoreTerminal();
+    free(shownGlyphs);
+    free(renderRowGlyphs);
+    free(renderRowBuffer);
+    free(frameBuffer);
+    free(viewCounts);
+    shownGlyphs = renderRowGlyphs = NULL;
+    renderRowBuffer = frameBuffer = NULL;
+    viewCounts = NULL;
+}
+
+/*
+ * restoreTerminal - Give stdin back its line editing and echo
+ */
+void restoreTerminal(void) {
+    if (rawTerminal) {
+        tcsetattr(STDIN_FILENO, TCSANOW, &savedTermios);
+        rawTerminal = 0;
+    }
+}
+
+/*
+ * fitView - Zoom out until the whole board fits on the screen
+ */
+void fitView(void) {
+    int across = (width + screenCols * dotsAcross - 1) / (screenCols * dotsAcross);
+    int down = (height + screenRows * dotsDown - 1) / (screenRows * dotsDown);
+    viewZoom = across > down ? across : down;
+    if (viewZoom < 1) {
+        viewZoom = 1;
+    }
+    viewX = 0;
+    viewY = 0;
+    requestView();
+}
+
+/*
+ * requestView - Tell the simulation thread where the view is now
+ *
+ * It reads these when it captures a frame, to pick the cells to carry
+ * along when the view is zoomed in closer than a pyramid block.
+ */
+void requestView(void) {
+    atomic_store_explicit(&wantedViewX, viewX, memory_order_relaxed);
+    atomic_store_explicit(&wantedViewY, viewY, memory_order_relaxed);
+    atomic_store_explicit(&wantedZoom, viewZoom, memory_order_relaxed);
+}
+
+/*
+ * frameRowChars - Write row y of the shown frame as ALIVE/DEAD chars
+ */
+static void frameRowChars(int y, char *row) {
+    const uint64_t *words = shownFrame + (size_t)y * (size_t)frameWords;
+    for (int x = 0; x < width; x++) {
+        row[x] = (words[x / WORD_BITS] >> (x % WORD_BITS)) & 1 ? ALIVE : DEAD;
+    }
+}
+
+/*
+ * countRowCells - Live cells of a frame row from x = xBegin up to but
+ *                 not including xEnd (which must lie within the row)
+ *
+ * Counted a word at a time with popcount.
+ */
+static int countRowCells(const uint64_t *words, int xBegin, int xEnd) {
+    int count = 0;
+    int last = (xEnd - 1) / WORD_BITS;
+    for (int i = xBegin / WORD_BITS; i <= last; i++) {
+        uint64_t word = words[i];
+        // Keep only the bits from xBegin to xEnd
+        if (i == xBegin / WORD_BITS) {
+            word &= ~UINT64_C(0) << (xBegin % WORD_BITS);
+        }
+        if (i == last && xEnd % WORD_BITS != 0) {
+            word &= ~(~UINT64_C(0) << (xEnd % WORD_BITS));
+        }
+        count += __builtin_popcountll(word);
+    }
+    return count;
+}
+
+/*
+ * viewBlock - Population of block (bx, by) of a pyramid level in a frame
+ */
+static inline uint32_t viewBlock(int slot, int level, long bx, long by) {
+    if (level == 0) {
+        return frameRing.blocks[slot][by * viewLevelCols[0] + bx];
+    }
+    return frameRing.pyramid[slot][viewLevelOffset[level] + (size_t)(by * viewLevelCols[level] + bx)];
+}
+
+/*
+ * countViewDots - Fill viewCounts with the population of every dot
+ *
+ * Dots that fall off the board count as empty. Zoomed in closer than a
+ * pyramid block, and with the view inside the frame's window, each row
+ * in view is read once, one popcount per 64 cells. Otherwise every
+ * block of the coarsest level that fits in a dot goes to the dot its
+ * middle falls in; a dot gets a few blocks, whatever the board size.
+ * Right after a pan or zoom the window may not cover the view yet, and
+ * level 0 stands in for it until the next frame.
+ */
+static void countViewDots(void) {
+    int dotCols = screenCols * dotsAcross;
+    int dotRows = screenRows * dotsDown;
+    long viewWidth = (long)dotCols * viewZoom;
+    long viewHeight = (long)dotRows * viewZoom;
+    long viewRight = viewX + viewWidth < width ? viewX + viewWidth : width;
+    long viewBottom = viewY + viewHeight < height ? viewY + viewHeight : height;
+    int slot = shownSlot;
+    int windowX = frameRing.windowX[slot];
+    int windowY = frameRing.windowY[slot];
+    memset(viewCounts, 0, (size_t)dotCols * (size_t)dotRows * sizeof(int));
+
+    if (viewZoom < VIEW_BLOCK && frameRing.windowWidth[slot] > 0
+        && viewX >= windowX && viewRight <= windowX + frameRing.windowWidth[slot]
+        && viewY >= windowY && viewBottom <= windowY + frameRing.windowHeight[slot]) {
+        for (int dotY = 0; dotY < dotRows; dotY++) {
+            long yBegin = viewY + (long)dotY * viewZoom;
+            long yEnd = yBegin + viewZoom < viewBottom ? yBegin + viewZoom : viewBottom;
+            for (long y = yBegin; y < yEnd; y++) {
+                const uint64_t *words = shownFrame + (size_t)(y - windowY) * (size_t)frameWords;
+                for (int dotX = 0; dotX < dotCols; dotX++) {
+                    long xBegin = viewX + (long)dotX * viewZoom;
+                    if (xBegin >= viewRight) {
+                        break;
+                    }
+                    long xEnd = xBegin + viewZoom < viewRight ? xBegin + viewZoom : viewRight;
+                    viewCounts[dotY * dotCols + dotX] += countRowCells(words, (int)(xBegin - windowX),
+                                                                       (int)(xEnd - windowX));
+                }
             }
+        }
+        return;
+    }
 
-            // Top neighbor (directly above)
-            if (cells[above][x] == ALIVE) {
-                numNeighbors++;
+    int level = 0;
+    while (level + 1 < viewLevels && ((long)VIEW_BLOCK << (level + 1)) <= viewZoom) {
+        level++;
+    }
+    long block = (long)VIEW_BLOCK << level;
+    long half = block / 2;
+    long bxBegin = viewX < half ? 0 : (viewX - half + block - 1) / block;
+    long byBegin = viewY < half ? 0 : (viewY - half + block - 1) / block;
+    for (long by = byBegin; by < viewLevelRows[level] && by * block + half < viewY + viewHeight; by++) {
+        int *dots = viewCounts + (size_t)((by * block + half - viewY) / viewZoom) * (size_t)dotCols;
+        for (long bx = bxBegin; bx < viewLevelCols[level] && bx * block + half < viewX + viewWidth; bx++) {
+            dots[(bx * block + half - viewX) / viewZoom] += (int)viewBlock(slot, level, bx, by);
+        }
+    }
+}
+
+/*
+ * viewRowGlyphs - Build screen row y of a --view screen from viewCounts
+ *
+ * Braille and half blocks light a dot if any cell in it is alive;
+ * density picks a ramp character from the share of live cells.
+ */
+static void viewRowGlyphs(int y, uint32_t *row) {
+    // Braille dot bits, by dot row and dot column (U+2800 is the empty pattern)
+    static const uint32_t brailleBits[4][2] = {{0x01, 0x08}, {0x02, 0x10}, {0x04, 0x20}, {0x40, 0x80}};
+    static const char densityRamp[] = " .:-=+*#%@";
+    int dotCols = screenCols * dotsAcross;
+
+    for (int x = 0; x < screenCols; x++) {
+        const int *dots = viewCounts + (size_t)y * dotsDown * dotCols + (size_t)x * dotsAcross;
+        if (viewGlyphs == VIEW_BRAILLE) {
+            uint32_t bits = 0;
+            for (int dy = 0; dy < 4; dy++) {
+                for (int dx = 0; dx < 2; dx++) {
+                    bits |= dots[dy * dotCols + dx] > 0 ? brailleBits[dy][dx] : 0;
+                }
             }
+            row[x] = bits != 0 ? 0x2800 + bits : ' ';
+        } else if (viewGlyphs == VIEW_HALF) {
+            // U+2580 upper half, U+2584 lower half, U+2588 full block
+            int upper = dots[0] > 0;
+            int lower = dots[dotCols] > 0;
+            row[x] = upper && lower ? 0x2588 : upper ? 0x2580 : lower ? 0x2584 : ' ';
+        } else {
+            long long population = dots[0] + dots[dotCols];
+            long long area = 2LL * viewZoom * viewZoom;
+            int level = population == 0 ? 0 : 1 + (int)(population * 8 / area);
+            row[x] = (uint32_t)densityRamp[level < 9 ? level : 9];
+        }
+    }
+}
 
-            // Top-right neighbor
-            if (cells[above][right] == ALIVE) {
-                numNeighbors++;
+/*
+ * appendNumber - Append a positive number in decimal, return the new end
+ */
+static char *appendNumber(char *out, int value) {
+    char digits[12];
+    int count = 0;
+    do {
+        digits[count++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    while (count > 0) {
+        *out++ = digits[--count];
+    }
+    return out;
+}
+
+/*
+ * appendCursorMove - Append the escape that moves the cursor to row y,
+ *                    column x of the screen (both counted from 0)
+ */
+static char *appendCursorMove(char *out, int y, int x) {
+    // ESC [ row ; column H, where the terminal counts from 1
+    *out++ = '\033';
+    *out++ = '[';
+    out = appendNumber(out, y + 1);
+    *out++ = ';';
+    out = appendNumber(out, x + 1);
+    *out++ = 'H';
+    return out;
+}
+
+/*
+ * appendGlyph - Append a code point encoded as UTF-8
+ */
+static char *appendGlyph(char *out, uint32_t glyph) {
+    if (glyph < 0x80) {
+        *out++ = (char)glyph;
+    } else if (glyph < 0x800) {
+        *out++ = (char)(0xC0 | (glyph >> 6));
+        *out++ = (char)(0x80 | (glyph & 0x3F));
+    } else {
+        *out++ = (char)(0xE0 | (glyph >> 12));
+        *out++ = (char)(0x80 | ((glyph >> 6) & 0x3F));
+        *out++ = (char)(0x80 | (glyph & 0x3F));
+    }
+    return out;
+}
+
+/*
+ * drawFrame - Display shownFrame, redrawing only what changed
+ *
+ * Compares every screen row with shownGlyphs. Rows that match are
+ * skipped with a single memcmp; in the others the cursor jumps to the
+ * first changed glyph and then writes the changed glyphs, moving
+ * forwards with ESC [ n C over runs of unchanged ones when that is
+ * shorter than reprinting them. The first frame clears the screen and
+ * draws everything. The frame is sent with one write() instead of one
+ * putchar() per cell, so the terminal never shows a half-drawn board
+ * and a still board costs almost nothing.
+ */
+void drawFrame(void) {
+    char *out = frameBuffer;
+    int firstFrame = shownGlyphs[0] == 0;
+
+    if (firstFrame) {
+        // ESC [2J clears the screen; see clearScreen()
+        memcpy(out, "\033[2J", 4);
+        out += 4;
+    }
+
+    if (viewGlyphs != VIEW_OFF) {
+        countViewDots();
+    }
+
+    for (int y = 0; y < screenRows; y++) {
+        uint32_t *shown = shownGlyphs + (size_t)y * (size_t)screenCols;
+        uint32_t *row = renderRowGlyphs;
+        if (viewGlyphs != VIEW_OFF) {
+            viewRowGlyphs(y, row);
+        } else {
+            frameRowChars(y, renderRowBuffer);
+            for (int x = 0; x < width; x++) {
+                row[x] = (unsigned char)renderRowBuffer[x];
             }
+        }
+        if (memcmp(shown, row, (size_t)screenCols * sizeof(uint32_t)) == 0) {
+            continue;
+        }
 
-            // Left neighbor (same row)
-            if (cells[y][left] == ALIVE) {
-                numNeighbors++;
+        // column is where the terminal cursor is, -1 = not on this row yet
+        int column = -1;
+        for (int x = 0; x < screenCols; x++) {
+            if (shown[x] == row[x]) {
+                continue;
+            }
+            int gap = x - column;
+            if (column < 0) {
+                out = appendCursorMove(out, y, x);
+            } else if (gap > 4 + (gap >= 10) + (gap >= 100) + (gap >= 1000)) {
+                // ESC [ gap C moves the cursor gap columns right; it is
+                // only used when it is shorter than the glyphs it skips
+                // (the bound on frameCapacity relies on this)
+                *out++ = '\033';
+                *out++ = '[';
+                out = appendNumber(out, gap);
+                *out++ = 'C';
+            } else {
+                // Reprint the unchanged glyphs in between
+                for (int skipped = column; skipped < x; skipped++) {
+                    out = appendGlyph(out, row[skipped]);
+                }
             }
+            out = appendGlyph(out, row[x]);
+            column = x + 1;
+        }
+        memcpy(shown, row, (size_t)screenCols * sizeof(uint32_t));
+    }
 
-            // Right neighbor (same row)
-            if (cells[y][right] == ALIVE) {
-                numNeighbors++;
+    if (viewGlyphs != VIEW_OFF) {
+        // Status line: where the screen is and how to move it
+        // ESC [K clears what is left of the previous status
+        char status[STATUS_MAX];
+        char cycle[STATUS_MAX / 2];
+        int found = describeCycle(cycle, sizeof cycle);
+        int length = snprintf(status, sizeof status,
+                              "Generation %llu, %dx%d at (%d, %d), 1 dot = %dx%d cells, %llu dropped%s%s"
+                              " | arrows/hjkl pan, +/- zoom, 0 fit, Ctrl-C quit",
+                              shownGeneration, width, height, viewX, viewY, viewZoom, viewZoom,
+                              (unsigned long long)atomic_load_explicit(&framesDropped, memory_order_relaxed),
+                              found ? " | " : "", found ? cycle : "");
+        if (length > (int)sizeof status - 1) {
+            length = (int)sizeof status - 1;
+        }
+        if (length > screenCols) {
+            length = screenCols;
+        }
+        out = appendCursorMove(out, screenRows, 0);
+        memcpy(out, status, (size_t)length);
+        out += length;
+        memcpy(out, "\033[K", 3);
+        out += 3;
+    } else {
+        // Print instructions for the user, and the cycle once one is found
+        static int cycleShown = 0;
+        char footer[STATUS_MAX] = "Press Ctrl-C to quit.";
+        size_t length = strlen(footer);
+        int found = describeCycle(footer + length + 1, sizeof footer - length - 1);
+        if (firstFrame || found != cycleShown) {
+            if (found) {
+                footer[length] = ' ';
+                length = strlen(footer);
             }
+            out = appendCursorMove(out, screenRows, 0);
+            memcpy(out, footer, length);
+            out += length;
+            cycleShown = found;
+        }
+    }
 
-            // Bottom-left neighbor
-            if (cells[below][left] == ALIVE) {
-                numNeighbors++;
+    // Leave the cursor below the board
+    out = appendCursorMove(out, screenRows + 1, 0);
+
+    // Anything printed with stdio must reach the terminal first
+    fflush(stdout);
+
+    // write() may take only part of the frame (a full pipe, a signal),
+    // so keep going until all of it is out
+    const char *pending = frameBuffer;
+    while (pending < out) {
+        ssize_t written = write(STDOUT_FILENO, pending, (size_t)(out - pending));
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
             }
+            break;
+        }
+        pending += written;
+    }
+}
 
-            // Bottom neighbor (directly below)
-            if (cells[below][x] == ALIVE) {
-                numNeighbors++;
+/*
+ * handleViewKeys - Apply the pan and zoom keys waiting on stdin
+ *
+ * Arrow keys or h/j/k/l pan by a quarter of the screen, + (or =) and -
+ * zoom in and out around the middle of the screen, 0 fits the board.
+ * With --trace or --histograms, t switches the timers on and off.
+ *
+ * Returns:
+ *   1 if the view moved, 0 if not, -1 once stdin is closed
+ */
+int handleViewKeys(void) {
+    char keys[64];
+    ssize_t count = read(STDIN_FILENO, keys, sizeof keys);
+    if (count == 0) {
+        return -1;
+    }
+
+    int moved = 0;
+    for (ssize_t i = 0; i < count; i++) {
+        long panX = (long)screenCols * dotsAcross * viewZoom / 4;
+        long panY = (long)screenRows * dotsDown * viewZoom / 4;
+        long middleX = viewX + (long)screenCols * dotsAcross * viewZoom / 2;
+        long middleY = viewY + (long)screenRows * dotsDown * viewZoom / 2;
+        char key = keys[i];
+
+        // Arrow keys arrive as ESC [ A..D
+        if (key == '\033' && i + 2 < count && keys[i + 1] == '[') {
+            key = "kjlh"[(keys[i + 2] - 'A') & 3];
+            i += 2;
+        }
+
+        long x = viewX;
+        long y = viewY;
+        int zoom = viewZoom;
+        switch (key) {
+        case 'h': x -= panX; break;
+        case 'l': x += panX; break;
+        case 'k': y -= panY; break;
+        case 'j': y += panY; break;
+        case '+':
+        case '=': zoom = zoom > 1 ? zoom / 2 : 1; break;
+        case '-': zoom = zoom < (1 << 24) ? zoom * 2 : zoom; break;
+        case '0': fitView(); moved = 1; continue;
+        case 't': toggleTracing(0); continue;
+        default: continue;
+        }
+        if (zoom != viewZoom) {
+            // Keep the middle of the screen where it was
+            x = middleX - (long)screenCols * dotsAcross * zoom / 2;
+            y = middleY - (long)screenRows * dotsDown * zoom / 2;
+        }
+
+        // The top-left corner stays on the board
+        viewX = (int)(x < 0 ? 0 : x >= width ? width - 1 : x);
+        viewY = (int)(y < 0 ? 0 : y >= height ? height - 1 : y);
+        viewZoom = zoom;
+        moved = 1;
+    }
+    if (moved) {
+        requestView();
+    }
+    return moved;
+}
+
+/*
+ * waitForFrameTime - Pause until the next frame is due
+ *
+ * With --view on a terminal it waits on stdin meanwhile, redrawing the
+ * shown frame whenever a key moves the view, so panning does not have to
+ * wait for the next frame.
+ *
+ * Parameters:
+ *   deadline - monotonicSeconds() at which to return
+ */
+void waitForFrameTime(double deadline) {
+    while (rawTerminal && !shouldExit) {
+        double remaining = deadline - monotonicSeconds();
+        if (remaining <= 0) {
+            return;
+        }
+        struct pollfd input = {.fd = STDIN_FILENO, .events = POLLIN};
+        if (poll(&input, 1, (int)(remaining * 1000) + 1) <= 0) {
+            continue;
+        }
+        int moved = handleViewKeys();
+        if (moved < 0) {
+            // stdin is gone: no more keys, sleep out the rest
+            restoreTerminal();
+        } else if (moved && shownFrame != NULL) {
+            drawFrame();
+        }
+    }
+    sleepUntil(deadline);
+}
+
+/*
+ * sleepUntil - Sleep until monotonicSeconds() reaches deadline
+ *
+ * Sleeping to an absolute time on the monotonic clock, rather than for a
+ * length of time, keeps a steady pace: time spent working in between is
+ * not added on top, and changes to the wall clock do not matter.
+ */
+void sleepUntil(double deadline) {
+    struct timespec wake;
+    wake.tv_sec = (time_t)deadline;
+    wake.tv_nsec = (long)((deadline - (double)wake.tv_sec) * 1e9);
+    // A signal (Ctrl-C) ends the sleep early with EINTR
+    while (!shouldExit && clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL) == EINTR) {
+    }
+}
+
+/*
+ * allocateFrames - Allocate the slots of the frame ring
+ *
+ * Returns:
+ *   1 on success, 0 if memory ran out
+ */
+int allocateFrames(void) {
+    int boardWords = (width + WORD_BITS - 1) / WORD_BITS;
+    size_t pyramidBlocks = 0;
+    frameWords = boardWords;
+    frameRows = height;
+    atomic_init(&frameRing.head, 0);
+    atomic_init(&frameRing.tail, 0);
+    atomic_init(&framesDropped, 0);
+
+    if (viewGlyphs != VIEW_OFF) {
+        // The window holds the view at the closest zoom below a block,
+        // plus a quarter of it on every side, so a pan stays inside
+        long windowCols = (long)screenCols * dotsAcross * (VIEW_BLOCK - 1) * 3 / 2 + WORD_BITS;
+        long windowRows = (long)screenRows * dotsDown * (VIEW_BLOCK - 1) * 3 / 2;
+        frameWords = windowCols / WORD_BITS + 1 < boardWords ? (int)(windowCols / WORD_BITS + 1) : boardWords;
+        frameRows = windowRows < height ? (int)windowRows : height;
+
+        // Level 0 has a block for every byte of a board word
+        viewLevels = 1;
+        viewLevelCols[0] = boardWords * (WORD_BITS / VIEW_BLOCK);
+        viewLevelRows[0] = (height + VIEW_BLOCK - 1) / VIEW_BLOCK;
+        while ((viewLevelCols[viewLevels - 1] > 1 || viewLevelRows[viewLevels - 1] > 1)
+               && viewLevels < VIEW_LEVELS_MAX) {
+            viewLevelCols[viewLevels] = (viewLevelCols[viewLevels - 1] + 1) / 2;
+            viewLevelRows[viewLevels] = (viewLevelRows[viewLevels - 1] + 1) / 2;
+            viewLevelOffset[viewLevels] = pyramidBlocks;
+            pyramidBlocks += (size_t)viewLevelCols[viewLevels] * (size_t)viewLevelRows[viewLevels];
+            viewLevels++;
+        }
+        viewBlockSums = malloc((size_t)boardWords * sizeof(uint64_t));
+        if (viewBlockSums == NULL) {
+            return 0;
+        }
+    }
+
+    for (int i = 0; i < FRAME_SLOTS; i++) {
+        frameRing.bits[i] = malloc((size_t)frameWords * (size_t)frameRows * sizeof(uint64_t));
+        frameRing.windowWidth[i] = 0;
+        if (viewGlyphs != VIEW_OFF) {
+            frameRing.blocks[i] = malloc((size_t)viewLevelCols[0] * (size_t)viewLevelRows[0]);
+            frameRing.pyramid[i] = malloc((pyramidBlocks > 0 ? pyramidBlocks : 1) * sizeof(uint32_t));
+        }
+        if (frameRing.bits[i] == NULL
+            || (viewGlyphs != VIEW_OFF && (frameRing.blocks[i] == NULL || frameRing.pyramid[i] == NULL))) {
+            freeFrames();
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * freeFrames - Release the slots of the frame ring
+ */
+void freeFrames(void) {
+    for (int i = 0; i < FRAME_SLOTS; i++) {
+        free(frameRing.bits[i]);
+        free(frameRing.blocks[i]);
+        free(frameRing.pyramid[i]);
+        frameRing.bits[i] = NULL;
+        frameRing.blocks[i] = NULL;
+        frameRing.pyramid[i] = NULL;
+    }
+    free(viewBlockSums);
+    viewBlockSums = NULL;
+    shownFrame = NULL;
+}
+
+/*
+ * captureFrame - Copy the current generation into a frame, one bit per cell
+ *
+ * Row y starts at bits + y * rowWords; rowWords is at least
+ * (width + 63) / 64, and any words past that are left alone.
+ */
+void captureFrame(uint64_t *bits, size_t rowWords) {
+    int words = (width + WORD_BITS - 1) / WORD_BITS;
+
+    if (storageMode == STORAGE_PACKED) {
+        for (int y = 0; y < height; y++) {
+            memcpy(bits + (size_t)y * rowWords, packedRow(packedCells, y),
+                   (size_t)words * sizeof(uint64_t));
+        }
+        return;
+    }
+    if (storageMode == STORAGE_CHUNKED) {
+        for (int y = 0; y < height; y++) {
+            uint64_t *row = bits + (size_t)y * rowWords;
+            for (int i = 0; i < words; i++) {
+                row[i] = chunkWord(i, y);
+            }
+            if (width % WORD_BITS != 0) {
+                // The plane goes on past the window; keep only the board
+                row[words - 1] &= ~(~UINT64_C(0) << (width % WORD_BITS));
             }
+        }
+        return;
+    }
 
-            // Bottom-right neighbor
-            if (cells[below][right] == ALIVE) {
-                numNeighbors++;
+    for (int y = 0; y < height; y++) {
+        memset(bits + (size_t)y * rowWords, 0, (size_t)words * sizeof(uint64_t));
+    }
+    if (storageMode == STORAGE_SPARSE) {
+        for (size_t i = 0; i < numLiveCells; i++) {
+            uint64_t x = liveCells[i] % (uint64_t)width;
+            uint64_t y = liveCells[i] / (uint64_t)width;
+            bits[y * rowWords + x / WORD_BITS] |= UINT64_C(1) << (x % WORD_BITS);
+        }
+        return;
+    }
+    for (int y = 0; y < height; y++) {
+        const char *row = cellRow(cells, y);
+        uint64_t *packed = bits + (size_t)y * rowWords;
+        for (int x = 0; x < width; x++) {
+            packed[x / WORD_BITS] |= (uint64_t)(row[x] == ALIVE) << (x % WORD_BITS);
+        }
+    }
+}
+
+/*
+ * boardWord - Word i of row y of the current generation, one bit per cell
+ *
+ * Bits past the right edge of the board are zero. Not for sparse storage.
+ */
+static uint64_t boardWord(int i, int y) {
+    int cellsLeft = width - i * WORD_BITS;
+    uint64_t word = 0;
+    if (storageMode == STORAGE_PACKED) {
+        word = packedRow(packedCells, y)[i];
+    } else if (storageMode == STORAGE_CHUNKED) {
+        word = chunkWord(i, y);
+    } else {
+        // ALIVE has bit 0 set and DEAD does not; the multiply gathers
+        // bit 0 of 8 chars into one byte
+        const char *row = cellRow(cells, y) + (size_t)i * WORD_BITS;
+        int count = cellsLeft < WORD_BITS ? cellsLeft : WORD_BITS;
+        for (int x = 0; x < count; x += 8) {
+            uint64_t chars = 0;
+            memcpy(&chars, row + x, (size_t)(count - x < 8 ? count - x : 8));
+            chars &= UINT64_C(0x0101010101010101);
+            word |= ((chars * UINT64_C(0x0102040810204080)) >> 56) << x;
+        }
+    }
+    if (cellsLeft < WORD_BITS) {
+        word &= ~(~UINT64_C(0) << cellsLeft);
+    }
+    return word;
+}
+
+/*
+ * bytePopcount - Live cells in each byte of a word, as a byte each
+ */
+static inline uint64_t bytePopcount(uint64_t word) {
+    word -= (word >> 1) & UINT64_C(0x5555555555555555);
+    word = (word & UINT64_C(0x3333333333333333)) + ((word >> 2) & UINT64_C(0x3333333333333333));
+    return (word + (word >> 4)) & UINT64_C(0x0F0F0F0F0F0F0F0F);
+}
+
+/*
+ * captureView - Fill a frame slot for --view: the pyramid, and the cells
+ *               around the view when it is zoomed in closer than a block
+ *
+ * Level 0 is counted 64 cells at a time: the byte counts of VIEW_BLOCK
+ * rows add up without carrying, since a block holds at most 64 cells.
+ */
+static void captureView(int slot) {
+    int boardWords = (width + WORD_BITS - 1) / WORD_BITS;
+    int levelCols = viewLevelCols[0];
+    uint8_t *blocks = frameRing.blocks[slot];
+
+    if (storageMode == STORAGE_SPARSE) {
+        memset(blocks, 0, (size_t)levelCols * (size_t)viewLevelRows[0]);
+        for (size_t i = 0; i < numLiveCells; i++) {
+            uint64_t x = liveCells[i] % (uint64_t)width;
+            uint64_t y = liveCells[i] / (uint64_t)width;
+            blocks[(y / VIEW_BLOCK) * (uint64_t)levelCols + x / VIEW_BLOCK]++;
+        }
+    } else {
+        for (int by = 0; by < viewLevelRows[0]; by++) {
+            memset(viewBlockSums, 0, (size_t)boardWords * sizeof(uint64_t));
+            for (int y = by * VIEW_BLOCK; y < (by + 1) * VIEW_BLOCK && y < height; y++) {
+                for (int i = 0; i < boardWords; i++) {
+                    viewBlockSums[i] += bytePopcount(boardWord(i, y));
+                }
             }
+            uint8_t *out = blocks + (size_t)by * (size_t)levelCols;
+            for (int i = 0; i < boardWords; i++) {
+                for (int b = 0; b < WORD_BITS / VIEW_BLOCK; b++) {
+                    *out++ = (uint8_t)(viewBlockSums[i] >> (8 * b));
+                }
+            }
+        }
+    }
 
-            // Apply Conway's rules to determine next state
-            // Rule 1: Living cell with 2 or 3 neighbors survives
-            if (cells[y][x] == ALIVE && (numNeighbors == 2 || numNeighbors == 3)) {
-                nextCells[y][x] = ALIVE;
+    // Every level above adds up 2x2 blocks of the one below
+    for (int level = 1; level < viewLevels; level++) {
+        uint32_t *out = frameRing.pyramid[slot] + viewLevelOffset[level];
+        int belowCols = viewLevelCols[level - 1];
+        int belowRows = viewLevelRows[level - 1];
+        for (int by = 0; by < viewLevelRows[level]; by++) {
+            for (int bx = 0; bx < viewLevelCols[level]; bx++) {
+                uint32_t sum = 0;
+                for (int dy = 0; dy < 2 && 2 * by + dy < belowRows; dy++) {
+                    for (int dx = 0; dx < 2 && 2 * bx + dx < belowCols; dx++) {
+                        sum += viewBlock(slot, level - 1, 2 * bx + dx, 2 * by + dy);
+                    }
+                }
+                *out++ = sum;
             }
-            // Rule 2: Dead cell with exactly 3 neighbors becomes alive (reproduction)
-            else if (cells[y][x] == DEAD && numNeighbors == 3) {
-                nextCells[y][x] = ALIVE;
+        }
+    }
+
+    // The cells around the view, a quarter of the view past each side
+    int zoom = atomic_load_explicit(&wantedZoom, memory_order_relaxed);
+    frameRing.windowWidth[slot] = 0;
+    if (zoom >= VIEW_BLOCK) {
+        return;
+    }
+    long marginX = (long)screenCols * dotsAcross * zoom / 4;
+    long marginY = (long)screenRows * dotsDown * zoom / 4;
+    long x0 = atomic_load_explicit(&wantedViewX, memory_order_relaxed) - marginX;
+    long y0 = atomic_load_explicit(&wantedViewY, memory_order_relaxed) - marginY;
+    int firstWord = x0 < 0 ? 0 : (int)(x0 / WORD_BITS);
+    int windowY = y0 < 0 ? 0 : (int)y0;
+    int words = boardWords - firstWord < frameWords ? boardWords - firstWord : frameWords;
+    int rows = height - windowY < frameRows ? height - windowY : frameRows;
+    uint64_t *bits = frameRing.bits[slot];
+
+    if (storageMode == STORAGE_SPARSE) {
+        memset(bits, 0, (size_t)frameWords * (size_t)frameRows * sizeof(uint64_t));
+        for (size_t i = 0; i < numLiveCells; i++) {
+            uint64_t x = liveCells[i] % (uint64_t)width;
+            uint64_t y = liveCells[i] / (uint64_t)width;
+            if (y >= (uint64_t)windowY && y < (uint64_t)(windowY + rows)
+                && x / WORD_BITS >= (uint64_t)firstWord && x / WORD_BITS < (uint64_t)(firstWord + words)) {
+                bits[(y - (uint64_t)windowY) * (uint64_t)frameWords + x / WORD_BITS - (uint64_t)firstWord]
+                    |= UINT64_C(1) << (x % WORD_BITS);
             }
-            // Rule 3: All other cells die or stay dead (overpopulation/underpopulation)
-            else {
-                nextCells[y][x] = DEAD;
+        }
+    } else {
+        for (int r = 0; r < rows; r++) {
+            for (int i = 0; i < words; i++) {
+                bits[(size_t)r * (size_t)frameWords + (size_t)i] = boardWord(firstWord + i, windowY + r);
             }
         }
     }
+    frameRing.windowX[slot] = firstWord * WORD_BITS;
+    frameRing.windowY[slot] = windowY;
+    frameRing.windowWidth[slot] = width - firstWord * WORD_BITS < words * WORD_BITS
+                                ? width - firstWord * WORD_BITS : words * WORD_BITS;
+    frameRing.windowHeight[slot] = rows;
 }
 
 /*
- * copyGrid - Copy nextCells array into cells array
+ * publishFrame - Hand the current generation to the renderer, if there is room
  *
- * This prepares the next generation to become the current generation.
- * We use memcpy for efficient memory copying.
+ * Runs on the simulation thread, the ring's only producer. The slots
+ * from tail to head belong to the renderer; when all of them are taken
+ * the generation is dropped instead of waiting.
  */
-void copyGrid(void) {
-    // memcpy(destination, source, number_of_bytes)
-    // Copies a block of memory from source to destination
-    // sizeof(cells) gives us the total size of the 2D array in bytes
-    // This is more efficient than nested loops for copying
-    memcpy(cells, nextCells, sizeof(cells));
+static void publishFrame(unsigned long long generation) {
+    size_t head = atomic_load_explicit(&frameRing.head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&frameRing.tail, memory_order_acquire);
+    if (head - tail == FRAME_SLOTS) {
+        atomic_fetch_add_explicit(&framesDropped, 1, memory_order_relaxed);
+        return;
+    }
+    if (viewGlyphs != VIEW_OFF) {
+        captureView((int)(head % FRAME_SLOTS));
+    } else {
+        captureFrame(frameRing.bits[head % FRAME_SLOTS], (size_t)frameWords);
+    }
+    frameRing.generation[head % FRAME_SLOTS] = generation;
+    // Release: the frame's contents are visible before the new head
+    atomic_store_explicit(&frameRing.head, head + 1, memory_order_release);
 }
 
 /*
- * handleSignal - Signal handler for Ctrl-C (SIGINT)
+ * takeNewestFrame - Make the newest published frame the shown one
  *
- * When the user presses Ctrl-C, this function is called.
- * We set a flag to exit gracefully rather than terminating abruptly.
+ * Runs on the main thread, the ring's only consumer. The shown frame
+ * stays held (it is redrawn when the view moves); the frames between it
+ * and the newest one are released unseen and counted as dropped.
  *
- * Parameters:
- *   signal - The signal number (SIGINT in our case)
+ * Returns:
+ *   1 if there is a new frame to draw, 0 if not
  */
-void handleSignal(int signal) {
-    // Mark that we should exit the main loop
-    // volatile sig_atomic_t ensures this write is atomic and visible
-    // across signal handlers and main program
-    shouldExit = 1;
+int takeNewestFrame(void) {
+    size_t head = atomic_load_explicit(&frameRing.head, memory_order_acquire);
+    size_t tail = atomic_load_explicit(&frameRing.tail, memory_order_relaxed);
+    size_t newest = head - 1;
+    if (head == 0 || (shownFrame != NULL && newest == tail)) {
+        return 0;
+    }
+    atomic_fetch_add_explicit(&framesDropped, newest - tail - (shownFrame != NULL),
+                              memory_order_relaxed);
+    shownFrame = frameRing.bits[newest % FRAME_SLOTS];
+    shownSlot = (int)(newest % FRAME_SLOTS);
+    shownGeneration = frameRing.generation[newest % FRAME_SLOTS];
+    // Release: we are done reading the older slots before the producer reuses them
+    atomic_store_explicit(&frameRing.tail, newest, memory_order_release);
+    return 1;
+}
 
-    // Note: We don't do complex operations here because signal handlers
-    // should be kept simple and fast
+/*
+ * showNewestFrame - Draw the newest published frame, if there is one
+ *
+ * Runs on the main thread, with the renderer chosen by --render.
+ */
+void showNewestFrame(void) {
+    if (!takeNewestFrame()) {
+        return;
+    }
+    if (renderMode == RENDER_FULL) {
+        // Clear the screen for the new frame (the diff renderer
+        // overwrites the old frame in place instead)
+        uint64_t traceStart = traceBegin();
+        clearScreen();
+        traceEnd(TRACE_CLEAR, traceStart, -1);
+        traceStart = traceBegin();
+        printGrid();
+        traceEnd(TRACE_PRINT, traceStart, -1);
+    } else {
+        uint64_t traceStart = traceBegin();
+        drawFrame();
+        traceEnd(TRACE_DRAW, traceStart, -1);
+    }
 }
 
 /*
- * clearScreen - Clear the terminal screen
+ * simulationMain - Body of the simulation thread
  *
- * This function uses ANSI escape sequences to clear the screen.
- * ANSI escape codes are special character sequences that control
- * terminal behavior.
+ * Publishes each generation and steps the board, --rate times a second
+ * or as fast as it can. It is the only thread that drives the worker
+ * pool while the animation runs.
  */
-void clearScreen(void) {
-    // Print ANSI escape sequence to clear screen and move cursor to top-left
-    // \033 is the ESC character (octal 033 = decimal 27)
-    // [2J clears the entire screen
-    // [H moves cursor to home position (top-left)
-    printf("\033[2J\033[H");
+void *simulationMain(void *arg) {
+    (void)arg;
+    traceThread("simulation");
+    unsigned long long generation = startGeneration;
+    double nextStep = monotonicSeconds();
 
-    // Alternative method (less portable but simpler):
-    // system("clear");  // On Unix/Linux/Mac
-    // system("cls");    // On Windows
+    while (!shouldExit) {
+        // Make nextCells the current generation (swaps the buffers)
+        copyGrid();
+        if (cycleMode != CYCLES_OFF) {
+            generation = watchForCycles(generation, jumpTarget);
+        }
+        currentGeneration = generation;
+        recordStats(generation);
+        publishFrame(generation);
+        maybeCheckpoint(generation);
+        maybeDump(generation);
+        if (cycleMode == CYCLES_STOP && atomic_load(&cyclePeriod) > 0) {
+            atomic_store(&shouldExit, 1);
+            break;
+        }
 
-    // Flush output buffer to ensure immediate display
-    // fflush() forces all buffered output to be written immediately
-    fflush(stdout);
+        // Compute what the next generation will look like
+        // based on the rules (Conway's unless --rule says otherwise)
+        // Without memory for it the run ends on the current generation
+        if (!calculateNextGeneration()) {
+            simulationFailed = 1;
+            atomic_store(&shouldExit, 1);
+            break;
+        }
+        generation += (unsigned long long)temporalDepth;
+
+        if (simulationRate > 0) {
+            // Falling behind does not cause a burst of catch-up steps
+            nextStep += 1.0 / simulationRate;
+            double now = monotonicSeconds();
+            if (nextStep < now) {
+                nextStep = now;
+            }
+            sleepUntil(nextStep);
+        }
+    }
+    return NULL;
+}
+
+/*
+ * calculateNextGeneration - Advance the simulation by one generation
+ *
+ * Refreshes the ghost cells, then steps the board. With --threads the
+ * board is split into one band of rows per thread and the worker pool
+ * steps all bands at the same time. With change tracking or --schedule
+ * steal the board is stepped tile by tile instead (see scheduleTiles).
+ * With --temporal K each call advances K generations (see
+ * stepTemporalBand).
+ *
+ * Returns:
+ *   1 on success, 0 if memory ran out; the current generation is kept
+ */
+int calculateNextGeneration(void) {
+    uint64_t traceStart = traceBegin();
+
+    // The sparse and chunked engines work on their own, single-threaded
+    if (storageMode == STORAGE_SPARSE) {
+        int ok = stepSparse();
+        traceEnd(TRACE_STEP, traceStart, -1);
+        return ok;
+    }
+    if (storageMode == STORAGE_CHUNKED) {
+        int ok = stepChunks();
+        traceEnd(TRACE_STEP, traceStart, -1);
+        return ok;
+    }
+
+    // Wraparound comes from the ghost cells, refreshed once per generation
+    if (storageMode == STORAGE_PACKED) {
+        refreshPackedGhostRows(packedCells);
+    } else {
+        refreshGhostCells(cells);
+    }
+
+    // Pick the tiles worth stepping and deal them out to the deques
+    if (usingTiles()) {
+        scheduleTiles();
+    }
+
+    if (numThreads == 1) {
+        stepWorker(0);
+    } else {
+        // Release the workers, step our own band, then wait for the others.
+        // The barriers also make every write of this generation visible to
+        // all threads before anyone reads it in the next one
+        pthread_barrier_wait(&stepStart);
+        stepWorker(0);
+        uint64_t waitStart = traceBegin();
+        pthread_barrier_wait(&stepDone);
+        traceEnd(TRACE_WAIT, waitStart, 0);
+    }
+
+    // Add up what the kernels counted
+    if (collectStats) {
+        gatherStats();
+    }
+    traceEnd(TRACE_STEP, traceStart, -1);
+    return 1;
+}
+
+/*
+ * stepRegion - Step one rectangle of the board with the selected kernel
+ *
+ * Dispatches to the step function for the selected storage mode, and
+ * for the char grid to the kernel picked by selectKernel().
+ */
+struct RegionStats stepRegion(int xBegin, int yBegin, int xEnd, int yEnd) {
+    if (storageMode == STORAGE_PACKED) {
+        return packedKernel(xBegin, yBegin, xEnd, yEnd);
+    }
+    return charKernel(xBegin, yBegin, xEnd, yEnd);
+}
+
+/*
+ * stepWorker - One thread's share of a generation
+ *
+ * Worker 0 is the main thread.
+ */
+void stepWorker(int worker) {
+    if (ltlRule.radius > 0) {
+        stepLtlWorker(worker);
+    } else if (temporalDepth > 1) {
+        stepTemporalBand(worker);
+    } else if (usingTiles()) {
+        runTiles(worker);
+    } else {
+        stepBand(worker);
+    }
+}
+
+/*
+ * stepBand - Step the band of rows owned by one worker
+ *
+ * The board is cut into numThreads bands of (nearly) equal height.
+ * Worker 0 is the main thread.
+ */
+void stepBand(int worker) {
+    int yBegin = (int)((long long)height * worker / numThreads);
+    int yEnd = (int)((long long)height * (worker + 1) / numThreads);
+    uint64_t traceStart = traceBegin();
+    workerStats[worker] = stepRegion(0, yBegin, width, yEnd);
+    traceEnd(TRACE_BAND, traceStart, worker);
+}
+
+/*
+ * usingTiles - Whether generations are stepped tile by tile
+ *
+ * Plain row bands are only used when change tracking is off and the
+ * schedule is bands; everything else works on tiles. Temporal blocking
+ * has blocks of its own: a tile that did not change in one generation
+ * may well change within K. Larger-than-Life rules rebuild their table
+ * for the whole board anyway and always go by bands.
+ */
+int usingTiles(void) {
+    return temporalDepth == 1 && ltlRule.radius == 0 && (trackChanges || schedule == SCHEDULE_STEAL);
+}
+
+/*
+ * markAllTilesChanged - Forget what is known about the tiles
+ *
+ * Called whenever the board is replaced wholesale (random fill, HashLife
+ * jump): every tile is stepped again until it has settled.
+ */
+void markAllTilesChanged(void) {
+    if (tileChanged != NULL) {
+        memset(tileChanged, 1, (size_t)numTiles);
+        memset(tileChangedNext, 1, (size_t)numTiles);
+    }
+}
+
+/*
+ * allocateTiles - Allocate the tile flags and the per-thread deques
+ *
+ * Returns:
+ *   1 on success, 0 if memory ran out
+ */
+int allocateTiles(void) {
+    tileCols = (width + TILE_WIDTH - 1) / TILE_WIDTH;
+    tileRows = (height + TILE_HEIGHT - 1) / TILE_HEIGHT;
+    numTiles = tileCols * tileRows;
+
+    tileChanged = malloc((size_t)numTiles);
+    tileChangedNext = malloc((size_t)numTiles);
+    activeTiles = malloc(sizeof(int) * (size_t)numTiles);
+    deques = aligned_alloc(CACHE_LINE, sizeof(struct TileDeque) * (size_t)numThreads);
+    dequeStorage = malloc(sizeof(int) * (size_t)numTiles * (size_t)numThreads);
+    tileHashes = calloc((size_t)numTiles, sizeof(uint64_t));
+    tileHashesNext = malloc(sizeof(uint64_t) * (size_t)numTiles);
+    tileStats = malloc(sizeof(struct RegionStats) * (size_t)numTiles);
+    if (tileChanged == NULL || tileChangedNext == NULL || activeTiles == NULL
+        || deques == NULL || dequeStorage == NULL || tileHashes == NULL || tileHashesNext == NULL
+        || tileStats == NULL) {
+        return 0;
+    }
+
+    markAllTilesChanged();
+    for (int i = 0; i < numThreads; i++) {
+        atomic_init(&deques[i].top, 0);
+        atomic_init(&deques[i].bottom, 0);
+        deques[i].tiles = dequeStorage + (size_t)i * numTiles;
+    }
+    return 1;
+}
+
+/*
+ * freeTiles - Release the tile flags and deques
+ */
+void freeTiles(void) {
+    free(tileChanged);
+    free(tileChangedNext);
+    free(activeTiles);
+    free(deques);
+    free(dequeStorage);
+    free(tileHashes);
+    free(tileHashesNext);
+    free(tileStats);
+    tileChanged = tileChangedNext = NULL;
+    tileHashes = tileHashesNext = NULL;
+    tileStats = NULL;
+    activeTiles = NULL;
+    deques = NULL;
+    dequeStorage = NULL;
+}
+
+/*
+ * tileBounds - Cell rectangle covered by a tile
+ *
+ * Tiles in the last column and row are cut off at the board edge.
+ */
+static inline void tileBounds(int tile, int *xBegin, int *yBegin, int *xEnd, int *yEnd) {
+    int tx = tile % tileCols;
+    int ty = tile / tileCols;
+    *xBegin = tx * TILE_WIDTH;
+    *yBegin = ty * TILE_HEIGHT;
+    *xEnd = *xBegin + TILE_WIDTH < width ? *xBegin + TILE_WIDTH : width;
+    *yEnd = *yBegin + TILE_HEIGHT < height ? *yBegin + TILE_HEIGHT : height;
+}
+
+/*
+ * tileDiffers - Whether a tile of nextCells differs from the same tile of cells
+ *
+ * The tile has just been written, so both copies are still in cache and
+ * the comparison costs a fraction of the step itself.
+ */
+static int tileDiffers(int tile) {
+    int xBegin, yBegin, xEnd, yEnd;
+    tileBounds(tile, &xBegin, &yBegin, &xEnd, &yEnd);
+
+    for (int y = yBegin; y < yEnd; y++) {
+        int differs;
+        if (storageMode == STORAGE_PACKED) {
+            // Tiles start on a word boundary; the last word of a row also
+            // holds only zero padding past the board edge
+            int firstWord = xBegin / WORD_BITS;
+            int lastWord = (xEnd + WORD_BITS - 1) / WORD_BITS;
+            differs = memcmp(packedRow(packedNextCells, y) + firstWord,
+                             packedRow(packedCells, y) + firstWord,
+                             sizeof(uint64_t) * (size_t)(lastWord - firstWord));
+        } else {
+            differs = memcmp(cellRow(nextCells, y) + xBegin, cellRow(cells, y) + xBegin,
+                             (size_t)(xEnd - xBegin));
+        }
+        if (differs) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * scheduleTiles - Choose the tiles to step and fill the deques
+ *
+ * A tile whose 3x3 block of tiles (wrapping around the board) did not
+ * change in the last generation will not change in this one either, so
+ * it is not scheduled at all. No copying is needed to carry it forward:
+ * nextCells holds the generation before cells, and for an unchanged
+ * tile that is exactly what cells holds too. By induction this stays
+ * true for as long as the tile is skipped.
+ *
+ * The scheduled tiles are handed out in contiguous runs, one run per
+ * thread, so each thread starts on tiles that are close together.
+ */
+void scheduleTiles(void) {
+    numActiveTiles = 0;
+
+    for (int tile = 0; tile < numTiles; tile++) {
+        int tx = tile % tileCols;
+        int ty = tile / tileCols;
+        int busy = !trackChanges;
+
+        for (int dy = -1; dy <= 1 && !busy; dy++) {
+            int ny = (ty + dy + tileRows) % tileRows;
+            for (int dx = -1; dx <= 1; dx++) {
+                int nx = (tx + dx + tileCols) % tileCols;
+                if (tileChanged[ny * tileCols + nx]) {
+                    busy = 1;
+                    break;
+                }
+            }
+        }
+
+        if (busy) {
+            activeTiles[numActiveTiles++] = tile;
+        } else {
+            tileChangedNext[tile] = 0;
+        }
+    }
+
+    // Deal the tiles out. This runs before the workers are released, so
+    // plain stores are enough; the stepStart barrier publishes them
+    for (int w = 0; w < numThreads; w++) {
+        int first = (int)((long long)numActiveTiles * w / numThreads);
+        int last = (int)((long long)numActiveTiles * (w + 1) / numThreads);
+        memcpy(deques[w].tiles, activeTiles + first, sizeof(int) * (size_t)(last - first));
+        atomic_store(&deques[w].top, 0);
+        atomic_store(&deques[w].bottom, last - first);
+    }
+}
+
+/*
+ * stepTile - Step one tile and record whether it changed
+ */
+void stepTile(int tile) {
+    uint64_t traceStart = traceBegin();
+    int xBegin, yBegin, xEnd, yEnd;
+    tileBounds(tile, &xBegin, &yBegin, &xEnd, &yEnd);
+
+    tileStats[tile] = stepRegion(xBegin, yBegin, xEnd, yEnd);
+    tileChangedNext[tile] = !trackChanges || tileDiffers(tile);
+
+    // Hash a changed tile for cycle detection while it is still in cache
+    if (cycleMode != CYCLES_OFF && tileChangedNext[tile]) {
+        tileHashesNext[tile] = hashTile(tile, 1);
+    }
+    traceEnd(TRACE_TILE, traceStart, tile);
+}
+
+// Results of takeTile / stealTile besides a tile number
+#define DEQUE_EMPTY (-1)    // Nothing left in this deque
+#define DEQUE_RETRY (-2)    // Lost a race with another thread, try again
+
+/*
+ * takeTile - Owner pops a tile from the bottom of its own deque
+ *
+ * Only the last tile can be contended; in that case the owner and a
+ * thief race on top with a compare-and-swap and exactly one wins.
+ */
+static int takeTile(struct TileDeque *deque) {
+    long bottom = atomic_load(&deque->bottom) - 1;
+    atomic_store(&deque->bottom, bottom);
+    long top = atomic_load(&deque->top);
+
+    if (top > bottom) {
+        // Already empty: undo the decrement
+        atomic_store(&deque->bottom, bottom + 1);
+        return DEQUE_EMPTY;
+    }
+
+    int tile = deque->tiles[bottom];
+    if (top == bottom) {
+        if (!atomic_compare_exchange_strong(&deque->top, &top, top + 1)) {
+            tile = DEQUE_EMPTY;
+        }
+        atomic_store(&deque->bottom, bottom + 1);
+    }
+    return tile;
+}
+
+/*
+ * stealTile - Another thread takes a tile from the top of a deque
+ */
+static int stealTile(struct TileDeque *deque) {
+    long top = atomic_load(&deque->top);
+    long bottom = atomic_load(&deque->bottom);
+
+    if (top >= bottom) {
+        return DEQUE_EMPTY;
+    }
+    int tile = deque->tiles[top];
+    if (!atomic_compare_exchange_strong(&deque->top, &top, top + 1)) {
+        return DEQUE_RETRY;
+    }
+    return tile;
+}
+
+/*
+ * runTiles - Step tiles until every deque is empty
+ *
+ * A worker first works through its own deque. With --schedule steal it
+ * then visits the other deques in turn and steals from their tops. No tiles are added during
+ * a generation, so once a full pass finds every deque empty (and no
+ * steal was merely lost to a race) the generation's work is done.
+ */
+void runTiles(int worker) {
+    struct TileDeque *own = &deques[worker];
+    int tile;
+
+    for (;;) {
+        while ((tile = takeTile(own)) >= 0) {
+            stepTile(tile);
+        }
+        if (schedule != SCHEDULE_STEAL) {
+            return;
+        }
+
+        int stole = 0;
+        int retry = 0;
+        for (int i = 1; i < numThreads && !stole; i++) {
+            tile = stealTile(&deques[(worker + i) % numThreads]);
+            if (tile >= 0) {
+                stepTile(tile);
+                stole = 1;
+            } else if (tile == DEQUE_RETRY) {
+                retry = 1;
+            }
+        }
+        if (!stole && !retry) {
+            return;
+        }
+    }
+}
+
+/*
+ * workerMain - Body of each helper thread in the pool
+ *
+ * Waits at stepStart until the main thread starts a generation, steps
+ * its share and meets everyone at stepDone. This repeats until the pool
+ * is shut down.
+ *
+ * Parameters:
+ *   arg - The worker number (1 .. numThreads-1), smuggled in a pointer
+ */
+void *workerMain(void *arg) {
+    int worker = (int)(intptr_t)arg;
+    char name[32];
+    snprintf(name, sizeof name, "worker %d", worker);
+
+    // Wait until startWorkerPool knows whether the whole pool came up
+    pthread_mutex_lock(&poolGateLock);
+    while (poolGate == 0) {
+        pthread_cond_wait(&poolGateChanged, &poolGateLock);
+    }
+    int run = poolGate > 0;
+    pthread_mutex_unlock(&poolGateLock);
+    if (!run) {
+        return NULL;
+    }
+    traceThread(name);
+
+    for (;;) {
+        pthread_barrier_wait(&stepStart);
+        if (poolShutdown) {
+            break;
+        }
+        stepWorker(worker);
+        uint64_t waitStart = traceBegin();
+        pthread_barrier_wait(&stepDone);
+        traceEnd(TRACE_WAIT, waitStart, worker);
+    }
+    return NULL;
+}
+
+/*
+ * startWorkerPool - Create the helper threads for --threads
+ *
+ * The helpers wait behind poolGate until all of them exist. The barriers
+ * need every thread, so if one cannot be created the others are sent
+ * home before they ever reach a barrier, and the program carries on
+ * with the main thread alone.
+ *
+ * Returns:
+ *   1 on success, 0 if the threads could not be created; numThreads is
+ *   then 1
+ */
+int startWorkerPool(void) {
+    poolShutdown = 0;
+    if (numThreads == 1) {
+        return 1;
+    }
+
+    workers = malloc(sizeof(pthread_t) * (size_t)numThreads);
+    if (workers == NULL) {
+        numThreads = 1;
+        return 0;
+    }
+
+    // Every barrier wait needs all numThreads threads, main included
+    pthread_barrier_init(&stepStart, NULL, (unsigned)numThreads);
+    pthread_barrier_init(&stepDone, NULL, (unsigned)numThreads);
+    pthread_barrier_init(&ltlPhase, NULL, (unsigned)numThreads);
+
+    poolGate = 0;
+    int started = 1;
+    while (started < numThreads
+           && pthread_create(&workers[started], NULL, workerMain, (void *)(intptr_t)started) == 0) {
+        started++;
+    }
+
+    pthread_mutex_lock(&poolGateLock);
+    poolGate = started == numThreads ? 1 : -1;
+    pthread_cond_broadcast(&poolGateChanged);
+    pthread_mutex_unlock(&poolGateLock);
+    if (started == numThreads) {
+        return 1;
+    }
+
+    fprintf(stderr, "pthread_create failed for worker %d\n", started);
+    for (int i = 1; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    pthread_barrier_destroy(&stepStart);
+    pthread_barrier_destroy(&stepDone);
+    pthread_barrier_destroy(&ltlPhase);
+    free(workers);
+    workers = NULL;
+    numThreads = 1;
+    return 0;
+}
+
+/*
+ * stopWorkerPool - Shut the helper threads down and wait for them
+ */
+void stopWorkerPool(void) {
+    if (workers == NULL) {
+        return;
+    }
+
+    // Wake the workers one last time with the shutdown flag set
+    poolShutdown = 1;
+    pthread_barrier_wait(&stepStart);
+
+    for (int i = 1; i < numThreads; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    pthread_barrier_destroy(&stepStart);
+    pthread_barrier_destroy(&stepDone);
+    pthread_barrier_destroy(&ltlPhase);
+    free(workers);
+    workers = NULL;
+}
+
+/*
+ * growBoxRow / growBoxChars / growBoxWords - Widen a kernel's bounding
+ *                                          box to one row
+ *
+ * Called once for each row of the region that has live cells. Only the
+ * cells left and right of the box so far are looked at, so once the box
+ * spans the region a row costs two compares. growBoxWords takes packed
+ * words, the first of which holds cell xBase.
+ *
+ * The SIMD kernels already hold each vector's live cells as a lane
+ * mask. They note the leftmost and rightmost vectors with live cells in
+ * a LaneBox as they go - with selects, not branches, since on ash a
+ * vector is live or empty at random - and widen the box from those two
+ * masks once per row instead of scanning the row again. Vectors that
+ * lie inside the box so far cannot widen it and are not looked at;
+ * after the first few rows that leaves only the ends of each row.
+ */
+static inline void growBoxRow(struct RegionStats *stats, long long y) {
+    if (y < stats->yMin) {
+        stats->yMin = y;
+    }
+    if (y > stats->yMax) {
+        stats->yMax = y;
+    }
+}
+
+static inline void growBoxChars(struct RegionStats *stats, const char *row, int xBegin, int xEnd, int y) {
+    growBoxRow(stats, y);
+    for (int x = xBegin; x < xEnd && x < stats->xMin; x++) {
+        if (row[x] == ALIVE) {
+            stats->xMin = x;
+            break;
+        }
+    }
+    for (int x = xEnd - 1; x >= xBegin && x > stats->xMax; x--) {
+        if (row[x] == ALIVE) {
+            stats->xMax = x;
+            break;
+        }
+    }
+}
+
+static inline void growBoxWords(struct RegionStats *stats, const uint64_t *words, int count,
+                                long long xBase, long long y) {
+    growBoxRow(stats, y);
+    for (int i = 0; i < count && xBase + (long long)WORD_BITS * i < stats->xMin; i++) {
+        if (words[i] != 0) {
+            long long x = xBase + (long long)WORD_BITS * i + __builtin_ctzll(words[i]);
+            if (x < stats->xMin) {
+                stats->xMin = x;
+            }
+            break;
+        }
+    }
+    for (int i = count - 1; i >= 0 && xBase + (long long)WORD_BITS * i + WORD_BITS - 1 > stats->xMax; i--) {
+        if (words[i] != 0) {
+            long long x = xBase + (long long)WORD_BITS * i + WORD_BITS - 1 - __builtin_clzll(words[i]);
+            if (x > stats->xMax) {
+                stats->xMax = x;
+            }
+            break;
+        }
+    }
+}
+
+struct LaneBox {
+    uint64_t first, last;   // Lane masks of the leftmost/rightmost live vectors; 0 = none yet
+    int firstX, lastX;      // Their first columns
+};
+
+static inline void trackLanes(struct LaneBox *box, uint64_t live, int x) {
+    box->firstX = box->first != 0 ? box->firstX : x;
+    box->first = box->first != 0 ? box->first : live;
+    box->lastX = live != 0 ? x : box->lastX;
+    box->last = live != 0 ? live : box->last;
+}
+
+static inline void growBoxLanes(struct RegionStats *stats, const struct LaneBox *box) {
+    if (box->last == 0) {
+        return;
+    }
+    long long first = box->firstX + __builtin_ctzll(box->first);
+    long long last = box->lastX + WORD_BITS - 1 - __builtin_clzll(box->last);
+    stats->xMin = first < stats->xMin ? first : stats->xMin;
+    stats->xMax = last > stats->xMax ? last : stats->xMax;
+}
+
+/*
+ * mergeRegionStats - Add the stats of one region to those of another
+ */
+static inline void mergeRegionStats(struct RegionStats *total, const struct RegionStats *part) {
+    total->population += part->population;
+    total->changed += part->changed;
+    total->xMin = part->xMin < total->xMin ? part->xMin : total->xMin;
+    total->yMin = part->yMin < total->yMin ? part->yMin : total->yMin;
+    total->xMax = part->xMax > total->xMax ? part->xMax : total->xMax;
+    total->yMax = part->yMax > total->yMax ? part->yMax : total->yMax;
+}
+
+/*
+ * calculateNextGenerationChar - Apply Conway's Game of Life rules
+ *
+ * Conway's Rules:
+ * 1. Any live cell with 2 or 3 live neighbors survives
+ * 2. Any dead cell with exactly 3 live neighbors becomes alive
+ * 3. All other cells die or remain dead
+ *
+ * This function examines each cell and its 8 neighbors to determine
+ * the cell's state in the next generation. This is the reference
+ * implementation that every other step function is checked against.
+ */
+struct RegionStats calculateNextGenerationChar(int xBegin, int yBegin, int xEnd, int yEnd) {
+    const int countStats = collectStats;    // Read once: the stores below may alias it
+    struct RegionStats stats = EMPTY_REGION;
+
+    // Loop through every cell in the region
+    for (int y = yBegin; y < yEnd; y++) {
+        // The board wraps around (toroidal topology), but the ghost cells
+        // already hold the wrapped neighbors: row -1 is a copy of the last
+        // row, and column -1 of each row is a copy of its last cell
+        const char *above = cellRow(cells, y - 1);  // Row above
+        const char *row = cellRow(cells, y);        // This row
+        const char *below = cellRow(cells, y + 1);  // Row below
+        char *next = cellRow(nextCells, y);
+        long long rowStart = stats.population;
+
+        for (int x = xBegin; x < xEnd; x++) {
+            int left = x - 1;       // Column to the left (may be ghost -1)
+            int right = x + 1;      // Column to the right (may be ghost width)
+
+            // Count living neighbors among the 8 surrounding cells
+            // We check each of the 8 positions around (x, y)
+            int numNeighbors = 0;
+
+            // Top-left neighbor
+            if (above[left] == ALIVE) {
+                numNeighbors++;
+            }
+
+            // Top neighbor (directly above)
+            if (above[x] == ALIVE) {
+                numNeighbors++;
+            }
+
+            // Top-right neighbor
+            if (above[right] == ALIVE) {
+                numNeighbors++;
+            }
+
+            // Left neighbor (same row)
+            if (row[left] == ALIVE) {
+                numNeighbors++;
+            }
+
+            // Right neighbor (same row)
+            if (row[right] == ALIVE) {
+                numNeighbors++;
+            }
+
+            // Bottom-left neighbor
+            if (below[left] == ALIVE) {
+                numNeighbors++;
+            }
+
+            // Bottom neighbor (directly below)
+            if (below[x] == ALIVE) {
+                numNeighbors++;
+            }
+
+            // Bottom-right neighbor
+            if (below[right] == ALIVE) {
+                numNeighbors++;
+            }
+
+            // Apply the rules to determine next state. compileRule() has
+            // worked out the answer for every cell state and neighbor
+            // count; for Conway's rules (B3/S23) the table says:
+            // Rule 1: Living cell with 2 or 3 neighbors survives
+            // Rule 2: Dead cell with exactly 3 neighbors becomes alive (reproduction)
+            // Rule 3: All other cells die or stay dead (overpopulation/underpopulation)
+            // Other rules (--rule) only change the table
+            next[x] = ruleTable[(unsigned char)row[x]][numNeighbors];
+
+            // Only --stats reads the counts
+            if (countStats) {
+                if (next[x] == ALIVE) {
+                    stats.population++;
+                }
+                // Births and deaths only: a dying cell that ages is neither
+                if ((next[x] == ALIVE) != (row[x] == ALIVE)) {
+                    stats.changed++;
+                }
+            }
+        }
+
+        // Only rows with live cells can widen the bounding box
+        if (countStats && stats.population > rowStart) {
+            growBoxChars(&stats, next, xBegin, xEnd, y);
+        }
+    }
+    return stats;
+}
+
+/*
+ * nextCellChar - The rules for a single cell of the char grid
+ *
+ * Same result as calculateNextGenerationChar, without the branches. The
+ * vector kernels use it for the few cells left over when a region does
+ * not end on a whole vector inside the board.
+ */
+static inline char nextCellChar(const char *above, const char *row, const char *below, int x) {
+    int numNeighbors = (above[x - 1] == ALIVE) + (above[x] == ALIVE) + (above[x + 1] == ALIVE)
+                     + (row[x - 1] == ALIVE) + (row[x + 1] == ALIVE)
+                     + (below[x - 1] == ALIVE) + (below[x] == ALIVE) + (below[x + 1] == ALIVE);
+
+    return ruleTable[(unsigned char)row[x]][numNeighbors];
+}
+
+/*
+ * generationsCell - The next char of a cell under a Generations rule,
+ *                   given whether B/S alone would make it ALIVE
+ *
+ * Dying cells age whatever their neighbors say, so kernels that only
+ * count live neighbors can use it to put the dying states back.
+ */
+static inline char generationsCell(char cell, int alive) {
+    if (cell == ALIVE) {
+        return alive ? ALIVE : DYING(2);
+    }
+    if (cell == DEAD) {
+        return alive ? ALIVE : DEAD;
+    }
+    return ruleTable[(unsigned char)cell][0];
+}
+
+/*
+ * calculateNextGenerationWindow - Conway's rules with a sliding window
+ *
+ * Neighboring cells share six of their eight neighbors, so instead of
+ * reloading all of them the kernel keeps the live counts of three
+ * columns (above + row + below) in a window: west, middle and east of
+ * the current cell. Moving one cell right drops the west column and
+ * reads only the three cells of the new east column - three loads and
+ * two adds per cell.
+ *
+ * The window count includes the cell itself, which turns the rules into:
+ *   alive next = window is 3, or window is 4 and the cell is alive
+ * and any other Life-like rule into one shift of lifeRule, in a second
+ * copy of the loop. A third copy reads Generations rules, dying states
+ * and all, from ruleTable. Each comes with and without the --stats
+ * counts.
+ */
+static inline __attribute__((always_inline))
+struct RegionStats windowKernelBody(int xBegin, int yBegin, int xEnd, int yEnd, int anyRule,
+                                    int generations, int countStats) {
+    static const char cellChars[2] = { DEAD, ALIVE };
+    struct RegionStats stats = EMPTY_REGION;
+    const uint32_t rule = lifeRule;
+
+    for (int y = yBegin; y < yEnd; y++) {
+        const char *up = cellRow(cells, y - 1);
+        const char *row = cellRow(cells, y);
+        const char *down = cellRow(cells, y + 1);
+        char *out = cellRow(nextCells, y);
+        long long rowStart = stats.population;
+
+        int west = (up[xBegin - 1] == ALIVE) + (row[xBegin - 1] == ALIVE) + (down[xBegin - 1] == ALIVE);
+        int middle = (up[xBegin] == ALIVE) + (row[xBegin] == ALIVE) + (down[xBegin] == ALIVE);
+
+        for (int x = xBegin; x < xEnd; x++) {
+            int east = (up[x + 1] == ALIVE) + (row[x + 1] == ALIVE) + (down[x + 1] == ALIVE);
+            int window = west + middle + east;
+            int self = row[x] == ALIVE;
+            int next;
+            if (generations) {
+                out[x] = ruleTable[(unsigned char)row[x]][window - self];
+                next = out[x] == ALIVE;
+            } else {
+                next = anyRule ? (int)(rule >> (window - self + (self << 4))) & 1
+                               : (window == 3) | ((window == 4) & self);
+                out[x] = cellChars[next];
+            }
+            if (countStats) {
+                stats.population += next;
+                stats.changed += next != self;
+            }
+            west = middle;
+            middle = east;
+        }
+        if (countStats && stats.population > rowStart) {
+            growBoxChars(&stats, out, xBegin, xEnd, y);
+        }
+    }
+    return stats;
+}
+
+struct RegionStats calculateNextGenerationWindow(int xBegin, int yBegin, int xEnd, int yEnd) {
+    if (ruleStates > 2) {
+        return windowKernelBody(xBegin, yBegin, xEnd, yEnd, 1, 1, collectStats);
+    }
+    if (collectStats) {
+        return lifeRule == CONWAY_RULE ? windowKernelBody(xBegin, yBegin, xEnd, yEnd, 0, 0, 1)
+                                       : windowKernelBody(xBegin, yBegin, xEnd, yEnd, 1, 0, 1);
+    }
+    return lifeRule == CONWAY_RULE ? windowKernelBody(xBegin, yBegin, xEnd, yEnd, 0, 0, 0)
+                                   : windowKernelBody(xBegin, yBegin, xEnd, yEnd, 1, 0, 0);
+}
+
+/*
+ * buildLifeTable - Fill lifeTable from the rules
+ *
+ * Each of the 65536 4x4 blocks is written out as cells and its middle
+ * 2x2 is stepped with nextCellChar, so the table always follows the same
+ * rules as the other char kernels.
+ */
+void buildLifeTable(void) {
+    for (int index = 0; index < (1 << 16); index++) {
+        char block[4][4];
+        for (int r = 0; r < 4; r++) {
+            for (int c = 0; c < 4; c++) {
+                block[r][c] = (index >> (4 * r + c)) & 1 ? ALIVE : DEAD;
+            }
+        }
+
+        int next = 0;
+        int population = 0;
+        for (int i = 0; i < 4; i++) {
+            int r = 1 + i / 2;
+            int c = 1 + i % 2;
+            if (nextCellChar(block[r - 1], block[r], block[r + 1], c) == ALIVE) {
+                next |= 1 << i;
+                population++;
+            }
+        }
+        lifeTable[index] = (uint8_t)(next | population << 4);
+    }
+}
+
+/*
+ * calculateNextGenerationLut - Conway's rules, 2x2 cells per table lookup
+ *
+ * Walks the region in 2x2 blocks. The 4x4 neighborhood of a block packs
+ * into a 16-bit index, and one load from lifeTable gives all four next
+ * states: no neighbor counting and no branches on cell values. Moving
+ * two columns right shifts out the two oldest columns of the index, so
+ * each block only reads 8 new cells.
+ *
+ * A fast path for CPUs without wide SIMD. A region with an odd width or
+ * height gets its last column or row from nextCellChar, so the kernel
+ * never writes outside its region. Under a Generations rule the table
+ * still says which cells live; generationsCell adds the dying states.
+ * The --stats counts come in a flavor of their own.
+ */
+static inline __attribute__((always_inline))
+struct RegionStats lutKernelBody(int xBegin, int yBegin, int xEnd, int yEnd, int generations,
+                                 int countStats) {
+    static const char cellChars[2] = { DEAD, ALIVE };
+    static const uint8_t nibbleBits[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+    struct RegionStats stats = EMPTY_REGION;
+    int y = yBegin;
+
+    for (; y + 1 < yEnd; y += 2) {
+        const char *rows[4] = { cellRow(cells, y - 1), cellRow(cells, y),
+                                cellRow(cells, y + 1), cellRow(cells, y + 2) };
+        char *out0 = cellRow(nextCells, y);
+        char *out1 = cellRow(nextCells, y + 1);
+        long long pairStart = stats.population;
+        long long top = 0;      // Live cells in out0
+
+        // Columns 2-3 of each row's nibble start as cells xBegin-1, xBegin
+        unsigned int index = 0;
+        for (int r = 0; r < 4; r++) {
+            index |= (unsigned int)((rows[r][xBegin - 1] == ALIVE) << 2
+                                  | (rows[r][xBegin] == ALIVE) << 3) << (4 * r);
+        }
+
+        int x = xBegin;
+        for (; x + 1 < xEnd; x += 2) {
+            // Columns 2-3 move to 0-1; cells x+1 and x+2 fill columns 2-3
+            index = (index >> 2) & 0x3333;
+            for (int r = 0; r < 4; r++) {
+                index |= (unsigned int)((rows[r][x + 1] == ALIVE) << 2
+                                      | (rows[r][x + 2] == ALIVE) << 3) << (4 * r);
+            }
+
+            unsigned int next = lifeTable[index];
+            if (generations) {
+                // A dying cell the table brings to life ages instead
+                out0[x] = generationsCell(rows[1][x], next & 1);
+                out0[x + 1] = generationsCell(rows[1][x + 1], (next >> 1) & 1);
+                out1[x] = generationsCell(rows[2][x], (next >> 2) & 1);
+                out1[x + 1] = generationsCell(rows[2][x + 1], (next >> 3) & 1);
+                next = (unsigned int)((out0[x] == ALIVE) | (out0[x + 1] == ALIVE) << 1
+                                    | (out1[x] == ALIVE) << 2 | (out1[x + 1] == ALIVE) << 3);
+                next |= (unsigned int)nibbleBits[next] << 4;
+            } else {
+                out0[x] = cellChars[next & 1];
+                out0[x + 1] = cellChars[(next >> 1) & 1];
+                out1[x] = cellChars[(next >> 2) & 1];
+                out1[x + 1] = cellChars[(next >> 3) & 1];
+            }
+            // Bits 5-6 of index hold cells x, x+1 of row y, bits 9-10 of row y+1
+            if (countStats) {
+                stats.population += next >> 4;
+                top += (next & 1) + ((next >> 1) & 1);
+                stats.changed += nibbleBits[(next ^ (index >> 5 & 3) ^ (index >> 7 & 0xC)) & 0xF];
+            }
+        }
+        if (x < xEnd) {
+            out0[x] = nextCellChar(rows[0], rows[1], rows[2], x);
+            out1[x] = nextCellChar(rows[1], rows[2], rows[3], x);
+            if (countStats) {
+                stats.population += (out0[x] == ALIVE) + (out1[x] == ALIVE);
+                top += out0[x] == ALIVE;
+                stats.changed += ((out0[x] == ALIVE) != (rows[1][x] == ALIVE))
+                               + ((out1[x] == ALIVE) != (rows[2][x] == ALIVE));
+            }
+        }
+        if (countStats && top > 0) {
+            growBoxChars(&stats, out0, xBegin, xEnd, y);
+        }
+        if (countStats && stats.population - pairStart > top) {
+            growBoxChars(&stats, out1, xBegin, xEnd, y + 1);
+        }
+    }
+
+    if (y < yEnd) {
+        const char *up = cellRow(cells, y - 1);
+        const char *row = cellRow(cells, y);
+        const char *down = cellRow(cells, y + 1);
+        char *out = cellRow(nextCells, y);
+        long long rowStart = stats.population;
+        for (int x = xBegin; x < xEnd; x++) {
+            out[x] = nextCellChar(up, row, down, x);
+            if (countStats) {
+                stats.population += out[x] == ALIVE;
+                stats.changed += (out[x] == ALIVE) != (row[x] == ALIVE);
+            }
+        }
+        if (countStats && stats.population > rowStart) {
+            growBoxChars(&stats, out, xBegin, xEnd, y);
+        }
+    }
+    return stats;
+}
+
+struct RegionStats calculateNextGenerationLut(int xBegin, int yBegin, int xEnd, int yEnd) {
+    if (ruleStates > 2) {
+        return lutKernelBody(xBegin, yBegin, xEnd, yEnd, 1, collectStats);
+    }
+    return collectStats ? lutKernelBody(xBegin, yBegin, xEnd, yEnd, 0, 1)
+                        : lutKernelBody(xBegin, yBegin, xEnd, yEnd, 0, 0);
+}
+
+/*
+ * packedWest - Word holding the west (left) neighbors of a packed word
+ *
+ * Bit x of the result is the cell one column to the left of cell x.
+ * Shifting left by one moves every cell one position "right" in bit
+ * order, and the bit shifted in comes from the previous word, or - for
+ * the first word - from the last cell of the row (toroidal wraparound).
+ *
+ * Parameters:
+ *   row - The packed row
+ *   i   - Index of the word within the row
+ */
+static inline uint64_t packedWest(const uint64_t *row, int i) {
+    uint64_t carry;
+    if (i > 0) {
+        carry = row[i - 1] >> (WORD_BITS - 1);
+    } else {
+        carry = (row[(width - 1) / WORD_BITS] >> ((width - 1) % WORD_BITS)) & 1;
+    }
+    return (row[i] << 1) | carry;
+}
+
+/*
+ * packedEast - Word holding the east (right) neighbors of a packed word
+ *
+ * Mirror image of packedWest: bit x of the result is the cell one column
+ * to the right of cell x. The last cell of the row wraps to cell 0.
+ */
+static inline uint64_t packedEast(const uint64_t *row, int i) {
+    uint64_t carry;
+    if (i < wordsPerRow - 1) {
+        carry = row[i + 1] << (WORD_BITS - 1);
+    } else {
+        carry = (row[0] & 1) << ((width - 1) % WORD_BITS);
+    }
+    return (row[i] >> 1) | carry;
+}
+
+/*
+ * fullAdd / halfAdd - Bitwise adders used by the packed kernel
+ *
+ * Each bit position is an independent 1-bit adder, so one call adds
+ * 64 columns at once. sum gets the low bit, carry the high bit.
+ */
+static inline void fullAdd(uint64_t a, uint64_t b, uint64_t c,
+                           uint64_t *sum, uint64_t *carry) {
+    uint64_t t = a ^ b;
+    *sum = t ^ c;
+    *carry = (a & b) | (t & c);
+}
+
+static inline void halfAdd(uint64_t a, uint64_t b, uint64_t *sum, uint64_t *carry) {
+    *sum = a ^ b;
+    *carry = a & b;
+}
+
+/*
+ * packedRuleWord - Any Life-like rule on the bit-planes of a neighbor count
+ *
+ * For each count n, bit x of ruleBirthWords[n] ^ (self & ruleFlipWords[n])
+ * is the next state of cell x if it has n neighbors: the birth bit for a
+ * dead cell, the survival bit for a live one. A tree of multiplexers
+ * then picks, in every bit position at once, the entry its count selects.
+ */
+static inline uint64_t packedRuleWord(uint64_t ones, uint64_t twos, uint64_t fours, uint64_t eights,
+                                      uint64_t self) {
+    uint64_t outcome[8];
+    for (int n = 0; n < 8; n++) {
+        outcome[n] = ruleBirthWords[n] ^ (self & ruleFlipWords[n]);
+    }
+
+    // a ^ (select & (a ^ b)) is b where select is set, else a
+    for (int n = 0; n < 8; n += 2) {
+        outcome[n] ^= ones & (outcome[n] ^ outcome[n + 1]);
+    }
+    for (int n = 0; n < 8; n += 4) {
+        outcome[n] ^= twos & (outcome[n] ^ outcome[n + 2]);
+    }
+    uint64_t next = outcome[0] ^ (fours & (outcome[0] ^ outcome[4]));
+
+    // A count of 8 leaves the other planes clear
+    uint64_t full = ruleBirthWords[8] ^ (self & ruleFlipWords[8]);
+    return next ^ (eights & (next ^ full));
+}
+
+/*
+ * packedNextWord - The rules for the 64 cells of one packed word
+ *
+ * Takes the word itself, the words above and below it, and each of those
+ * shifted by one cell west and east. Used by every packed stepper, so
+ * they all share one adder tree (see calculateNextGenerationPacked).
+ * anyRule selects packedRuleWord over the B3/S23 logic; callers pass a
+ * constant where they can, so each gets a loop for either.
+ */
+static inline uint64_t packedNextWord(uint64_t aboveWest, uint64_t above, uint64_t aboveEast,
+                                      uint64_t west, uint64_t self, uint64_t east,
+                                      uint64_t belowWest, uint64_t below, uint64_t belowEast,
+                                      int anyRule) {
+    uint64_t s0, c0, s1, c1, s2, c2, c3, t, c4, c5;
+    uint64_t ones, twos, fours;
+
+    // Stage 1: add the three rows of neighbors column-wise
+    fullAdd(aboveWest, above, aboveEast, &s0, &c0);
+    fullAdd(belowWest, below, belowEast, &s1, &c1);
+    halfAdd(west, east, &s2, &c2);
+
+    // Stage 2: combine the partial sums into ones/twos/fours planes
+    fullAdd(s0, s1, s2, &ones, &c3);
+    fullAdd(c0, c1, c2, &t, &c4);
+    halfAdd(t, c3, &twos, &c5);
+    fours = c4 ^ c5;
+
+    if (anyRule) {
+        return packedRuleWord(ones, twos, fours, c4 & c5, self);
+    }
+    return twos & ~fours & (ones | self);
+}
+
+/*
+ * calculateNextGenerationPacked - Conway's rules on the packed grid
+ *
+ * Instead of counting neighbors one cell at a time, the eight neighbor
+ * words of a word are added with a tree of full adders. The count for
+ * all 64 cells ends up as three bit-planes (ones, twos, fours), and the
+ * rules become plain boolean logic:
+ *
+ *   alive next = count is 2 or 3, and (count is 3 or cell is alive)
+ *              = twos & ~fours & (ones | alive)
+ *
+ * A count of 8 overflows to 0, which is still "dies", so the eights
+ * plane is not needed. No branches depend on cell values. Other rules
+ * (--rule) need all four planes and go through packedRuleWord.
+ *
+ * xBegin must be a multiple of 64 (tiles always are). The body is
+ * compiled twice, for plain x86-64 and with the POPCNT instruction for
+ * the population count; selectKernel picks one at startup. Each copy
+ * comes in flavors again: the population, the changed cells and the
+ * bounding box cost popcounts per word, so they are only taken with
+ * --stats, and B3/S23 gets its own loop.
+ */
+static inline __attribute__((always_inline))
+struct RegionStats packedKernelBody(int xBegin, int yBegin, int xEnd, int yEnd, int countStats,
+                                    int anyRule) {
+    struct RegionStats stats = EMPTY_REGION;
+    int iBegin = xBegin / WORD_BITS;
+    int iEnd = (xEnd + WORD_BITS - 1) / WORD_BITS;
+
+    for (int y = yBegin; y < yEnd; y++) {
+        // Rows wrap through the ghost rows; columns wrap inside
+        // packedWest/packedEast
+        const uint64_t *above = packedRow(packedCells, y - 1);
+        const uint64_t *row = packedRow(packedCells, y);
+        const uint64_t *below = packedRow(packedCells, y + 1);
+        uint64_t *out = packedRow(packedNextCells, y);
+        long long rowStart = stats.population;
+
+        for (int i = iBegin; i < iEnd; i++) {
+            uint64_t next = packedNextWord(packedWest(above, i), above[i], packedEast(above, i),
+                                           packedWest(row, i), row[i], packedEast(row, i),
+                                           packedWest(below, i), below[i], packedEast(below, i),
+                                           anyRule);
+
+            // Keep the unused bits past the last cell clear
+            if (i == wordsPerRow - 1) {
+                next &= lastWordMask;
+            }
+            out[i] = next;
+            if (countStats) {
+                stats.population += __builtin_popcountll(next);
+                stats.changed += __builtin_popcountll(next ^ row[i]);
+            }
+        }
+        if (countStats && stats.population > rowStart) {
+            growBoxWords(&stats, out + iBegin, iEnd - iBegin, (long long)WORD_BITS * iBegin, y);
+        }
+    }
+    return stats;
+}
+
+struct RegionStats calculateNextGenerationPacked(int xBegin, int yBegin, int xEnd, int yEnd) {
+    if (lifeRule != CONWAY_RULE) {
+        return packedKernelBody(xBegin, yBegin, xEnd, yEnd, collectStats, 1);
+    }
+    return collectStats ? packedKernelBody(xBegin, yBegin, xEnd, yEnd, 1, 0)
+                        : packedKernelBody(xBegin, yBegin, xEnd, yEnd, 0, 0);
+}
+
+#ifdef HAVE_X86_SIMD
+__attribute__((target("popcnt")))
+struct RegionStats calculateNextGenerationPackedPopcnt(int xBegin, int yBegin, int xEnd, int yEnd) {
+    if (lifeRule != CONWAY_RULE) {
+        return packedKernelBody(xBegin, yBegin, xEnd, yEnd, collectStats, 1);
+    }
+    return collectStats ? packedKernelBody(xBegin, yBegin, xEnd, yEnd, 1, 0)
+                        : packedKernelBody(xBegin, yBegin, xEnd, yEnd, 0, 0);
+}
+#endif
+
+#ifdef HAVE_X86_SIMD
+
+/*
+ * calculateNextGenerationSse2 / Avx2 / Avx512 - Vector char kernels
+ *
+ * Each kernel handles 16, 32 or 64 neighboring cells of a row at once.
+ * A byte compare against ALIVE gives 0xFF (-1) for every living cell,
+ * so subtracting the eight compare results from zero leaves the neighbor
+ * count of every cell in its own byte. The rules are then applied with
+ * compares and masks instead of branches:
+ *
+ *   alive next = (count == 3) | (alive & count == 2)
+ *
+ * Other Life-like rules (--rule) take a second flavor of each kernel,
+ * which looks the count up in a birth and a survival table instead:
+ * one shuffle each on AVX2 and AVX-512, a compare per neighbor count on
+ * SSE2, which has no byte shuffle. Generations rules take a third: only
+ * dead cells can be born, and the cells that do not live come out as
+ *   dead -> DEAD, alive -> DYING(2), dying -> one state older
+ * where the oldest dying state ages to DEAD. The wrappers choose the
+ * flavor once per call, so the B3/S23 loops stay exactly as they were;
+ * without --stats they count nothing at all.
+ *
+ * Thanks to the ghost cells every column, including the first and the
+ * last, can be loaded directly at x-1, x and x+1. At the right edge of
+ * the board the last vector may run past the last cell; those lanes land
+ * in the row padding (see allocateGrids), are left out of the population
+ * and are overwritten by the next ghost refresh. A region that ends
+ * inside the board never writes past xEnd: its leftover cells, if any,
+ * go through nextCellChar.
+ */
+
+// Mask of the lanes of a vector starting at column x that are real cells
+static inline uint64_t boardLanes(int x, int lanes) {
+    return x + lanes <= width ? ~UINT64_C(0) : (UINT64_C(1) << (width - x)) - 1;
+}
+
+// Bytes of a where mask is set, of b elsewhere (SSE2 has no blendv)
+__attribute__((target("sse2"))) static inline __m128i sse2Select(__m128i mask, __m128i a, __m128i b) {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+__attribute__((target("sse2"))) static inline __attribute__((always_inline))
+struct RegionStats sse2KernelBody(int xBegin, int yBegin, int xEnd, int yEnd, int anyRule,
+                                  int generations, int countStats) {
+    const int lanes = 16;
+    const __m128i alive = _mm_set1_epi8(ALIVE);
+    const __m128i dead = _mm_set1_epi8(DEAD);
+    const __m128i flip = _mm_set1_epi8(ALIVE ^ DEAD);
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i two = _mm_set1_epi8(2);
+    const __m128i three = _mm_set1_epi8(3);
+    const __m128i laneIndex = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    const __m128i firstDying = _mm_set1_epi8(DYING(2));
+    const __m128i pastDying = _mm_set1_epi8((char)(DYING(ruleStates - 1) + 1));
+    struct RegionStats stats = EMPTY_REGION;
+
+    // The rule tables, copied for the same reason
+    __m128i births[9], survivals[9];
+    for (int n = 0; n <= 8; n++) {
+        births[n] = _mm_set1_epi8(ruleBirthLanes[n]);
+        survivals[n] = _mm_set1_epi8(ruleSurvivalLanes[n]);
+    }
+
+    for (int y = yBegin; y < yEnd; y++) {
+        const char *up = cellRow(cells, y - 1);
+        const char *row = cellRow(cells, y);
+        const char *down = cellRow(cells, y + 1);
+        char *out = cellRow(nextCells, y);
+        long long rowStart = stats.population;
+        struct LaneBox laneBox = { 0, 0, 0, 0 };
+        __m128i liveSums = _mm_setzero_si128();
+        __m128i changedSums = _mm_setzero_si128();
+
+        int x = xBegin;
+        for (; x < xEnd && (x + lanes <= xEnd || xEnd == width); x += lanes) {
+            __m128i count = _mm_setzero_si128();
+            count = _mm_sub_epi8(count, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(up + x - 1)), alive));
+            count = _mm_sub_epi8(count, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(up + x)), alive));
+            count = _mm_sub_epi8(count, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(up + x + 1)), alive));
+            count = _mm_sub_epi8(count, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(row + x - 1)), alive));
+            count = _mm_sub_epi8(count, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(row + x + 1)), alive));
+            count = _mm_sub_epi8(count, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(down + x - 1)), alive));
+            count = _mm_sub_epi8(count, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(down + x)), alive));
+            count = _mm_sub_epi8(count, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(down + x + 1)), alive));
+
+            __m128i cell = _mm_loadu_si128((const __m128i *)(row + x));
+            __m128i self = _mm_cmpeq_epi8(cell, alive);
+            __m128i next;
+            if (!anyRule) {
+                next = _mm_or_si128(_mm_cmpeq_epi8(count, three),
+                                    _mm_and_si128(self, _mm_cmpeq_epi8(count, two)));
+            } else {
+                next = _mm_setzero_si128();
+                for (int n = 0; n <= 8; n++) {
+                    __m128i outcome = _mm_or_si128(_mm_and_si128(self, survivals[n]),
+                                                   _mm_andnot_si128(self, births[n]));
+                    next = _mm_or_si128(next, _mm_and_si128(_mm_cmpeq_epi8(count, _mm_set1_epi8((char)n)), outcome));
+                }
+            }
+
+            if (generations) {
+                __m128i isDead = _mm_cmpeq_epi8(cell, dead);
+                __m128i aged = _mm_add_epi8(cell, one);
+                next = _mm_and_si128(next, _mm_or_si128(self, isDead));
+                aged = sse2Select(_mm_cmpeq_epi8(aged, pastDying), dead, aged);
+                __m128i other = sse2Select(isDead, dead, sse2Select(self, firstDying, aged));
+                _mm_storeu_si128((__m128i *)(out + x), sse2Select(next, alive, other));
+            } else {
+                // DEAD ^ (ALIVE ^ DEAD) == ALIVE, so flipping the masked bytes
+                // turns the mask straight into cell characters
+                _mm_storeu_si128((__m128i *)(out + x),
+                                 _mm_xor_si128(dead, _mm_and_si128(next, flip)));
+            }
+
+            // Plain SSE2 has no popcount: psadbw adds up 0/1 bytes instead,
+            // into two 64-bit sums that are read once per row. Lanes past
+            // the last cell of the board count 0
+            if (countStats) {
+                __m128i inBoard = x + lanes <= width ? one
+                                : _mm_and_si128(one, _mm_cmpgt_epi8(_mm_set1_epi8((char)(width - x)), laneIndex));
+                liveSums = _mm_add_epi64(liveSums, _mm_sad_epu8(_mm_and_si128(next, inBoard),
+                                                                _mm_setzero_si128()));
+                changedSums = _mm_add_epi64(changedSums, _mm_sad_epu8(_mm_and_si128(_mm_xor_si128(next, self), inBoard),
+                                                                      _mm_setzero_si128()));
+                if (x < stats.xMin || x + lanes - 1 > stats.xMax) {
+                    trackLanes(&laneBox, (uint64_t)_mm_movemask_epi8(next) & boardLanes(x, lanes), x);
+                }
+            }
+        }
+        int tail = x;
+        uint64_t sums[2];
+        _mm_storeu_si128((__m128i *)sums, liveSums);
+        stats.population += (long long)(sums[0] + sums[1]);
+        _mm_storeu_si128((__m128i *)sums, changedSums);
+        stats.changed += (long long)(sums[0] + sums[1]);
+        for (; x < xEnd; x++) {
+            out[x] = nextCellChar(up, row, down, x);
+            if (countStats) {
+                stats.population += out[x] == ALIVE;
+                stats.changed += (out[x] == ALIVE) != (row[x] == ALIVE);
+            }
+        }
+        // The vector loop widened the box already; this adds the row and
+        // any leftover cells
+        if (countStats && stats.population > rowStart) {
+            growBoxLanes(&stats, &laneBox);
+            growBoxChars(&stats, out, tail, xEnd, y);
+        }
+    }
+    return stats;
+}
+
+__attribute__((target("sse2")))
+struct RegionStats calculateNextGenerationSse2(int xBegin, int yBegin, int xEnd, int yEnd) {
+    if (ruleStates > 2) {
+        return sse2KernelBody(xBegin, yBegin, xEnd, yEnd, 1, 1, collectStats);
+    }
+    if (collectStats) {
+        return lifeRule == CONWAY_RULE ? sse2KernelBody(xBegin, yBegin, xEnd, yEnd, 0, 0, 1)
+                                       : sse2KernelBody(xBegin, yBegin, xEnd, yEnd, 1, 0, 1);
+    }
+    return lifeRule == CONWAY_RULE ? sse2KernelBody(xBegin, yBegin, xEnd, yEnd, 0, 0, 0)
+                                   : sse2KernelBody(xBegin, yBegin, xEnd, yEnd, 1, 0, 0);
+}
+
+__attribute__((target("avx2,popcnt"))) static inline __attribute__((always_inline))
+struct RegionStats avx2KernelBody(int xBegin, int yBegin, int xEnd, int yEnd, int anyRule,
+                                  int generations, int countStats) {
+    const int lanes = 32;
+    const __m256i alive = _mm256_set1_epi8(ALIVE);
+    const __m256i dead = _mm256_set1_epi8(DEAD);
+    const __m256i flip = _mm256_set1_epi8(ALIVE ^ DEAD);
+    const __m256i two = _mm256_set1_epi8(2);
+    const __m256i three = _mm256_set1_epi8(3);
+    const __m256i births = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)ruleBirthLanes));
+    const __m256i survivals = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)ruleSurvivalLanes));
+    const __m256i one = _mm256_set1_epi8(1);
+    const __m256i firstDying = _mm256_set1_epi8(DYING(2));
+    const __m256i pastDying = _mm256_set1_epi8((char)(DYING(ruleStates - 1) + 1));
+    struct RegionStats stats = EMPTY_REGION;
+
+    for (int y = yBegin; y < yEnd; y++) {
+        const char *up = cellRow(cells, y - 1);
+        const char *row = cellRow(cells, y);
+        const char *down = cellRow(cells, y + 1);
+        char *out = cellRow(nextCells, y);
+        long long rowStart = stats.population;
+        struct LaneBox laneBox = { 0, 0, 0, 0 };
+
+        int x = xBegin;
+        for (; x < xEnd && (x + lanes <= xEnd || xEnd == width); x += lanes) {
+            __m256i count = _mm256_setzero_si256();
+            count = _mm256_sub_epi8(count, _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(up + x - 1)), alive));
+            count = _mm256_sub_epi8(count, _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(up + x)), alive));
+            count = _mm256_sub_epi8(count, _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(up + x + 1)), alive));
+            count = _mm256_sub_epi8(count, _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(row + x - 1)), alive));
+            count = _mm256_sub_epi8(count, _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(row + x + 1)), alive));
+            count = _mm256_sub_epi8(count, _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(down + x - 1)), alive));
+            count = _mm256_sub_epi8(count, _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(down + x)), alive));
+            count = _mm256_sub_epi8(count, _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(down + x + 1)), alive));
+
+            __m256i cell = _mm256_loadu_si256((const __m256i *)(row + x));
+            __m256i self = _mm256_cmpeq_epi8(cell, alive);
+            __m256i next;
+            if (!anyRule) {
+                next = _mm256_or_si256(_mm256_cmpeq_epi8(count, three),
+                                       _mm256_and_si256(self, _mm256_cmpeq_epi8(count, two)));
+            } else {
+                // The shuffle works within 128-bit halves, hence the
+                // table in both
+                next = _mm256_blendv_epi8(_mm256_shuffle_epi8(births, count),
+                                          _mm256_shuffle_epi8(survivals, count), self);
+            }
+
+            if (generations) {
+                __m256i isDead = _mm256_cmpeq_epi8(cell, dead);
+                __m256i aged = _mm256_add_epi8(cell, one);
+                next = _mm256_and_si256(next, _mm256_or_si256(self, isDead));
+                aged = _mm256_blendv_epi8(aged, dead, _mm256_cmpeq_epi8(aged, pastDying));
+                __m256i other = _mm256_blendv_epi8(_mm256_blendv_epi8(aged, firstDying, self), dead, isDead);
+                _mm256_storeu_si256((__m256i *)(out + x), _mm256_blendv_epi8(other, alive, next));
+            } else {
+                _mm256_storeu_si256((__m256i *)(out + x),
+                                    _mm256_xor_si256(dead, _mm256_and_si256(next, flip)));
+            }
+
+            if (countStats) {
+                uint64_t born = (uint32_t)_mm256_movemask_epi8(next) & boardLanes(x, lanes);
+                stats.population += __builtin_popcountll(born);
+                uint64_t was = (uint32_t)_mm256_movemask_epi8(self) & boardLanes(x, lanes);
+                stats.changed += __builtin_popcountll(born ^ was);
+                if (x < stats.xMin || x + lanes - 1 > stats.xMax) {
+                    trackLanes(&laneBox, born, x);
+                }
+            }
+        }
+        int tail = x;
+        for (; x < xEnd; x++) {
+            out[x] = nextCellChar(up, row, down, x);
+            if (countStats) {
+                stats.population += out[x] == ALIVE;
+                stats.changed += (out[x] == ALIVE) != (row[x] == ALIVE);
+            }
+        }
+        if (countStats && stats.population > rowStart) {
+            growBoxLanes(&stats, &laneBox);
+            growBoxChars(&stats, out, tail, xEnd, y);
+        }
+    }
+    return stats;
+}
+
+__attribute__((target("avx2,popcnt")))
+struct RegionStats calculateNextGenerationAvx2(int xBegin, int yBegin, int xEnd, int yEnd) {
+    if (ruleStates > 2) {
+        return avx2KernelBody(xBegin, yBegin, xEnd, yEnd, 1, 1, collectStats);
+    }
+    if (collectStats) {
+        return lifeRule == CONWAY_RULE ? avx2KernelBody(xBegin, yBegin, xEnd, yEnd, 0, 0, 1)
+                                       : avx2KernelBody(xBegin, yBegin, xEnd, yEnd, 1, 0, 1);
+    }
+    return lifeRule == CONWAY_RULE ? avx2KernelBody(xBegin, yBegin, xEnd, yEnd, 0, 0, 0)
+                                   : avx2KernelBody(xBegin, yBegin, xEnd, yEnd, 1, 0, 0);
+}
+
+__attribute__((target("avx512f,avx512bw,popcnt"))) static inline __attribute__((always_inline))
+struct RegionStats avx512KernelBody(int xBegin, int yBegin, int xEnd, int yEnd, int anyRule,
+                                    int generations, int countStats) {
+    const int lanes = 64;
+    const __m512i alive = _mm512_set1_epi8(ALIVE);
+    const __m512i dead = _mm512_set1_epi8(DEAD);
+    const __m512i one = _mm512_set1_epi8(1);
+    const __m512i two = _mm512_set1_epi8(2);
+    const __m512i three = _mm512_set1_epi8(3);
+    const __m512i births = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i *)ruleBirthLanes));
+    const __m512i survivals = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i *)ruleSurvivalLanes));
+    const __m512i firstDying = _mm512_set1_epi8(DYING(2));
+    const __m512i pastDying = _mm512_set1_epi8((char)(DYING(ruleStates - 1) + 1));
+    struct RegionStats stats = EMPTY_REGION;
+
+    for (int y = yBegin; y < yEnd; y++) {
+        const char *up = cellRow(cells, y - 1);
+        const char *row = cellRow(cells, y);
+        const char *down = cellRow(cells, y + 1);
+        char *out = cellRow(nextCells, y);
+        long long rowStart = stats.population;
+        struct LaneBox laneBox = { 0, 0, 0, 0 };
+
+        int x = xBegin;
+        for (; x < xEnd && (x + lanes <= xEnd || xEnd == width); x += lanes) {
+            // AVX-512 compares produce a 64-bit mask register, so each
+            // neighbor adds 1 only in the lanes where it is alive
+            __m512i count = _mm512_setzero_si512();
+            count = _mm512_mask_add_epi8(count, _mm512_cmpeq_epi8_mask(_mm512_loadu_si512(up + x - 1), alive), count, one);
+            count = _mm512_mask_add_epi8(count, _mm512_cmpeq_epi8_mask(_mm512_loadu_si512(up + x), alive), count, one);
+            count = _mm512_mask_add_epi8(count, _mm512_cmpeq_epi8_mask(_mm512_loadu_si512(up + x + 1), alive), count, one);
+            count = _mm512_mask_add_epi8(count, _mm512_cmpeq_epi8_mask(_mm512_loadu_si512(row + x - 1), alive), count, one);
+            count = _mm512_mask_add_epi8(count, _mm512_cmpeq_epi8_mask(_mm512_loadu_si512(row + x + 1), alive), count, one);
+            count = _mm512_mask_add_epi8(count, _mm512_cmpeq_epi8_mask(_mm512_loadu_si512(down + x - 1), alive), count, one);
+            count = _mm512_mask_add_epi8(count, _mm512_cmpeq_epi8_mask(_mm512_loadu_si512(down + x), alive), count, one);
+            count = _mm512_mask_add_epi8(count, _mm512_cmpeq_epi8_mask(_mm512_loadu_si512(down + x + 1), alive), count, one);
+
+            __m512i cell = _mm512_loadu_si512(row + x);
+            __mmask64 self = _mm512_cmpeq_epi8_mask(cell, alive);
+            __mmask64 next;
+            if (!anyRule) {
+                next = _mm512_cmpeq_epi8_mask(count, three) | (self & _mm512_cmpeq_epi8_mask(count, two));
+            } else {
+                next = _mm512_movepi8_mask(_mm512_mask_shuffle_epi8(_mm512_shuffle_epi8(births, count),
+                                                                    self, survivals, count));
+            }
+
+            if (generations) {
+                __mmask64 isDead = _mm512_cmpeq_epi8_mask(cell, dead);
+                __m512i aged = _mm512_add_epi8(cell, one);
+                next &= self | isDead;
+                aged = _mm512_mask_blend_epi8(_mm512_cmpeq_epi8_mask(aged, pastDying), aged, dead);
+                __m512i other = _mm512_mask_blend_epi8(isDead, _mm512_mask_blend_epi8(self, aged, firstDying), dead);
+                _mm512_storeu_si512(out + x, _mm512_mask_blend_epi8(next, other, alive));
+            } else {
+                _mm512_storeu_si512(out + x, _mm512_mask_blend_epi8(next, dead, alive));
+            }
+
+            if (countStats) {
+                uint64_t live = next & boardLanes(x, lanes);
+                stats.population += __builtin_popcountll(live);
+                stats.changed += __builtin_popcountll((next ^ self) & boardLanes(x, lanes));
+                if (x < stats.xMin || x + lanes - 1 > stats.xMax) {
+                    trackLanes(&laneBox, live, x);
+                }
+            }
+        }
+        int tail = x;
+        for (; x < xEnd; x++) {
+            out[x] = nextCellChar(up, row, down, x);
+            if (countStats) {
+                stats.population += out[x] == ALIVE;
+                stats.changed += (out[x] == ALIVE) != (row[x] == ALIVE);
+            }
+        }
+        if (countStats && stats.population > rowStart) {
+            growBoxLanes(&stats, &laneBox);
+            growBoxChars(&stats, out, tail, xEnd, y);
+        }
+    }
+    return stats;
+}
+
+__attribute__((target("avx512f,avx512bw,popcnt")))
+struct RegionStats calculateNextGenerationAvx512(int xBegin, int yBegin, int xEnd, int yEnd) {
+    if (ruleStates > 2) {
+        return avx512KernelBody(xBegin, yBegin, xEnd, yEnd, 1, 1, collectStats);
+    }
+    if (collectStats) {
+        return lifeRule == CONWAY_RULE ? avx512KernelBody(xBegin, yBegin, xEnd, yEnd, 0, 0, 1)
+                                       : avx512KernelBody(xBegin, yBegin, xEnd, yEnd, 1, 0, 1);
+    }
+    return lifeRule == CONWAY_RULE ? avx512KernelBody(xBegin, yBegin, xEnd, yEnd, 0, 0, 0)
+                                   : avx512KernelBody(xBegin, yBegin, xEnd, yEnd, 1, 0, 0);
+}
+
+/*
+ * readXcr0 - Read the XCR0 register with the xgetbv instruction
+ *
+ * XCR0 tells us which register sets the operating system saves on a
+ * context switch. The CPU may support AVX while the OS does not, in
+ * which case using the wide registers would corrupt state.
+ */
+static uint64_t readXcr0(void) {
+    uint32_t eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((uint64_t)edx << 32) | eax;
+}
+
+#endif // HAVE_X86_SIMD
+
+// All char kernels, narrowest first
+// The scalar reference is always available. Among the plain C kernels
+// the fastest comes last, so "auto" picks it on CPUs without SSE2
+static const struct KernelInfo charKernels[] = {
+    { "scalar", calculateNextGenerationChar, CPU_BASELINE },
+    { "lut", calculateNextGenerationLut, CPU_BASELINE },
+    { "window", calculateNextGenerationWindow, CPU_BASELINE },
+#ifdef HAVE_X86_SIMD
+    { "sse2", calculateNextGenerationSse2, CPU_SSE2 },
+    { "avx2", calculateNextGenerationAvx2, CPU_AVX2 },
+    { "avx512", calculateNextGenerationAvx512, CPU_AVX512 },
+#endif
+};
+#define NUM_CHAR_KERNELS ((int)(sizeof(charKernels) / sizeof(charKernels[0])))
+
+/*
+ * detectCpuLevel - Find the widest instruction set this machine can run
+ *
+ * Uses the cpuid instruction for the CPU feature bits and xgetbv for the
+ * operating system's support of the matching registers.
+ */
+enum CpuLevel detectCpuLevel(void) {
+#ifdef HAVE_X86_SIMD
+    unsigned int eax, ebx, ecx, edx;
+    enum CpuLevel level = CPU_BASELINE;
+
+    // Leaf 1: EDX bit 26 = SSE2, ECX bit 23 = POPCNT, bit 27 = OSXSAVE,
+    // bit 28 = AVX. The AVX2 and AVX-512 kernels also use POPCNT
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return level;
+    }
+    if (edx & (1u << 26)) {
+        level = CPU_SSE2;
+    }
+    if (!(ecx & (1u << 23)) || !(ecx & (1u << 27)) || !(ecx & (1u << 28))) {
+        return level;
+    }
+
+    // XCR0 bits 1-2: the OS saves XMM and YMM registers
+    uint64_t xcr0 = readXcr0();
+    if ((xcr0 & 0x6) != 0x6) {
+        return level;
+    }
+
+    // Leaf 7, subleaf 0: EBX bit 5 = AVX2, bit 16 = AVX512F, bit 30 = AVX512BW
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        return level;
+    }
+    if (ebx & (1u << 5)) {
+        level = CPU_AVX2;
+    }
+
+    // XCR0 bits 5-7: the OS saves the opmask and 512-bit ZMM registers
+    if ((ebx & (1u << 16)) && (ebx & (1u << 30)) && (xcr0 & 0xE0) == 0xE0) {
+        level = CPU_AVX512;
+    }
+    return level;
+#else
+    return CPU_BASELINE;
+#endif
+}
+
+/*
+ * selectKernel - Choose the char and packed step kernels
+ *
+ * Parameters:
+ *   name - A kernel name from charKernels, or "auto" for the widest one
+ *          the CPU supports
+ *
+ * Returns:
+ *   1 on success, 0 if the kernel is unknown or unsupported on this CPU
+ */
+int selectKernel(const char *name) {
+    enum CpuLevel cpu = detectCpuLevel();
+
+    for (int i = 0; i < NUM_CHAR_KERNELS; i++) {
+        if (charKernels[i].level > cpu) {
+            continue;
+        }
+        // Kernels are sorted narrowest first, so for "auto" the last
+        // supported one wins
+        if (strcmp(name, "auto") == 0 || strcmp(name, charKernels[i].name) == 0) {
+            charKernel = charKernels[i].step;
+            charKernelName = charKernels[i].name;
+        }
+    }
+
+    if (charKernel == NULL) {
+        fprintf(stderr, "Kernel %s is not available on this CPU\n", name);
+        return 0;
+    }
+
+    packedKernel = calculateNextGenerationPacked;
+#ifdef HAVE_X86_SIMD
+    // Every CPU at the AVX2 level also has POPCNT
+    if (cpu >= CPU_AVX2) {
+        packedKernel = calculateNextGenerationPackedPopcnt;
+    }
+#endif
+    return 1;
+}
+
+/*
+ * copyGrid - Make nextCells the current generation
+ *
+ * This prepares the next generation to become the current generation.
+ * The grids live on the heap, so instead of copying every byte we just
+ * swap the two pointers. The old generation's buffer becomes nextCells
+ * and is overwritten by the next calculateNextGeneration() - except for
+ * unchanged tiles, where it already holds the right cells.
+ */
+void copyGrid(void) {
+    uint64_t traceStart = traceBegin();
+    char *oldCells = cells;
+    cells = nextCells;
+    nextCells = oldCells;
+
+    uint64_t *oldPacked = packedCells;
+    packedCells = packedNextCells;
+    packedNextCells = oldPacked;
+
+    uint64_t *oldLive = liveCells;
+    liveCells = nextLiveCells;
+    nextLiveCells = oldLive;
+    size_t oldNumLive = numLiveCells;
+    numLiveCells = numNextLiveCells;
+    numNextLiveCells = oldNumLive;
+
+    // Chunks hold both generations, so only the index flips
+    chunkCurrent = !chunkCurrent;
+
+    // The tile flags describe the buffers, so they swap along with them
+    unsigned char *oldChanged = tileChanged;
+    tileChanged = tileChangedNext;
+    tileChangedNext = oldChanged;
+    traceEnd(TRACE_COPY, traceStart, -1);
+}
+
+/*
+ * refreshGhostCells - Copy the wrapped-around neighbors into the ghosts
+ *
+ * Each row's left ghost gets the row's last cell and its right ghost the
+ * first cell. Then the whole first row (ghosts included, which fills the
+ * corners) is copied below the board and the last row above it.
+ *
+ * Parameters:
+ *   grid - The char grid to refresh
+ */
+void refreshGhostCells(char *grid) {
+    for (int y = 0; y < height; y++) {
+        char *row = cellRow(grid, y);
+        row[-1] = row[width - 1];
+        row[width] = row[0];
+    }
+    memcpy(cellRow(grid, -1) - 1, cellRow(grid, height - 1) - 1, stride);
+    memcpy(cellRow(grid, height) - 1, cellRow(grid, 0) - 1, stride);
+}
+
+/*
+ * refreshPackedGhostRows - Copy the first and last rows into the ghost rows
+ *
+ * Parameters:
+ *   grid - The packed grid to refresh
+ */
+void refreshPackedGhostRows(uint64_t *grid) {
+    size_t bytes = packedStride * sizeof(uint64_t);
+    memcpy(packedRow(grid, -1), packedRow(grid, height - 1), bytes);
+    memcpy(packedRow(grid, height), packedRow(grid, 0), bytes);
+}
+
+// ============================================================================
+// TEMPORAL BLOCKING
+// ============================================================================
+
+/*
+ * packedBitsAt - The 64 cells of a packed row starting at cell x
+ *
+ * x may lie anywhere, even outside the board: it is wrapped around, and
+ * so is every cell after it. Word-aligned reads inside the board are a
+ * single load; anything else is pieced together from up to a few words.
+ */
+static uint64_t packedBitsAt(const uint64_t *row, long x) {
+    x %= width;
+    if (x < 0) {
+        x += width;
+    }
+    if (x % WORD_BITS == 0 && x + WORD_BITS <= width) {
+        return row[x / WORD_BITS];
+    }
+
+    uint64_t bits = 0;
+    for (int filled = 0; filled < WORD_BITS;) {
+        int offset = (int)(x % WORD_BITS);
+        int count = WORD_BITS - offset;
+        if (count > width - x) {
+            count = (int)(width - x);
+        }
+        if (count > WORD_BITS - filled) {
+            count = WORD_BITS - filled;
+        }
+        uint64_t mask = count == WORD_BITS ? ~UINT64_C(0) : (UINT64_C(1) << count) - 1;
+        bits |= ((row[x / WORD_BITS] >> offset) & mask) << filled;
+        filled += count;
+        x += count;
+        if (x == width) {
+            x = 0;
+        }
+    }
+    return bits;
+}
+
+/*
+ * stepTemporalRow - Step one local row of a temporal block
+ *
+ * Inlined twice into stepTemporalBlock, for B3/S23 and for other rules.
+ */
+static inline __attribute__((always_inline))
+void stepTemporalRow(const uint64_t *above, const uint64_t *row, const uint64_t *below,
+                     uint64_t *next, int words, int anyRule) {
+    // Neighbor words come from the local row, never the board
+    #define LOCAL_WEST(p, c) (((p)[c] << 1) | ((p)[(c) - 1] >> (WORD_BITS - 1)))
+    #define LOCAL_EAST(p, c) (((p)[c] >> 1) | ((p)[(c) + 1] << (WORD_BITS - 1)))
+    for (int c = 1; c <= words; c++) {
+        next[c] = packedNextWord(LOCAL_WEST(above, c), above[c], LOCAL_EAST(above, c),
+                                 LOCAL_WEST(row, c), row[c], LOCAL_EAST(row, c),
+                                 LOCAL_WEST(below, c), below[c], LOCAL_EAST(below, c),
+                                 anyRule);
+    }
+    #undef LOCAL_WEST
+    #undef LOCAL_EAST
+}
+
+/*
+ * stepTemporalBlock - Advance one block of the packed board K generations
+ *
+ * The block plus a halo of K rows above and below and one word left and
+ * right is copied into scratch, as a seamless piece of the torus. Every
+ * generation the outermost row and bit of the piece go stale, since
+ * their neighbors are missing, so after K generations exactly the block
+ * itself is still correct and is written to packedNextCells.
+ *
+ * Parameters:
+ *   scratch        - The calling thread's two block buffers
+ *   yBegin, yEnd   - Rows of the block
+ *   iBegin, iEnd   - Words of the block
+ *   stats          - With --stats, the block's numbers are added here;
+ *                    changed cells are counted against K generations ago
+ */
+static void stepTemporalBlock(uint64_t *scratch, int yBegin, int yEnd, int iBegin, int iEnd,
+                              struct RegionStats *stats) {
+    int depth = temporalDepth;
+    int rows = yEnd - yBegin + 2 * depth;
+    int words = iEnd - iBegin + 2;
+    uint64_t *buffers[2] = { scratch, scratch + TEMPORAL_MAX_ROWS * TEMPORAL_STRIDE };
+
+    // Local row r is board row yBegin - depth + r; local word c holds the
+    // cells from 64 * (iBegin - 2 + c). Words 0 and words + 1 stay zero
+    for (int r = 0; r < rows; r++) {
+        int y = ((yBegin - depth + r) % height + height) % height;
+        const uint64_t *row = packedRow(packedCells, y);
+        uint64_t *local = buffers[0] + (size_t)r * TEMPORAL_STRIDE;
+
+        for (int c = 1; c <= words; c++) {
+            int i = iBegin - 2 + c;
+            if (c > 1 && c < words && (i < wordsPerRow - 1 || lastWordMask == ~UINT64_C(0))) {
+                local[c] = row[i];  // A whole word inside the board
+            } else {
+                local[c] = packedBitsAt(row, (long)WORD_BITS * i);
+            }
+        }
+        local[0] = local[words + 1] = 0;
+        buffers[1][(size_t)r * TEMPORAL_STRIDE] = 0;
+        buffers[1][(size_t)r * TEMPORAL_STRIDE + words + 1] = 0;
+    }
+
+    for (int gen = 1; gen <= depth; gen++) {
+        const uint64_t *in = buffers[(gen - 1) & 1];
+        uint64_t *out = buffers[gen & 1];
+
+        for (int r = gen; r < rows - gen; r++) {
+            const uint64_t *above = in + (size_t)(r - 1) * TEMPORAL_STRIDE;
+            const uint64_t *row = in + (size_t)r * TEMPORAL_STRIDE;
+            const uint64_t *below = in + (size_t)(r + 1) * TEMPORAL_STRIDE;
+            uint64_t *next = out + (size_t)r * TEMPORAL_STRIDE;
+
+            if (lifeRule == CONWAY_RULE) {
+                stepTemporalRow(above, row, below, next, words, 0);
+            } else {
+                stepTemporalRow(above, row, below, next, words, 1);
+            }
+        }
+    }
+
+    const uint64_t *result = buffers[depth & 1];
+    for (int y = yBegin; y < yEnd; y++) {
+        const uint64_t *local = result + (size_t)(y - yBegin + depth) * TEMPORAL_STRIDE;
+        uint64_t *out = packedRow(packedNextCells, y);
+        for (int i = iBegin; i < iEnd; i++) {
+            // Past the last cell the piece holds wrapped-around cells;
+            // the board keeps those bits clear
+            out[i] = local[i - iBegin + 2] & (i == wordsPerRow - 1 ? lastWordMask : ~UINT64_C(0));
+        }
+
+        if (collectStats) {
+            const uint64_t *before = packedRow(packedCells, y);
+            long long rowStart = stats->population;
+            for (int i = iBegin; i < iEnd; i++) {
+                stats->population += __builtin_popcountll(out[i]);
+                stats->changed += __builtin_popcountll(out[i] ^ before[i]);
+            }
+            if (stats->population > rowStart) {
+                growBoxWords(stats, out + iBegin, iEnd - iBegin, (long long)WORD_BITS * iBegin, y);
+            }
+        }
+    }
+}
+
+/*
+ * stepTemporalBand - Advance one worker's band of rows K generations
+ *
+ * Blocks only read packedCells and only write their own part of
+ * packedNextCells, so the bands need no coordination.
+ */
+void stepTemporalBand(int worker) {
+    uint64_t traceStart = traceBegin();
+    uint64_t *scratch = temporalScratch + (size_t)worker * 2 * TEMPORAL_MAX_ROWS * TEMPORAL_STRIDE;
+    int yBegin = (int)((long long)height * worker / numThreads);
+    int yEnd = (int)((long long)height * (worker + 1) / numThreads);
+    struct RegionStats stats = EMPTY_REGION;
+
+    for (int y = yBegin; y < yEnd; y += TEMPORAL_ROWS) {
+        int blockEnd = y + TEMPORAL_ROWS < yEnd ? y + TEMPORAL_ROWS : yEnd;
+        for (int i = 0; i < wordsPerRow; i += TEMPORAL_WORDS) {
+            int wordEnd = i + TEMPORAL_WORDS < wordsPerRow ? i + TEMPORAL_WORDS : wordsPerRow;
+            stepTemporalBlock(scratch, y, blockEnd, i, wordEnd, &stats);
+        }
+    }
+    workerStats[worker] = stats;
+    traceEnd(TRACE_BAND, traceStart, worker);
+}
+
+// ============================================================================
+// SPARSE ENGINE
+// ============================================================================
+
+/*
+ * reserveLiveCells - Make room for count keys in both live cell lists
+ *
+ * Returns:
+ *   1 on success, 0 if memory ran out
+ */
+int reserveLiveCells(size_t count) {
+    if (count <= liveCapacity) {
+        return 1;
+    }
+    size_t capacity = liveCapacity < 1024 ? 1024 : liveCapacity;
+    while (capacity < count) {
+        capacity *= 2;
+    }
+
+    uint64_t *grown = realloc(liveCells, sizeof(uint64_t) * capacity);
+    if (grown == NULL) {
+        return 0;
+    }
+    liveCells = grown;
+    grown = realloc(nextLiveCells, sizeof(uint64_t) * capacity);
+    if (grown == NULL) {
+        return 0;
+    }
+    nextLiveCells = grown;
+    liveCapacity = capacity;
+    return 1;
+}
+
+/*
+ * radixSort - Sort keys with an LSD radix sort, one byte per pass
+ *
+ * Only the bytes a key of this board can use are sorted, so a board of
+ * up to 16M cells takes three linear passes.
+ *
+ * Parameters:
+ *   keys    - The keys to sort
+ *   scratch - Room for count more keys
+ *   count   - Number of keys
+ *
+ * Returns:
+ *   Whichever of keys and scratch holds the sorted result
+ */
+static uint64_t *radixSort(uint64_t *keys, uint64_t *scratch, size_t count) {
+    uint64_t maxKey = cellKey(width - 1, height - 1);
+
+    for (int shift = 0; shift < 64 && (maxKey >> shift) != 0; shift += 8) {
+        size_t offsets[256] = { 0 };
+        for (size_t i = 0; i < count; i++) {
+            offsets[(keys[i] >> shift) & 0xFF]++;
+        }
+        size_t total = 0;
+        for (int digit = 0; digit < 256; digit++) {
+            size_t n = offsets[digit];
+            offsets[digit] = total;
+            total += n;
+        }
+        for (size_t i = 0; i < count; i++) {
+            scratch[offsets[(keys[i] >> shift) & 0xFF]++] = keys[i];
+        }
+
+        uint64_t *sorted = scratch;
+        scratch = keys;
+        keys = sorted;
+    }
+    return keys;
+}
+
+/*
+ * reserveNeighborKeys - Make room for count keys in each scratch half
+ */
+static int reserveNeighborKeys(size_t count) {
+    if (count <= neighborCapacity) {
+        return 1;
+    }
+    uint64_t *grown = realloc(neighborKeys, sizeof(uint64_t) * 2 * count);
+    if (grown == NULL) {
+        return 0;
+    }
+    neighborKeys = grown;
+    neighborCapacity = count;
+    return 1;
+}
+
+/*
+ * sortNextLiveCells - Sort nextLiveCells after an out-of-order write
+ *
+ * Returns:
+ *   1 on success, 0 if memory ran out
+ */
+int sortNextLiveCells(void) {
+    if (!reserveNeighborKeys(numNextLiveCells)) {
+        return 0;
+    }
+    uint64_t *sorted = radixSort(nextLiveCells, neighborKeys, numNextLiveCells);
+    if (sorted != nextLiveCells) {
+        memcpy(nextLiveCells, sorted, sizeof(uint64_t) * numNextLiveCells);
+    }
+    return 1;
+}
+
+/*
+ * stepSparse - Calculate nextLiveCells from liveCells
+ *
+ * Every live cell adds one contribution to each of its 8 neighbors
+ * (wrapping around the board). After sorting the contributions, equal
+ * keys are adjacent: the length of each run is that cell's neighbor
+ * count. Walking the runs and the sorted live list side by side tells
+ * whether each cell is alive now, and the survivors and births come out
+ * already sorted. Cells with no live neighbor never appear at all, so
+ * the cost depends only on the population.
+ *
+ * Returns:
+ *   1 on success, 0 if memory ran out (liveCells is left as it was)
+ */
+int stepSparse(void) {
+    size_t population = numLiveCells;
+    size_t numKeys = population * 8;
+
+    if (!reserveNeighborKeys(numKeys)) {
+        return 0;
+    }
+
+    // Spread the contributions; column and row offsets wrap around
+    uint64_t *keys = neighborKeys;
+    for (size_t i = 0; i < population; i++) {
+        int x = (int)(liveCells[i] % (uint64_t)width);
+        int y = (int)(liveCells[i] / (uint64_t)width);
+        int columns[3] = { x == 0 ? width - 1 : x - 1, x, x == width - 1 ? 0 : x + 1 };
+        int rows[3] = { y == 0 ? height - 1 : y - 1, y, y == height - 1 ? 0 : y + 1 };
+
+        for (int dy = 0; dy < 3; dy++) {
+            for (int dx = 0; dx < 3; dx++) {
+                if (dx != 1 || dy != 1) {
+                    *keys++ = cellKey(columns[dx], rows[dy]);
+                }
+            }
+        }
+    }
+    keys = radixSort(neighborKeys, neighborKeys + neighborCapacity, numKeys);
+
+    // Only a run whose length the rule keeps or brings alive can become a
+    // live cell, plus under rules with S0 the live cells with no neighbors
+    // at all. Counting those runs sizes the next list to the generation
+    // it will hold rather than to every key
+    const uint32_t rule = lifeRule;
+    const int survivesAlone = (rule & RULE_SURVIVAL(0)) != 0;
+    size_t candidates = survivesAlone ? population : 0;
+    for (size_t i = 0; i < numKeys;) {
+        size_t run = i;
+        while (i < numKeys && keys[i] == keys[run]) {
+            i++;
+        }
+        candidates += (rule & (RULE_BIRTH(i - run) | RULE_SURVIVAL(i - run))) != 0;
+    }
+    if (!reserveLiveCells(candidates)) {
+        return 0;
+    }
+
+    // Merge the runs of contributions with the current live cells. Under
+    // rules with S0 a live cell needs no neighbors to survive
+    size_t live = 0;
+    size_t births = 0;
+    numNextLiveCells = 0;
+    for (size_t i = 0; i < numKeys;) {
+        uint64_t key = keys[i];
+        size_t run = i;
+        while (i < numKeys && keys[i] == key) {
+            i++;
+        }
+        size_t numNeighbors = i - run;
+
+        // Live cells before key had no neighbors at all
+        while (live < population && liveCells[live] < key) {
+            if (survivesAlone) {
+                nextLiveCells[numNextLiveCells++] = liveCells[live];
+            }
+            live++;
+        }
+        int alive = live < population && liveCells[live] == key;
+
+        if (rule & (alive ? RULE_SURVIVAL(numNeighbors) : RULE_BIRTH(numNeighbors))) {
+            nextLiveCells[numNextLiveCells++] = key;
+            births += !alive;
+        }
+        live += alive;
+    }
+    for (; survivesAlone && live < population; live++) {
+        nextLiveCells[numNextLiveCells++] = liveCells[live];
+    }
+
+    // Every live cell that did not survive died
+    if (collectStats) {
+        struct RegionStats stats = EMPTY_REGION;
+        size_t survivors = numNextLiveCells - births;
+        stats.population = (long long)numNextLiveCells;
+        stats.changed = (long long)(births + population - survivors);
+        for (size_t i = 0; i < numNextLiveCells; i++) {
+            long long x = (long long)(nextLiveCells[i] % (uint64_t)width);
+            stats.xMin = x < stats.xMin ? x : stats.xMin;
+            stats.xMax = x > stats.xMax ? x : stats.xMax;
+        }
+        if (numNextLiveCells > 0) {
+            // Keys are sorted row by row
+            stats.yMin = (long long)(nextLiveCells[0] / (uint64_t)width);
+            stats.yMax = (long long)(nextLiveCells[numNextLiveCells - 1] / (uint64_t)width);
+        }
+        stepStats = stats;
+        stepStatsValid = 1;
+    }
+    return 1;
+}
+
+// ============================================================================
+// CHUNKED PLANE
+// ============================================================================
+
+/*
+ * chunkSlot - Home slot of chunk (cx, cy) in chunkMap
+ */
+static inline size_t chunkSlot(int32_t cx, int32_t cy) {
+    uint64_t key = ((uint64_t)(uint32_t)cx << 32) | (uint32_t)cy;
+    key *= UINT64_C(0x9E3779B97F4A7C15);
+    return (size_t)(key >> 32) & (chunkMapCapacity - 1);
+}
+
+/*
+ * findChunk - The chunk at chunk coordinates (cx, cy), or NULL
+ */
+struct Chunk *findChunk(int32_t cx, int32_t cy) {
+    if (chunkMap == NULL) {
+        return NULL;
+    }
+    for (size_t slot = chunkSlot(cx, cy);; slot = (slot + 1) & (chunkMapCapacity - 1)) {
+        struct Chunk *chunk = chunkMap[slot];
+        if (chunk == NULL || (chunk->cx == cx && chunk->cy == cy)) {
+            return chunk;
+        }
+    }
+}
+
+/*
+ * insertChunk - Put a chunk into the first free slot of its probe run
+ */
+static void insertChunk(struct Chunk *chunk) {
+    size_t slot = chunkSlot(chunk->cx, chunk->cy);
+    while (chunkMap[slot] != NULL) {
+        slot = (slot + 1) & (chunkMapCapacity - 1);
+    }
+    chunkMap[slot] = chunk;
+}
+
+/*
+ * resizeChunkMap - Rehash every chunk into a table of the given size
+ *
+ * Returns:
+ *   1 on success, 0 if memory ran out (the old table is kept)
+ */
+static int resizeChunkMap(size_t capacity) {
+    struct Chunk **oldMap = chunkMap;
+    size_t oldCapacity = chunkMapCapacity;
+
+    chunkMap = calloc(capacity, sizeof(struct Chunk *));
+    if (chunkMap == NULL) {
+        chunkMap = oldMap;
+        return 0;
+    }
+    chunkMapCapacity = capacity;
+    for (size_t slot = 0; slot < oldCapacity; slot++) {
+        if (oldMap[slot] != NULL) {
+            insertChunk(oldMap[slot]);
+        }
+    }
+    free(oldMap);
+    return 1;
+}
+
+/*
+ * ensureChunk - The chunk at (cx, cy), created all dead if missing
+ *
+ * New chunks come from the pool when it has any. The table is kept at
+ * most half full so probe runs stay short.
+ *
+ * Returns:
+ *   The chunk, or NULL if memory ran out (the map is left as it was)
+ */
+struct Chunk *ensureChunk(int32_t cx, int32_t cy) {
+    struct Chunk *chunk = findChunk(cx, cy);
+    if (chunk != NULL) {
+        return chunk;
+    }
+
+    if ((numChunks + 1) * 2 > chunkMapCapacity
+        && !resizeChunkMap(chunkMapCapacity == 0 ? 64 : chunkMapCapacity * 2)) {
+        return NULL;
+    }
+
+    if (chunkPool != NULL) {
+        chunk = chunkPool;
+        chunkPool = chunk->nextFree;
+        numPooledChunks--;
+    } else {
+        chunk = aligned_alloc(CACHE_LINE, sizeof(struct Chunk));
+        if (chunk == NULL) {
+            return NULL;
+        }
+    }
+    memset(chunk->rows, 0, sizeof(chunk->rows));
+    chunk->cx = cx;
+    chunk->cy = cy;
+    insertChunk(chunk);
+    numChunks++;
+    return chunk;
+}
+
+/*
+ * removeChunk - Take a dead chunk out of the map and return it to the pool
+ *
+ * Linear probing cannot simply empty the slot: a later chunk of the same
+ * probe run would become unreachable. Instead the chunks after the hole
+ * are shifted back into it where their home slot allows (backward shift
+ * deletion), so no tombstones are needed. The pool keeps at most as many
+ * spare chunks as there are live ones; the rest go back to the system.
+ */
+static void removeChunk(struct Chunk *chunk) {
+    size_t mask = chunkMapCapacity - 1;
+    size_t hole = chunkSlot(chunk->cx, chunk->cy);
+    while (chunkMap[hole] != chunk) {
+        hole = (hole + 1) & mask;
+    }
+
+    for (size_t slot = (hole + 1) & mask; chunkMap[slot] != NULL; slot = (slot + 1) & mask) {
+        size_t home = chunkSlot(chunkMap[slot]->cx, chunkMap[slot]->cy);
+        // Move it if its home is not cyclically within (hole, slot]
+        if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+            chunkMap[hole] = chunkMap[slot];
+            hole = slot;
+        }
+    }
+    chunkMap[hole] = NULL;
+    numChunks--;
+
+    if (numPooledChunks < numChunks) {
+        chunk->nextFree = chunkPool;
+        chunkPool = chunk;
+        numPooledChunks++;
+    } else {
+        free(chunk);
+    }
+}
+
+/*
+ * freeChunks - Release every chunk, the pool and the map
+ */
+void freeChunks(void) {
+    for (size_t slot = 0; slot < chunkMapCapacity; slot++) {
+        free(chunkMap[slot]);
+    }
+    while (chunkPool != NULL) {
+        struct Chunk *next = chunkPool->nextFree;
+        free(chunkPool);
+        chunkPool = next;
+    }
+    free(chunkMap);
+    free(chunkList);
+    chunkMap = NULL;
+    chunkList = NULL;
+    chunkMapCapacity = chunkListCapacity = 0;
+    numChunks = numPooledChunks = 0;
+}
+
+/*
+ * listChunks - Copy the chunks in the map into chunkList
+ *
+ * Stepping creates and removes chunks, which moves them around in the
+ * map, so a step walks this stable copy instead.
+ *
+ * Returns:
+ *   1 on success, 0 if memory ran out
+ */
+static int listChunks(void) {
+    if (numChunks > chunkListCapacity) {
+        free(chunkList);
+        chunkListCapacity = chunkMapCapacity;
+        chunkList = malloc(sizeof(struct Chunk *) * chunkListCapacity);
+        if (chunkList == NULL) {
+            chunkListCapacity = 0;
+            return 0;
+        }
+    }
+    size_t n = 0;
+    for (size_t slot = 0; slot < chunkMapCapacity; slot++) {
+        if (chunkMap[slot] != NULL) {
+            chunkList[n++] = chunkMap[slot];
+        }
+    }
+    return 1;
+}
+
+/*
+ * growChunks - Create the neighbors that live edge cells can reach
+ *
+ * A birth needs a live neighbor, so a missing chunk can only come alive
+ * next to a live cell on the facing edge or corner of an existing chunk.
+ *
+ * Returns:
+ *   1 on success, 0 if memory ran out. The chunks made so far stay; they
+ *   are all dead, so the plane itself is unchanged
+ */
+static int growChunks(void) {
+    size_t count = numChunks;
+    if (!listChunks()) {
+        return 0;
+    }
+
+    for (size_t n = 0; n < count; n++) {
+        const struct Chunk *chunk = chunkList[n];
+        const uint64_t *rows = chunk->rows[chunkCurrent];
+        uint64_t anyRow = 0;
+        for (int r = 0; r < CHUNK_SIZE; r++) {
+            anyRow |= rows[r];
+        }
+        if (anyRow == 0) {
+            continue;
+        }
+
+        uint64_t westColumn = 0, eastColumn = 0;
+        for (int r = 0; r < CHUNK_SIZE; r++) {
+            westColumn |= rows[r] & 1;
+            eastColumn |= rows[r] >> (CHUNK_SIZE - 1);
+        }
+        uint64_t top = rows[0];
+        uint64_t bottom = rows[CHUNK_SIZE - 1];
+        uint64_t eastBit = UINT64_C(1) << (CHUNK_SIZE - 1);
+        int32_t cx = chunk->cx;
+        int32_t cy = chunk->cy;
+
+        int ok = (!top || ensureChunk(cx, cy - 1))
+                 && (!bottom || ensureChunk(cx, cy + 1))
+                 && (!westColumn || ensureChunk(cx - 1, cy))
+                 && (!eastColumn || ensureChunk(cx + 1, cy))
+                 && (!(top & 1) || ensureChunk(cx - 1, cy - 1))
+                 && (!(top & eastBit) || ensureChunk(cx + 1, cy - 1))
+                 && (!(bottom & 1) || ensureChunk(cx - 1, cy + 1))
+                 && (!(bottom & eastBit) || ensureChunk(cx + 1, cy + 1));
+        if (!ok) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * stepChunk - Calculate the next generation of one chunk
+ *
+ * Gathers the current rows of the chunk and its 8 neighbors (dead where
+ * a neighbor does not exist) into three columns of 66 words - one row of
+ * margin above and below - and then runs the same adder tree as the
+ * packed kernel.
+ *
+ * Parameters:
+ *   chunk - The chunk to step
+ *   stats - With --stats, the chunk's numbers are added here, in plane
+ *           coordinates
+ *
+ * Returns:
+ *   Nonzero if the chunk has any live cell in the next generation
+ */
+static uint64_t stepChunk(struct Chunk *chunk, struct RegionStats *stats) {
+    uint64_t west[CHUNK_SIZE + 2], center[CHUNK_SIZE + 2], east[CHUNK_SIZE + 2];
+    uint64_t *columns[3] = { west, center, east };
+
+    for (int dx = -1; dx <= 1; dx++) {
+        uint64_t *column = columns[dx + 1];
+        for (int dy = -1; dy <= 1; dy++) {
+            const struct Chunk *neighbor = dx == 0 && dy == 0 ? chunk
+                                         : findChunk(chunk->cx + dx, chunk->cy + dy);
+            const uint64_t *rows = neighbor != NULL ? neighbor->rows[chunkCurrent] : NULL;
+            if (dy == 0) {
+                if (rows != NULL) {
+                    memcpy(column + 1, rows, sizeof(uint64_t) * CHUNK_SIZE);
+                } else {
+                    memset(column + 1, 0, sizeof(uint64_t) * CHUNK_SIZE);
+                }
+            } else {
+                int r = dy < 0 ? CHUNK_SIZE - 1 : 0;
+                column[dy < 0 ? 0 : CHUNK_SIZE + 1] = rows != NULL ? rows[r] : 0;
+            }
+        }
+    }
+
+    uint64_t *out = chunk->rows[!chunkCurrent];
+    uint64_t any = 0;
+    const int anyRule = lifeRule != CONWAY_RULE;
+    for (int r = 1; r <= CHUNK_SIZE; r++) {
+        // West neighbors shift cells east by one, pulling in bit 63 of the
+        // west chunk; east neighbors the other way round
+        #define CHUNK_WEST(row) ((center[row] << 1) | (west[row] >> (CHUNK_SIZE - 1)))
+        #define CHUNK_EAST(row) ((center[row] >> 1) | (east[row] << (CHUNK_SIZE - 1)))
+        out[r - 1] = packedNextWord(CHUNK_WEST(r - 1), center[r - 1], CHUNK_EAST(r - 1),
+                                    CHUNK_WEST(r), center[r], CHUNK_EAST(r),
+                                    CHUNK_WEST(r + 1), center[r + 1], CHUNK_EAST(r + 1),
+                                    anyRule);
+        #undef CHUNK_WEST
+        #undef CHUNK_EAST
+        any |= out[r - 1];
+    }
+
+    if (collectStats) {
+        long long x0 = (long long)chunk->cx * CHUNK_SIZE;
+        long long y0 = (long long)chunk->cy * CHUNK_SIZE;
+        for (int r = 0; r < CHUNK_SIZE; r++) {
+            stats->population += __builtin_popcountll(out[r]);
+            stats->changed += __builtin_popcountll(out[r] ^ center[r + 1]);
+            if (out[r] != 0) {
+                growBoxWords(stats, &out[r], 1, x0, y0 + r);
+            }
+        }
+    }
+    return any;
+}
+
+/*
+ * stepChunks - Calculate the next generation of the whole plane
+ *
+ * First grows chunks where life may spread, then steps every chunk.
+ * Chunks that end up empty are only removed once all chunks have been
+ * stepped, because their current cells are still read by neighbors.
+ *
+ * Returns:
+ *   1 on success, 0 if memory ran out before any chunk was stepped
+ */
+int stepChunks(void) {
+    if (chunkMap == NULL) {
+        if (collectStats) {
+            stepStats = (struct RegionStats)EMPTY_REGION;
+            stepStatsValid = 1;
+        }
+        return 1;
+    }
+    if (!growChunks() || !listChunks()) {
+        return 0;
+    }
+
+    size_t count = numChunks;
+    size_t numDead = 0;
+    struct RegionStats stats = EMPTY_REGION;
+    for (size_t n = 0; n < count; n++) {
+        if (stepChunk(chunkList[n], &stats) == 0) {
+            // Collect the empty chunks at the front of the list
+            struct Chunk *dead = chunkList[n];
+            chunkList[n] = chunkList[numDead];
+            chunkList[numDead++] = dead;
+        }
+    }
+    for (size_t n = 0; n < numDead; n++) {
+        removeChunk(chunkList[n]);
+    }
+    if (collectStats) {
+        stepStats = stats;
+        stepStatsValid = 1;
+    }
+    return 1;
+}
+
+// ============================================================================
+// HASHLIFE
+// ============================================================================
+
+/*
+ * hashLifeSupported - Whether HashLife can run on the current board
+ *
+ * HashLife works on squares of 2^k cells. A square power-of-two board
+ * tiles the infinite plane exactly, and because identical squares are
+ * shared, the whole tiling costs a handful of nodes. Stepping the tiling
+ * gives exactly the wraparound (torus) behavior of the other kernels.
+ * Rules with B0 are out, since the empty square must stay empty, and so
+ * are rules beyond the range-1 neighborhood of the 4x4 base case.
+ */
+int hashLifeSupported(void) {
+    return width == height && width >= 4 && (width & (width - 1)) == 0
+        && ruleStates == 2 && !(lifeRule & RULE_BIRTH(0)) && ltlRule.radius == 0;
+}
+
+/*
+ * hashAllocate - Take a free node slot, or give up on this step
+ *
+ * When the cache cap is reached we cannot continue the current step, so
+ * we jump back to hashTryAdvance, which collects garbage and retries.
+ */
+static uint32_t hashAllocate(void) {
+    uint32_t node;
+    if (hashFreeList != HASH_NONE) {
+        node = hashFreeList;
+        hashFreeList = hashNodes[node].next;
+    } else if (hashUsed < hashCapacity) {
+        node = hashUsed++;
+    } else {
+        longjmp(*hashOutOfMemory, 1);
+    }
+    hashLiveNodes++;
+    return node;
+}
+
+/*
+ * hashBucket - Hash table bucket for a node with the given quadrants
+ */
+static inline uint32_t hashBucket(uint32_t nw, uint32_t ne, uint32_t sw, uint32_t se) {
+    uint64_t h = (uint64_t)nw * UINT64_C(0x9E3779B97F4A7C15);
+    h = (h ^ ne) * UINT64_C(0xC2B2AE3D27D4EB4F);
+    h = (h ^ sw) * UINT64_C(0x165667B19E3779F9);
+    h = (h ^ se) * UINT64_C(0x9E3779B97F4A7C15);
+    return (uint32_t)(h >> 32) & hashBucketMask;
+}
+
+/*
+ * hashJoin - The unique node with the given four quadrants
+ *
+ * Returns the existing node if this square has been seen before,
+ * otherwise creates it. This is what makes the tree "hash-consed".
+ */
+static uint32_t hashJoin(uint32_t nw, uint32_t ne, uint32_t sw, uint32_t se) {
+    uint32_t bucket = hashBucket(nw, ne, sw, se);
+
+    for (uint32_t n = hashBuckets[bucket]; n != HASH_NONE; n = hashNodes[n].next) {
+        struct HashNode *node = &hashNodes[n];
+        if (node->nw == nw && node->ne == ne && node->sw == sw && node->se == se) {
+            return n;
+        }
+    }
+
+    uint32_t n = hashAllocate();
+    struct HashNode *node = &hashNodes[n];
+    node->nw = nw;
+    node->ne = ne;
+    node->sw = sw;
+    node->se = se;
+    node->level = (uint8_t)(hashNodes[nw].level + 1);
+    node->result = HASH_NONE;
+    node->resultStep = -1;
+    node->marked = 0;
+    node->next = hashBuckets[bucket];
+    hashBuckets[bucket] = n;
+    return n;
+}
+
+/*
+ * hashEmptyNode - The all-dead node of a level
+ */
+static uint32_t hashEmptyNode(int level) {
+    if (hashEmpty[level] == HASH_NONE) {
+        uint32_t child = hashEmptyNode(level - 1);
+        hashEmpty[level] = hashJoin(child, child, child, child);
+    }
+    return hashEmpty[level];
+}
+
+/*
+ * hashCenter - The level k-1 square in the middle of a level k node
+ */
+static uint32_t hashCenter(uint32_t n) {
+    const struct HashNode *node = &hashNodes[n];
+    return hashJoin(hashNodes[node->nw].se, hashNodes[node->ne].sw,
+                    hashNodes[node->sw].ne, hashNodes[node->se].nw);
+}
+
+/*
+ * hashStep4x4 - Base case: the middle 2x2 of a 4x4 node, one generation on
+ *
+ * Level 0 nodes 0 and 1 are the dead and live cell, so a leaf's index is
+ * its state.
+ */
+static uint32_t hashStep4x4(uint32_t n) {
+    const struct HashNode *node = &hashNodes[n];
+    const uint32_t quadrants[4] = { node->nw, node->ne, node->sw, node->se };
+    int cell[4][4];
+
+    // Unpack the 16 cells into cell[y][x]
+    for (int q = 0; q < 4; q++) {
+        const struct HashNode *quad = &hashNodes[quadrants[q]];
+        int x = (q % 2) * 2;
+        int y = (q / 2) * 2;
+        cell[y][x] = (int)quad->nw;
+        cell[y][x + 1] = (int)quad->ne;
+        cell[y + 1][x] = (int)quad->sw;
+        cell[y + 1][x + 1] = (int)quad->se;
+    }
+
+    uint32_t next[4];
+    for (int i = 0; i < 4; i++) {
+        int x = 1 + i % 2;
+        int y = 1 + i / 2;
+        int numNeighbors = 0;
+        for (int dy = -1; dy <= 1; dy++) {
+            for (int dx = -1; dx <= 1; dx++) {
+                numNeighbors += (dx != 0 || dy != 0) && cell[y + dy][x + dx];
+            }
+        }
+        next[i] = (lifeRule >> (numNeighbors + (cell[y][x] ? 16 : 0))) & 1;
+    }
+    return hashJoin(next[0], next[1], next[2], next[3]);
+}
+
+/*
+ * hashSuccessor - The middle half of a node, 2^step generations later
+ *
+ * For a node of level k the middle level k-1 square is fully determined
+ * for up to 2^(k-2) generations, so the step is capped at k-2. The node
+ * is split into nine overlapping level k-1 squares; each is advanced
+ * recursively, the results are combined into four squares and those are
+ * advanced again (full speed) or just re-centered (when step is smaller
+ * than k-2, so only the first half of the time is spent).
+ *
+ * Results are memoized per node together with the step they are for.
+ */
+static uint32_t hashSuccessor(uint32_t n, int step) {
+    int level = hashNodes[n].level;
+    if (step > level - 2) {
+        step = level - 2;
+    }
+
+    if (n == hashEmptyNode(level)) {
+        return hashEmptyNode(level - 1);
+    }
+    if (hashNodes[n].resultStep == step) {
+        return hashNodes[n].result;
+    }
+
+    uint32_t result;
+    if (level == 2) {
+        result = hashStep4x4(n);
+    } else {
+        const struct HashNode *node = &hashNodes[n];
+        const struct HashNode *nw = &hashNodes[node->nw];
+        const struct HashNode *ne = &hashNodes[node->ne];
+        const struct HashNode *sw = &hashNodes[node->sw];
+        const struct HashNode *se = &hashNodes[node->se];
+
+        // The nine overlapping squares, row by row
+        uint32_t square[9] = {
+            node->nw,
+            hashJoin(nw->ne, ne->nw, nw->se, ne->sw),
+            node->ne,
+            hashJoin(nw->sw, nw->se, sw->nw, sw->ne),
+            hashJoin(nw->se, ne->sw, sw->ne, se->nw),
+            hashJoin(ne->sw, ne->se, se->nw, se->ne),
+            node->sw,
+            hashJoin(sw->ne, se->nw, sw->se, se->sw),
+            node->se,
+        };
+        for (int i = 0; i < 9; i++) {
+            square[i] = hashSuccessor(square[i], step);
+        }
+
+        uint32_t quad[4];
+        for (int i = 0; i < 4; i++) {
+            int first = (i / 2) * 3 + i % 2;
+            quad[i] = hashJoin(square[first], square[first + 1],
+                               square[first + 3], square[first + 4]);
+            quad[i] = step == level - 2 ? hashSuccessor(quad[i], step) : hashCenter(quad[i]);
+        }
+        result = hashJoin(quad[0], quad[1], quad[2], quad[3]);
+    }
+
+    hashNodes[n].result = result;
+    hashNodes[n].resultStep = (int8_t)step;
+    return result;
+}
+
+/*
+ * hashBuild - Build the node for the 2^level square of nextCells at (x, y)
+ */
+static uint32_t hashBuild(int level, int x, int y) {
+    if (level == 0) {
+        return (uint32_t)nextCellAlive(x, y);
+    }
+    int half = 1 << (level - 1);
+    return hashJoin(hashBuild(level - 1, x, y), hashBuild(level - 1, x + half, y),
+                    hashBuild(level - 1, x, y + half), hashBuild(level - 1, x + half, y + half));
+}
+
+/*
+ * hashWrite - Store a node into the 2^level square of nextCells at (x, y)
+ *
+ * Returns:
+ *   1 on success, 0 if memory ran out for the live cells
+ */
+static int hashWrite(uint32_t n, int level, int x, int y) {
+    if (level == 0) {
+        return setNextCell(x, y, n == 1);
+    }
+    if (n == hashEmptyNode(level)) {
+        // Dead cells never need memory of their own
+        int size = 1 << level;
+        for (int dy = 0; dy < size; dy++) {
+            for (int dx = 0; dx < size; dx++) {
+                setNextCell(x + dx, y + dy, 0);
+            }
+        }
+        return 1;
+    }
+    const struct HashNode *node = &hashNodes[n];
+    int half = 1 << (level - 1);
+    return hashWrite(node->nw, level - 1, x, y)
+        && hashWrite(node->ne, level - 1, x + half, y)
+        && hashWrite(node->sw, level - 1, x, y + half)
+        && hashWrite(node->se, level - 1, x + half, y + half);
+}
+
+/*
+ * hashMark - Mark a node and everything it refers to as reachable
+ */
+static void hashMark(uint32_t n, int keepMemos) {
+    struct HashNode *node = &hashNodes[n];
+    if (node->marked) {
+        return;
+    }
+    node->marked = 1;
+    if (node->level > 0) {
+        hashMark(node->nw, keepMemos);
+        hashMark(node->ne, keepMemos);
+        hashMark(node->sw, keepMemos);
+        hashMark(node->se, keepMemos);
+    }
+    if (keepMemos && node->resultStep >= 0) {
+        hashMark(node->result, keepMemos);
+    }
+}
+
+/*
+ * hashCollectGarbage - Free every node the board no longer needs
+ *
+ * Marks everything reachable from the board (and from the memoized
+ * results, when keepMemos is set), then rebuilds the hash table from the
+ * marked nodes and puts the rest on the free list. Dropping the memos
+ * frees much more, at the price of recomputing those futures later.
+ */
+void hashCollectGarbage(int keepMemos) {
+    hashMark(0, keepMemos);
+    hashMark(1, keepMemos);
+    hashMark(hashRoot, keepMemos);
+    for (int level = 0; level < HASH_MAX_LEVEL; level++) {
+        if (hashEmpty[level] != HASH_NONE) {
+            hashMark(hashEmpty[level], keepMemos);
+        }
+    }
+
+    for (uint32_t b = 0; b <= hashBucketMask; b++) {
+        hashBuckets[b] = HASH_NONE;
+    }
+    hashFreeList = HASH_NONE;
+    hashLiveNodes = 2;
+
+    // Leaves 0 and 1 are never looked up by quadrants, so they stay out
+    // of the hash table
+    hashNodes[0].marked = hashNodes[1].marked = 0;
+    for (uint32_t n = hashUsed; n-- > 2;) {
+        struct HashNode *node = &hashNodes[n];
+        if (node->marked) {
+            uint32_t bucket = hashBucket(node->nw, node->ne, node->sw, node->se);
+            node->marked = 0;
+            node->next = hashBuckets[bucket];
+            hashBuckets[bucket] = n;
+            hashLiveNodes++;
+            if (!keepMemos) {
+                node->resultStep = -1;
+            }
+        } else {
+            node->level = HASH_FREE;
+            node->next = hashFreeList;
+            hashFreeList = n;
+        }
+    }
+}
+
+/*
+ * hashTryAdvance - Advance the board by 2^step generations
+ *
+ * The board is tiled into a square of level L = max(k + 2, step + 2)
+ * (k = board level), whose successor is the tiling 2^step generations
+ * later, shifted by 2^(L-2) - a whole number of boards. Its top-left
+ * level k square is therefore the new board.
+ *
+ * Returns:
+ *   1 on success, 0 if the node cache filled up (the board is unchanged)
+ */
+static int hashTryAdvance(int step) {
+    jmp_buf outOfMemory;
+    hashOutOfMemory = &outOfMemory;
+    if (setjmp(outOfMemory)) {
+        return 0;
+    }
+
+    int level = hashRootLevel + 2 > step + 2 ? hashRootLevel + 2 : step + 2;
+    uint32_t tiling = hashRoot;
+    for (int l = hashRootLevel; l < level; l++) {
+        tiling = hashJoin(tiling, tiling, tiling, tiling);
+    }
+
+    uint32_t result = hashSuccessor(tiling, step);
+    for (int l = level - 1; l > hashRootLevel; l--) {
+        result = hashNodes[result].nw;
+    }
+    hashRoot = result;
+    return 1;
+}
+
+/*
+ * hashAdvance - Advance by 2^step generations within the memory cap
+ *
+ * Collects garbage when the cache is getting full. If a step still does
+ * not fit, it is split into two steps of half the size.
+ */
+static int hashAdvance(int step) {
+    if (hashLiveNodes > hashCapacity / 4 * 3) {
+        hashCollectGarbage(1);
+        if (hashLiveNodes > hashCapacity / 2) {
+            hashCollectGarbage(0);
+        }
+    }
+    if (hashTryAdvance(step)) {
+        return 1;
+    }
+
+    hashCollectGarbage(0);
+    if (step == 0) {
+        return hashTryAdvance(0);
+    }
+    return hashAdvance(step - 1) && hashAdvance(step - 1);
+}
+
+/*
+ * hashLifeJump - Replace nextCells with its state N generations later
+ *
+ * Builds the quadtree from the grid, advances it one power of two at a
+ * time (one per set bit of N), writes it back and frees the cache.
+ *
+ * Returns:
+ *   1 on success, 0 if the board is unsupported or memory ran out
+ */
+int hashLifeJump(unsigned long long generations) {
+    if (storageMode == STORAGE_CHUNKED) {
+        fprintf(stderr, "HashLife runs on the torus; it cannot be used with --storage chunked\n");
+        return 0;
+    }
+    if (ruleStates > 2 || (lifeRule & RULE_BIRTH(0)) || ltlRule.radius > 0) {
+        fprintf(stderr, "HashLife cannot run rule %s\n", ruleText);
+        return 0;
+    }
+    if (!hashLifeSupported()) {
+        fprintf(stderr, "HashLife needs a square power-of-two board, e.g. --size 1024x1024\n");
+        return 0;
+    }
+
+    // Split the cap between node slots and one hash bucket per two slots
+    size_t bytes = nodeCacheMegabytes << 20;
+    size_t slots = bytes / (sizeof(struct HashNode) + sizeof(uint32_t) / 2);
+    hashCapacity = slots < HASH_NONE - 1 ? (uint32_t)slots : HASH_NONE - 1;
+    uint32_t buckets = 1;
+    while (buckets * 2 <= hashCapacity / 2) {
+        buckets *= 2;
+    }
+    hashBucketMask = buckets - 1;
+
+    // malloc only reserves address space; pages are touched as nodes are used
+    hashNodes = malloc(sizeof(struct HashNode) * hashCapacity);
+    hashBuckets = malloc(sizeof(uint32_t) * buckets);
+    if (hashNodes == NULL || hashBuckets == NULL || hashCapacity < 64) {
+        fprintf(stderr, "Could not allocate the HashLife node cache\n");
+        free(hashNodes);
+        free(hashBuckets);
+        return 0;
+    }
+    for (uint32_t b = 0; b < buckets; b++) {
+        hashBuckets[b] = HASH_NONE;
+    }
+
+    // Nodes 0 and 1 are the dead and the live cell
+    hashUsed = 2;
+    hashLiveNodes = 2;
+    hashFreeList = HASH_NONE;
+    for (int n = 0; n < 2; n++) {
+        hashNodes[n] = (struct HashNode){ HASH_NONE, HASH_NONE, HASH_NONE, HASH_NONE,
+                                          HASH_NONE, HASH_NONE, 0, -1, 0 };
+    }
+    for (int level = 0; level < HASH_MAX_LEVEL; level++) {
+        hashEmpty[level] = HASH_NONE;
+    }
+    hashEmpty[0] = 0;
+
+    hashRootLevel = 0;
+    while ((1 << hashRootLevel) < width) {
+        hashRootLevel++;
+    }
+
+    int ok = 1;
+    jmp_buf outOfMemory;
+    hashOutOfMemory = &outOfMemory;
+    if (setjmp(outOfMemory)) {
+        fprintf(stderr, "The board does not fit in a %zu MB node cache\n", nodeCacheMegabytes);
+        ok = 0;
+    } else {
+        hashRoot = hashBuild(hashRootLevel, 0, 0);
+    }
+
+    for (int step = 0; ok && step < 64; step++) {
+        if ((generations >> step) & 1) {
+            ok = hashAdvance(step);
+            if (!ok) {
+                fprintf(stderr, "HashLife ran out of node cache; raise --node-cache\n");
+            }
+        }
+    }
+
+    if (ok) {
+        numNextLiveCells = 0;
+        ok = hashWrite(hashRoot, hashRootLevel, 0, 0)
+             && (storageMode != STORAGE_SPARSE || sortNextLiveCells());
+        if (!ok) {
+            fprintf(stderr, "Out of memory for the live cells\n");
+        }
+
+        // The tile flags know nothing about the new board
+        markAllTilesChanged();
+    }
+
+    free(hashNodes);
+    free(hashBuckets);
+    hashNodes = NULL;
+    hashBuckets = NULL;
+    return ok;
+}
+
+/*
+ * jumpAhead - Apply --hashlife to the freshly seeded board
+ *
+ * Runs before the stats, dump and checkpoint writers are opened, so the
+ * generations they number start after the jump.
+ *
+ * Returns:
+ *   1 on success (or without --hashlife), 0 if the jump failed
+ */
+int jumpAhead(void) {
+    if (hashLifeGenerations == 0) {
+        return 1;
+    }
+    if (!hashLifeJump(hashLifeGenerations)) {
+        return 0;
+    }
+    startGeneration += hashLifeGenerations;
+    return 1;
+}
+
+/*
+ * boardChecksum - 64-bit fingerprint of the current generation
+ *
+ * Hashes the board row by row as packed 64-cell words, so the char and
+ * packed grids give the same value for the same pattern. Under a
+ * Generations rule the dying cells of each row are hashed after it, so
+ * kernels must agree on those too.
+ */
+uint64_t boardChecksum(void) {
+    uint64_t hash = UINT64_C(14695981039346656037);     // FNV-1a offset basis
+    size_t live = 0;    // Next live cell of a sparse board
+
+    for (int y = 0; y < height; y++) {
+        for (int i = 0; i < wordsPerRow; i++) {
+            uint64_t word = 0;
+            if (storageMode == STORAGE_SPARSE) {
+                int wordEnd = (i + 1) * WORD_BITS < width ? (i + 1) * WORD_BITS : width;
+                uint64_t end = cellKey(wordEnd, y);
+                while (live < numLiveCells && liveCells[live] < end) {
+                    word |= UINT64_C(1) << (liveCells[live] - cellKey(0, y)) % WORD_BITS;
+                    live++;
+                }
+            } else if (storageMode == STORAGE_CHUNKED) {
+                word = chunkWord(i, y) & (i == wordsPerRow - 1 ? lastWordMask : ~UINT64_C(0));
+            } else if (storageMode == STORAGE_PACKED) {
+                word = packedRow(packedCells, y)[i];
+            } else {
+                const char *row = cellRow(cells, y);
+                for (int b = 0; b < WORD_BITS && i * WORD_BITS + b < width; b++) {
+                    word |= (uint64_t)(row[i * WORD_BITS + b] == ALIVE) << b;
+                }
+            }
+            hash = (hash ^ word) * UINT64_C(1099511628211);     // FNV prime
+        }
+        if (ruleStates > 2 && storageMode == STORAGE_CHAR) {
+            const char *row = cellRow(cells, y);
+            for (int x = 0; x < width; x++) {
+                if (row[x] != ALIVE && row[x] != DEAD) {
+                    hash = (hash ^ ((uint64_t)x << 8 | (unsigned char)row[x])) * UINT64_C(1099511628211);
+                }
+            }
+        }
+    }
+    return hash;
+}
+
+/*
+ * monotonicSeconds - Seconds on a clock that never jumps
+ *
+ * CLOCK_MONOTONIC is unaffected by changes to the wall clock, so it is
+ * the right clock for measuring how long something took.
+ */
+double monotonicSeconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+/*
+ * kernelLabel - Name of the step function the current settings run
+ */
+const char *kernelLabel(void) {
+    switch (storageMode) {
+    case STORAGE_PACKED:
+        return temporalDepth > 1 ? "packed-temporal" : "packed";
+    case STORAGE_SPARSE:
+        return "sparse";
+    case STORAGE_CHUNKED:
+        return "chunked";
+    default:
+        return ltlRule.radius > 0 ? "summed-area" : charKernelName;
+    }
+}
+
+/*
+ * runBenchmark - Time a number of generations on a fresh random board
+ *                (or the --pattern board)
+ *
+ * Only the stepping is timed: allocating and seeding the board are not.
+ *
+ * Parameters:
+ *   generations - Generations to run (rounded up to whole --temporal steps)
+ *   seed        - Seed for the random starting board
+ *   result      - Receives the measurements
+ *
+ * Returns:
+ *   1 on success, 0 if memory ran out
+ */
+int runBenchmark(int generations, unsigned int seed, struct BenchResult *result) {
+    if (!allocateGrids(storageMode == STORAGE_CHAR, storageMode == STORAGE_PACKED)) {
+        fprintf(stderr, "Not enough memory for a %dx%d board\n", width, height);
+        return 0;
+    }
+    srand(seed);
+    if (!seedBoard()) {
+        freeGrids();
+        return 0;
+    }
+    double jumpStart = monotonicSeconds();
+    if (!jumpAhead() || !openStats() || !startDumpWriter() || !startCheckpointWriter()) {
+        stopDumpWriter();
+        closeStats();
+        freeGrids();
+        return 0;
+    }
+    result->jumpSeconds = monotonicSeconds() - jumpStart;
+
+    int gen = 0;
+    int stepped = 0;
+    int boardIsCurrent = 0;     // The loop ended with the final board already current
+    int failed = 0;             // Memory ran out; generation gen is final and recorded
+    double start = monotonicSeconds();
+    while (gen < generations) {
+        copyGrid();
+        if (cycleMode != CYCLES_OFF) {
+            // A jump lands on a board that is already generation gen
+            gen = (int)(watchForCycles(startGeneration + (unsigned long long)gen,
+                                       startGeneration + (unsigned long long)generations)
+                        - startGeneration);
+            if (gen >= generations || (cycleMode == CYCLES_STOP && atomic_load(&cyclePeriod) > 0)) {
+                boardIsCurrent = 1;
+                break;
+            }
+        }
+        recordStats(startGeneration + (unsigned long long)gen);
+        maybeCheckpoint(startGeneration + (unsigned long long)gen);
+        maybeDump(startGeneration + (unsigned long long)gen);
+        if (!calculateNextGeneration()) {
+            fprintf(stderr, "Out of memory after generation %llu\n",
+                    startGeneration + (unsigned long long)gen);
+            failed = 1;
+            break;
+        }
+        gen += temporalDepth;
+        stepped += temporalDepth;
+    }
+    if (!boardIsCurrent && !failed) {
+        copyGrid();
+    }
+    result->seconds = monotonicSeconds() - start;
+    result->generations = gen;
+    result->stepped = stepped;
+    result->checksum = boardChecksum();
+    if (!failed) {
+        recordStats(startGeneration + (unsigned long long)gen);
+        maybeDump(startGeneration + (unsigned long long)gen);
+    }
+    stopCheckpointWriter(startGeneration + (unsigned long long)gen);
+    stopDumpWriter();
+    closeStats();
+    int ok = (savePath == NULL || savePattern(savePath)) && !failed;
+
+    freeGrids();
+    return ok;
+}
+
+/*
+ * reportBenchmark - Run --headless once and print the results
+ *
+ * The checksum makes it easy to confirm that a faster build still
+ * computes the same board: the same seed, size and generations must
+ * always give the same checksum, whatever the kernel or thread count.
+ */
+int reportBenchmark(int generations, unsigned int seed) {
+    struct BenchResult result;
+    if (!runBenchmark(generations, seed, &result)) {
+        return 0;
+    }
+
+    double cells = (double)width * (double)height * result.stepped;
+    printf("Board:          %dx%d, %s kernel, %d thread%s, ", width, height,
+           kernelLabel(), numThreads, numThreads == 1 ? "" : "s");
+    if (patternPath != NULL) {
+        printf("pattern %s\n", patternPath);
+    } else {
+        printf("seed %u\n", seed);
+    }
+    if (lifeRule != CONWAY_RULE || ruleStates > 2 || ltlRule.radius > 0) {
+        printf("Rule:           %s\n", ruleText);
+    }
+    if (hashLifeGenerations > 0) {
+        printf("HashLife:       %llu generations in %.3f s\n", hashLifeGenerations, result.jumpSeconds);
+    }
+    printf("Generations:    %d", result.generations);
+    if (result.stepped != result.generations) {
+        printf(" (%d computed)", result.stepped);
+    }
+    printf("\n");
+    char cycle[128];
+    if (describeCycle(cycle, sizeof cycle)) {
+        printf("Cycle:          %s\n", cycle);
+    }
+    if (result.stepped > 0) {
+        printf("Wall time:      %.3f s\n", result.seconds);
+        printf("Generations/s:  %.1f\n", result.stepped / result.seconds);
+        printf("Cells/s:        %.4g\n", cells / result.seconds);
+    }
+    printf("Checksum:       %016llx\n", (unsigned long long)result.checksum);
+    return 1;
+}
+
+/*
+ * runSweep - Benchmark several board sizes and thread counts as CSV
+ *
+ * Runs every square size in sweepSizes with 1, 2, 4, ... threads up to
+ * the number of online CPUs (which is always included), using the
+ * kernel, storage and schedule from the command line. The worker pool
+ * is restarted for each thread count. One CSV row per run goes to
+ * stdout, ready to be compared across kernels and builds.
+ */
+int runSweep(int generations, unsigned int seed) {
+    static const int sweepSizes[] = { 256, 1024, 4096 };
+    int cpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int ok = 1;
+
+    printf("kernel,threads,width,height,generations,seconds,generations_per_sec,"
+           "cells_per_sec,checksum\n");
+    for (size_t s = 0; s < sizeof(sweepSizes) / sizeof(sweepSizes[0]) && ok; s++) {
+        width = height = sweepSizes[s];
+
+        for (int threads = 1; ok; threads = threads * 2 < cpus ? threads * 2 : cpus) {
+            stopWorkerPool();
+            numThreads = threads;
+            if (!startWorkerPool()) {
+                fprintf(stderr, "Could not start %d threads, running on 1\n", threads);
+            }
+
+            struct BenchResult result;
+            ok = runBenchmark(generations, seed, &result);
+            if (ok) {
+                double cells = (double)width * (double)height * result.generations;
+                printf("%s,%d,%d,%d,%d,%.6f,%.2f,%.6g,%016llx\n", kernelLabel(), numThreads,
+                       width, height, result.generations, result.seconds,
+                       result.generations / result.seconds, cells / result.seconds,
+                       (unsigned long long)result.checksum);
+                fflush(stdout);
+            }
+            if (threads >= cpus) {
+                break;
+            }
+        }
+    }
+    return ok;
+}
+
+/*
+ * sameStats - Compare what two step kernels counted
+ *
+ * Parameters:
+ *   a, b          - The two counts
+ *   compareChanged - Whether the changed cells must match too
+ *
+ * Returns:
+ *   1 if they agree, 0 otherwise
+ */
+static int sameStats(const struct RegionStats *a, const struct RegionStats *b, int compareChanged) {
+    return a->population == b->population
+        && a->xMin == b->xMin && a->yMin == b->yMin
+        && a->xMax == b->xMax && a->yMax == b->yMax
+        && (!compareChanged || a->changed == b->changed);
+}
+
+/*
+ * verifyKernels - Cross-check every step kernel against the char
+ *                 reference implementation
+ *
+ * First the scalar reference runs on a single thread from a random
+ * pattern and the checksum of every generation is recorded. Then every
+ * char kernel this CPU supports and the packed kernel run from the same
+ * pattern through calculateNextGeneration - with the selected --threads
+ * and --schedule - and must reproduce every checksum, and the population,
+ * bounding box and changed cells the step counted for --stats. On square
+ * power-of-two boards HashLife must land on the same checksums too.
+ * Generations rules only run on the char grid, so only the char kernels
+ * are compared for them.
+ *
+ * Parameters:
+ *   generations - How many generations to compare
+ *
+ * Returns:
+ *   1 if every generation matched, 0 on the first mismatch
+ */
+int verifyKernels(int generations) {
+    if (ltlRule.radius > 0) {
+        return verifyLtl(generations);
+    }
+
+    enum CpuLevel cpu = detectCpuLevel();
+    unsigned int seed = (unsigned int)rand();
+    uint64_t *expected = malloc(sizeof(uint64_t) * ((size_t)generations + 1));
+    struct RegionStats *expectedStats = malloc(sizeof(struct RegionStats) * ((size_t)generations + 2));
+    int requestedStats = collectStats;
+    collectStats = 1;
+
+    storageMode = STORAGE_CHAR;
+    if (expected == NULL || expectedStats == NULL || !allocateGrids(1, 0)) {
+        fprintf(stderr, "Not enough memory for a %dx%d board\n", width, height);
+        free(expected);
+        free(expectedStats);
+        collectStats = requestedStats;
+        return 0;
+    }
+
+    // Reference run: scalar kernel, whole board at once
+    // expectedStats[gen] is what the step that made generation gen counted
+    srand(seed);
+    initializeGrid();
+    for (int gen = 0; gen <= generations; gen++) {
+        copyGrid();
+        expected[gen] = boardChecksum();
+        refreshGhostCells(cells);
+        expectedStats[gen + 1] = calculateNextGenerationChar(0, 0, width, height);
+    }
+    freeGrids();
+
+    // Every other kernel, run exactly like the main loop runs it
+    int ok = 1;
+    // Temporal blocking is checked at the requested depth, or 4 if none
+    int requestedDepth = temporalDepth;
+    for (int k = 0; k < NUM_CHAR_KERNELS + 3 && ok; k++) {
+        const char *name;
+        temporalDepth = 1;
+        if (k < NUM_CHAR_KERNELS) {
+            if (charKernels[k].level > cpu) {
+                continue;
+            }
+            storageMode = STORAGE_CHAR;
+            charKernel = charKernels[k].step;
+            name = charKernels[k].name;
+        } else if (ruleStates > 2) {
+            continue;   // Dying states do not fit in a bit
+        } else if (k == NUM_CHAR_KERNELS) {
+            storageMode = STORAGE_PACKED;
+            name = "packed";
+        } else if (k == NUM_CHAR_KERNELS + 1) {
+            storageMode = STORAGE_PACKED;
+            temporalDepth = requestedDepth > 1 ? requestedDepth : 4;
+            name = "packed temporal";
+        } else if (lifeRule & RULE_BIRTH(0)) {
+            continue;   // An empty neighborhood comes alive: nothing stays sparse
+        } else {
+            storageMode = STORAGE_SPARSE;
+            name = "sparse";
+        }
+
+        srand(seed);
+        if (!allocateGrids(storageMode == STORAGE_CHAR, storageMode == STORAGE_PACKED)
+            || !initializeGrid()) {
+            fprintf(stderr, "Not enough memory for a %dx%d board\n", width, height);
+            freeGrids();
+            ok = 0;
+            break;
+        }
+        for (int gen = 0; gen <= generations; gen += temporalDepth) {
+            copyGrid();
+            if (boardChecksum() != expected[gen]) {
+                printf("Mismatch in %s kernel at generation %d\n", name, gen);
+                ok = 0;
+                break;
+            }
+            // A temporal block counts the cells that changed over all of
+            // its generations, which the reference does not
+            if (gen > 0 && !sameStats(&stepStats, &expectedStats[gen], temporalDepth == 1)) {
+                printf("Stats mismatch in %s kernel at generation %d\n", name, gen);
+                ok = 0;
+                break;
+            }
+            if (!calculateNextGeneration()) {
+                fprintf(stderr, "Out of memory in %s kernel at generation %d\n", name, gen);
+                ok = 0;
+                break;
+            }
+        }
+        freeGrids();
+    }
+    temporalDepth = requestedDepth;
+
+    // HashLife jumps straight to a few of the recorded generations
+    if (ok && hashLifeSupported() && ruleStates == 2) {
+        int targets[3] = { 1, generations / 2, generations };
+        storageMode = STORAGE_CHAR;
+        for (int t = 0; t < 3 && ok; t++) {
+            if (targets[t] < 1 || !allocateGrids(1, 0)) {
+                continue;
+            }
+            srand(seed);
+            initializeGrid();
+            ok = hashLifeJump((unsigned long long)targets[t]);
+            copyGrid();
+            if (ok && boardChecksum() != expected[targets[t]]) {
+                printf("Mismatch in HashLife at generation %d\n", targets[t]);
+                ok = 0;
+            }
+            freeGrids();
+        }
+    }
+
+    free(expected);
+    free(expectedStats);
+
+    // The plane has no wraparound, so it gets a reference run of its own
+    // (unless the rule fills it, see above)
+    if (ok && !(lifeRule & RULE_BIRTH(0)) && ruleStates == 2) {
+        ok = verifyPlane(generations, seed);
+    }
+    collectStats = requestedStats;
+
+    if (ok) {
+        printf("Verified %d generations on a %dx%d board: all kernels match the char reference\n",
+               generations, width, height);
+    }
+    return ok;
+}
+
+/*
+ * verifyPlane - Check the chunked plane against the char reference
+ *
+ * On a plane nothing wraps around, so the torus checksums do not apply.
+ * Instead the soup is placed in the middle of a bigger torus with more
+ * than `generations` dead cells on every side. Patterns spread by at
+ * most one cell per generation, so nothing can reach around that torus
+ * and the char reference behaves exactly like the unbounded plane. The
+ * padding grows with the generations, so at most 100 are checked.
+ *
+ * Returns:
+ *   1 if the chunked plane matched in every generation, 0 otherwise
+ */
+int verifyPlane(int generations, unsigned int seed) {
+    int soupWidth = width;
+    int soupHeight = height;
+    if (generations > 100) {
+        generations = 100;
+    }
+    int margin = generations + 1;
+    width = soupWidth + 2 * margin;
+    height = soupHeight + 2 * margin;
+
+    uint64_t *expected = malloc(sizeof(uint64_t) * ((size_t)generations + 1));
+    struct RegionStats *expectedStats = malloc(sizeof(struct RegionStats) * ((size_t)generations + 2));
+    int ok = expected != NULL && expectedStats != NULL;
+
+    for (int run = 0; run < 2 && ok; run++) {
+        storageMode = run == 0 ? STORAGE_CHAR : STORAGE_CHUNKED;
+        if (!allocateGrids(storageMode == STORAGE_CHAR, 0)) {
+            ok = 0;
+            break;
+        }
+
+        // The same soup as the torus runs, in the middle of the board
+        srand(seed);
+        for (int y = 0; ok && y < soupHeight; y++) {
+            for (int x = 0; ok && x < soupWidth; x++) {
+                ok = setNextCell(margin + x, margin + y, rand() % 2 == 0);
+            }
+        }
+        if (!ok) {
+            fprintf(stderr, "Out of memory for the live cells\n");
+            freeGrids();
+            break;
+        }
+
+        for (int gen = 0; gen <= generations; gen++) {
+            copyGrid();
+            if (run == 0) {
+                expected[gen] = boardChecksum();
+                refreshGhostCells(cells);
+                expectedStats[gen + 1] = calculateNextGenerationChar(0, 0, width, height);
+            } else {
+                if (boardChecksum() != expected[gen]) {
+                    printf("Mismatch in chunked plane at generation %d\n", gen);
+                    ok = 0;
+                    break;
+                }
+                if (gen > 0 && !sameStats(&stepStats, &expectedStats[gen], 1)) {
+                    printf("Stats mismatch in chunked plane at generation %d\n", gen);
+                    ok = 0;
+                    break;
+                }
+                if (!calculateNextGeneration()) {
+                    fprintf(stderr, "Out of memory in chunked plane at generation %d\n", gen);
+                    ok = 0;
+                    break;
+                }
+            }
+        }
+        freeGrids();
+    }
+    if (expected == NULL || expectedStats == NULL) {
+        fprintf(stderr, "Not enough memory for a %dx%d board\n", width, height);
+    }
+
+    free(expected);
+    free(expectedStats);
+    width = soupWidth;
+    height = soupHeight;
+    return ok;
+}
+
+/*
+ * printUsage - Print the supported command-line options
+ */
+void printUsage(const char *programName) {
+    fprintf(stderr, "Usage: %s [--size WIDTHxHEIGHT] [--storage char|packed|sparse|chunked] [--kernel NAME]\n"
+                    "          [--threads N (0 = all CPUs)] [--schedule bands|steal]\n"
+                    "          [--track-changes on|off] [--temporal K]\n"
+                    "          [--rule B3/S23|S/B|S/B/C|Rr,C0,Mm,Smin..max,Bmin..max,NM]\n"
+                    "          [--hashlife GENERATIONS] [--node-cache MB] [--verify GENERATIONS]\n"
+                    "          [--render diff|full] [--view braille|half|density] [--zoom CELLS_PER_DOT]\n"
+                    "          [--fps FRAMES_PER_SEC] [--rate GENERATIONS_PER_SEC (0 = flat out)]\n"
+                    "          [--pattern FILE.rle|FILE.cells] [--save FILE.rle]\n"
+                    "          [--checkpoint FILE] [--checkpoint-every GENERATIONS] [--restore FILE]\n"
+                    "          [--dump FILE] [--dump-every GENERATIONS] [--dump-format pbm|raw]\n"
+                    "          [--cycles off|report|stop|jump] [--jump-to GENERATION]\n"
+                    "          [--stats FILE] [--stats-format csv|binary]\n"
+                    "          [--trace FILE.json] [--histograms] [--trace-paused]\n"
+                    "          [--census SOUPS] [--soup-size N]\n"
+                    "          [--headless] [--sweep] [--generations N (0 = only --hashlife)] [--seed S]\n",
+            programName);
+    fprintf(stderr, "Kernels (auto picks the widest supported):");
+    for (int i = 0; i < NUM_CHAR_KERNELS; i++) {
+        fprintf(stderr, " %s", charKernels[i].name);
+    }
+    fprintf(stderr, " auto\n");
+}
+
+/*
+ * handleSignal - Signal handler for Ctrl-C (SIGINT)
+ *
+ * When the user presses Ctrl-C, this function is called.
+ * We set a flag to exit gracefully rather than terminating abruptly.
+ *
+ * Parameters:
+ *   signal - The signal number (SIGINT in our case)
+ */
+void handleSignal(int signal) {
+    // Mark that we should exit the main loop
+    // A lock-free atomic is safe to write from a signal handler and,
+    // unlike volatile sig_atomic_t, is also seen correctly by the
+    // simulation thread
+    shouldExit = 1;
+
+    // Note: We don't do complex operations here because signal handlers
+    // should be kept simple and fast
+}
+
+/*
+ * clearScreen - Clear the terminal screen
+ *
+ * This function uses ANSI escape sequences to clear the screen.
+ * ANSI escape codes are special character sequences that control
+ * terminal behavior.
+ */
+void clearScreen(void) {
+    // Print ANSI escape sequence to clear screen and move cursor to top-left
+    // \033 is the ESC character (octal 033 = decimal 27)
+    // [2J clears the entire screen
+    // [H moves cursor to home position (top-left)
+    printf("\033[2J\033[H");
+
+    // Alternative method (less portable but simpler):
+    // system("clear");  // On Unix/Linux/Mac
+    // system("cls");    // On Windows
+
+    // Flush output buffer to ensure immediate display
+    // fflush() forces all buffered output to be written immediately
+    fflush(stdout);
+}
+
+// ============================================================================
+// PATTERN FILES
+// ============================================================================
+
+/*
+ * openPattern - Map a pattern file and find its size
+ *
+ * The file is mapped read-only and never copied: openPattern reads the
+ * RLE header (or, for a .cells file, scans the rows once) and loadPattern
+ * later streams over the same mapping. A file is taken as RLE unless its
+ * name ends in .cells.
+ *
+ * Returns:
+ *   1 on success, 0 after printing what went wrong
+ */
+int openPattern(const char *path, struct Pattern *pattern) {
+    memset(pattern, 0, sizeof *pattern);
+    size_t nameLength = strlen(path);
+    pattern->isRle = !(nameLength >= 6 && strcmp(path + nameLength - 6, ".cells") == 0);
+
+    int fd = open(path, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        fprintf(stderr, "Cannot open %s: %s\n", path, strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+        }
+        return 0;
+    }
+    pattern->length = (size_t)info.st_size;
+    if (pattern->length > 0) {
+        void *data = mmap(NULL, pattern->length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            fprintf(stderr, "Cannot map %s: %s\n", path, strerror(errno));
+            close(fd);
+            return 0;
+        }
+        // One front-to-back pass: let the kernel read ahead
+        madvise(data, pattern->length, MADV_SEQUENTIAL);
+        pattern->data = data;
+    }
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+
+    const char *p = pattern->data;
+    const char *end = p + pattern->length;
+
+    if (!pattern->isRle) {
+        // Plaintext: '!' starts a comment line, every other line is a row
+        pattern->body = p;
+        while (p < end) {
+            const char *lineEnd = memchr(p, '\n', (size_t)(end - p));
+            if (lineEnd == NULL) {
+                lineEnd = end;
+            }
+            if (*p != '!') {
+                int cellsInRow = 0;
+                for (const char *c = p; c < lineEnd; c++) {
+                    cellsInRow += *c == '.' || *c == 'O' || *c == '*';
+                }
+                if (cellsInRow > pattern->width) {
+                    pattern->width = cellsInRow;
+                }
+                pattern->height++;
+            }
+            p = lineEnd + 1;
+        }
+        return 1;
+    }
+
+    // RLE: skip the '#' comment lines, then read "x = m, y = n, rule = ..."
+    while (p < end && (*p == '#' || *p == '\n' || *p == '\r')) {
+        const char *lineEnd = memchr(p, '\n', (size_t)(end - p));
+        p = lineEnd != NULL ? lineEnd + 1 : end;
+    }
+    const char *headerEnd = p < end ? memchr(p, '\n', (size_t)(end - p)) : NULL;
+    if (headerEnd == NULL) {
+        headerEnd = end;
+    }
+    while (p < headerEnd) {
+        // One "key = value" item
+        while (p < headerEnd && (*p == ' ' || *p == '\t' || *p == ',')) {
+            p++;
+        }
+        const char *key = p;
+        while (p < headerEnd && *p != '=' && *p != ' ') {
+            p++;
+        }
+        size_t keyLength = (size_t)(p - key);
+        while (p < headerEnd && (*p == ' ' || *p == '=')) {
+            p++;
+        }
+        // The rule comes last and runs to the end of the line: Larger-
+        // than-Life rules have commas of their own
+        const char *value = p;
+        int isRule = keyLength == 4 && strncmp(key, "rule", 4) == 0;
+        while (p < headerEnd && (*p != ',' || isRule) && *p != '\r') {
+            p++;
+        }
+        long number = 0;
+        for (const char *digit = value; digit < p && *digit >= '0' && *digit <= '9'; digit++) {
+            number = number * 10 + (*digit - '0');
+            if (number > INT32_MAX) {
+                break;
+            }
+        }
+        if (keyLength == 1 && *key == 'x') {
+            pattern->width = (int)(number <= INT32_MAX ? number : -1);
+        } else if (keyLength == 1 && *key == 'y') {
+            pattern->height = (int)(number <= INT32_MAX ? number : -1);
+        } else if (isRule) {
+            pattern->rule = value;
+            pattern->ruleLength = (size_t)(p - value);
+        }
+        if (p < headerEnd && *p == '\r') {
+            p++;
+        }
+    }
+    if (pattern->width <= 0 || pattern->height <= 0) {
+        fprintf(stderr, "%s: missing or invalid \"x = ..., y = ...\" RLE header\n", path);
+        closePattern(pattern);
+        return 0;
+    }
+    pattern->body = headerEnd < end ? headerEnd + 1 : end;
+    return 1;
+}
+
+/*
+ * closePattern - Unmap a pattern file
+ */
+void closePattern(struct Pattern *pattern) {
+    if (pattern->data != NULL) {
+        munmap((void *)pattern->data, pattern->length);
+    }
+    memset(pattern, 0, sizeof *pattern);
+}
+
+/*
+ * clearNextBoard - Make every cell of a freshly allocated board dead
+ *
+ * (A freshly allocated chunked plane has no chunks, so it is empty already.)
+ */
+static void clearNextBoard(void) {
+    numNextLiveCells = 0;
+    for (int y = 0; y < height; y++) {
+        if (nextCells != NULL) {
+            memset(cellRow(nextCells, y), DEAD, (size_t)width);
+        }
+        if (packedNextCells != NULL) {
+            memset(packedRow(packedNextCells, y), 0, (size_t)wordsPerRow * sizeof(uint64_t));
+        }
+    }
+}
+
+/*
+ * setNextRun - Make count cells alive from (x, y) to the right
+ *
+ * On a packed board whole words are filled at once; the other storage
+ * modes go cell by cell.
+ *
+ * Returns:
+ *   1 on success, 0 if memory ran out for the live cells
+ */
+static int setNextRun(int x, int y, int count) {
+    if (storageMode != STORAGE_PACKED) {
+        for (int i = 0; i < count; i++) {
+            if (!setNextCell(x + i, y, 1)) {
+                return 0;
+            }
+        }
+        return 1;
+    }
+    uint64_t *row = packedRow(packedNextCells, y);
+    while (count > 0) {
+        int bit = x % WORD_BITS;
+        int bits = WORD_BITS - bit < count ? WORD_BITS - bit : count;
+        uint64_t mask = bits == WORD_BITS ? ~UINT64_C(0) : ((UINT64_C(1) << bits) - 1) << bit;
+        row[x / WORD_BITS] |= mask;
+        x += bits;
+        count -= bits;
+    }
+    return 1;
+}
+
+/*
+ * loadPattern - Make a mapped pattern the next generation
+ *
+ * The pattern is centered on the board and everything else is dead.
+ * Cells outside the size given in the header are dropped.
+ *
+ * Returns:
+ *   1 on success, 0 after printing what went wrong
+ */
+int loadPattern(const struct Pattern *pattern) {
+    if (pattern->width > width || pattern->height > height) {
+        fprintf(stderr, "A %dx%d pattern does not fit on a %dx%d board\n",
+                pattern->width, pattern->height, width, height);
+        return 0;
+    }
+
+    clearNextBoard();
+
+    int left = (width - pattern->width) / 2;
+    int top = (height - pattern->height) / 2;
+    const char *p = pattern->body;
+    const char *end = pattern->data + pattern->length;
+
+    if (!pattern->isRle) {
+        for (int y = 0; p < end && y < pattern->height; ) {
+            const char *lineEnd = memchr(p, '\n', (size_t)(end - p));
+            if (lineEnd == NULL) {
+                lineEnd = end;
+            }
+            if (*p != '!') {
+                int x = 0;
+                for (const char *c = p; c < lineEnd; c++) {
+                    if ((*c == 'O' || *c == '*') && !setNextCell(left + x, top + y, 1)) {
+                        fprintf(stderr, "Out of memory for the live cells\n");
+                        return 0;
+                    }
+                    x += *c == '.' || *c == 'O' || *c == '*';
+                }
+                y++;
+            }
+            p = lineEnd + 1;
+        }
+    } else {
+        // Items are an optional run count followed by a tag:
+        // b or . dead, o or another letter alive, $ end of row, ! end of pattern
+        long count = 0;
+        long x = 0;
+        long y = 0;
+        for (; p < end && *p != '!'; p++) {
+            char c = *p;
+            if (c >= '0' && c <= '9') {
+                count = count * 10 + (c - '0');
+                if (count > INT32_MAX) {
+                    fprintf(stderr, "RLE run count too large\n");
+                    return 0;
+                }
+                continue;
+            }
+            if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+                continue;
+            }
+            long run = count > 0 ? count : 1;
+            count = 0;
+            if (c == '$') {
+                y += run;
+                x = 0;
+            } else if (c == 'b' || c == '.') {
+                x += run;
+            } else if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) {
+                // Clip the run to the pattern's own box
+                if (y < pattern->height && x < pattern->width) {
+                    long cells = x + run <= pattern->width ? run : pattern->width - x;
+                    if (!setNextRun(left + (int)x, top + (int)y, (int)cells)) {
+                        fprintf(stderr, "Out of memory for the live cells\n");
+                        return 0;
+                    }
+                }
+                x += run;
+            } else {
+                fprintf(stderr, "Unexpected '%c' in RLE data\n", c);
+                return 0;
+            }
+        }
+    }
+
+    if (storageMode == STORAGE_SPARSE && !sortNextLiveCells()) {
+        fprintf(stderr, "Out of memory for the live cells\n");
+        return 0;
+    }
+    // Nothing is known about the tiles yet
+    markAllTilesChanged();
+    return 1;
+}
+
+/*
+ * appendRleItem - Append one RLE run to a file, wrapping lines at 70 chars
+ */
+static void appendRleItem(FILE *file, long run, char tag, int *column) {
+    char item[24];
+    int length = run > 1 ? snprintf(item, sizeof item, "%ld%c", run, tag)
+                         : snprintf(item, sizeof item, "%c", tag);
+    if (*column + length > 70) {
+        fputc('\n', file);
+        *column = 0;
+    }
+    fwrite(item, 1, (size_t)length, file);
+    *column += length;
+}
+
+/*
+ * savePattern - Write the current generation to a file as RLE
+ *
+ * The header has the board size, so loading the file on a board of the
+ * same size puts every cell back where it was. Runs are found a word at
+ * a time with count-trailing-zeros on a packed copy of each row, dead
+ * runs at the ends of rows are left out and empty rows are merged into
+ * one "n$" item.
+ *
+ * Returns:
+ *   1 on success, 0 after printing what went wrong
+ */
+int savePattern(const char *path) {
+    int words = (width + WORD_BITS - 1) / WORD_BITS;
+    uint64_t *bits = malloc((size_t)words * (size_t)height * sizeof(uint64_t));
+    FILE *file = fopen(path, "w");
+    if (bits == NULL || file == NULL) {
+        fprintf(stderr, "Cannot write %s: %s\n", path, bits == NULL ? "out of memory" : strerror(errno));
+        free(bits);
+        if (file != NULL) {
+            fclose(file);
+        }
+        return 0;
+    }
+    captureFrame(bits, (size_t)words);
+    // Large stdio buffer: the file goes out in big writes
+    setvbuf(file, NULL, _IOFBF, 1 << 20);
+
+    fprintf(file, "#C Written by Conway's Game of Life (reference.c)\n");
+    fprintf(file, "x = %d, y = %d, rule = %s\n", width, height, ruleText);
+
+    int column = 0;
+    long pendingRows = 0;       // Row ends not written yet
+    for (int y = 0; y < height; y++) {
+        const uint64_t *row = bits + (size_t)y * (size_t)words;
+        int x = 0;
+        while (x < width) {
+            // Find the next live cell, then where its run ends
+            int i = x / WORD_BITS;
+            uint64_t word = row[i] & (~UINT64_C(0) << (x % WORD_BITS));
+            while (word == 0 && ++i < words) {
+                word = row[i];
+            }
+            if (word == 0) {
+                break;
+            }
+            int runStart = i * WORD_BITS + __builtin_ctzll(word);
+            word = ~row[i] & (~UINT64_C(0) << (runStart % WORD_BITS));
+            while (word == 0 && ++i < words) {
+                word = ~row[i];
+            }
+            int runEnd = word == 0 ? width : i * WORD_BITS + __builtin_ctzll(word);
+            if (runEnd > width) {
+                runEnd = width;
+            }
+
+            if (pendingRows > 0) {
+                appendRleItem(file, pendingRows, '$', &column);
+                pendingRows = 0;
+            }
+            if (runStart > x) {
+                appendRleItem(file, runStart - x, 'b', &column);
+            }
+            appendRleItem(file, runEnd - runStart, 'o', &column);
+            x = runEnd;
+        }
+        pendingRows++;
+    }
+    appendRleItem(file, 1, '!', &column);
+    fputc('\n', file);
+
+    free(bits);
+    if (fclose(file) != 0) {
+        fprintf(stderr, "Cannot write %s: %s\n", path, strerror(errno));
+        return 0;
+    }
+    return 1;
+}
+
+/*
+ * seedBoard - Fill the next generation from --restore, --pattern, or at random
+ *
+ * Returns:
+ *   1 on success, 0 after printing what went wrong
+ */
+int seedBoard(void) {
+    resetCycles();
+    if (restorePath != NULL) {
+        return restoreCheckpoint();
+    }
+    if (patternPath == NULL) {
+        if (!initializeGrid()) {
+            fprintf(stderr, "Out of memory for the live cells\n");
+            return 0;
+        }
+        return 1;
+    }
+    return loadPattern(&pattern);
+}
+
+// ============================================================================
+// CHECKPOINTS
+// ============================================================================
+
+/*
+ * openCheckpoint - Open a checkpoint file and read its header
+ *
+ * Sets the board size from the header; the board itself is mapped by
+ * restoreCheckpoint() once the grids exist.
+ *
+ * Returns:
+ *   1 on success, 0 after printing what went wrong
+ */
+int openCheckpoint(const char *path) {
+    struct stat info;
+    restoreFd = open(path, O_RDONLY);
+    if (restoreFd < 0 || fstat(restoreFd, &info) != 0
+        || pread(restoreFd, &restoreHeader, sizeof restoreHeader, 0) != (ssize_t)sizeof restoreHeader) {
+        fprintf(stderr, "Cannot read checkpoint %s: %s\n", path, strerror(errno));
+        return 0;
+    }
+    const struct CheckpointHeader *header = &restoreHeader;
+    if (memcmp(header->magic, CHECKPOINT_MAGIC, 8) != 0 || header->version != CHECKPOINT_VERSION
+        || header->headerBytes != CHECKPOINT_HEADER_BYTES
+        || header->width < 1 || header->width > INT32_MAX
+        || header->height < 1 || header->height > INT32_MAX) {
+        fprintf(stderr, "%s is not a checkpoint of this version\n", path);
+        return 0;
+    }
+    if (header->rule != lifeRule) {
+        char text[32];
+        formatRule(text, sizeof text, header->rule, 2);
+        if (ruleGiven || (header->rule & ~UINT32_C(0x01FF01FF)) != 0) {
+            fprintf(stderr, "%s was written for rule %s, not %s\n", path, text, ruleText);
+            return 0;
+        }
+        setRule(header->rule, 2);
+    }
+    uint64_t boardBytes = ((uint64_t)header->height + 2) * header->rowWords * sizeof(uint64_t);
+    if ((uint64_t)info.st_size < header->headerBytes + boardBytes) {
+        fprintf(stderr, "%s is truncated\n", path);
+        return 0;
+    }
+    width = (int)header->width;
+    height = (int)header->height;
+    return 1;
+}
+
+/*
+ * restoreCheckpoint - Make the board of the opened checkpoint the next generation
+ *
+ * A packed board is not read at all: the file is mapped copy-on-write
+ * and the mapping replaces packedNextCells, so resuming costs the same
+ * for any board size. The other storage modes copy the live cells out
+ * of a read-only mapping.
+ *
+ * Returns:
+ *   1 on success, 0 after printing what went wrong
+ */
+int restoreCheckpoint(void) {
+    if (restoreHeader.rowWords != packedStride) {
+        fprintf(stderr, "The checkpoint's rows are %llu words, this build uses %zu\n",
+                (unsigned long long)restoreHeader.rowWords, packedStride);
+        return 0;
+    }
+    size_t bytes = (size_t)(height + 2) * packedStride * sizeof(uint64_t);
+    int packed = storageMode == STORAGE_PACKED;
+    uint64_t *board = mmap(NULL, bytes, packed ? PROT_READ | PROT_WRITE : PROT_READ,
+                           MAP_PRIVATE, restoreFd, (off_t)restoreHeader.headerBytes);
+    close(restoreFd);
+    restoreFd = -1;
+    if (board == MAP_FAILED) {
+        fprintf(stderr, "Cannot map the checkpoint: %s\n", strerror(errno));
+        return 0;
+    }
+
+    if (packed) {
+        free(packedNextCells);
+        packedNextCells = board;
+        mappedGrid = board;
+        mappedGridBytes = bytes;
+    } else {
+        clearNextBoard();
+        int ok = 1;
+        for (int y = 0; ok && y < height; y++) {
+            const uint64_t *row = packedRow(board, y);
+            for (int i = 0; ok && i < wordsPerRow; i++) {
+                for (uint64_t word = row[i]; ok && word != 0; word &= word - 1) {
+                    ok = setNextCell(i * WORD_BITS + __builtin_ctzll(word), y, 1);
+                }
+            }
+        }
+        ok = ok && (storageMode != STORAGE_SPARSE || sortNextLiveCells());
+        munmap(board, bytes);
+        if (!ok) {
+            fprintf(stderr, "Out of memory for the live cells\n");
+            return 0;
+        }
+    }
+
+    startGeneration = restoreHeader.generation;
+    // Nothing is known about the tiles yet
+    markAllTilesChanged();
+    return 1;
+}
+
+/*
+ * writeCheckpointFile - Write checkpointBuffer to --checkpoint
+ *
+ * Writes FILE.tmp, flushes it to disk and renames it over FILE, so FILE
+ * is always either the old checkpoint or the new one.
+ */
+static void writeCheckpointFile(void) {
+    size_t pathLength = strlen(checkpointPath);
+    char *tempPath = malloc(pathLength + 5);
+    if (tempPath == NULL) {
+        fprintf(stderr, "Checkpoint skipped: out of memory\n");
+        return;
+    }
+    memcpy(tempPath, checkpointPath, pathLength);
+    memcpy(tempPath + pathLength, ".tmp", 5);
+
+    int fd = open(tempPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    size_t written = 0;
+    while (fd >= 0 && written < checkpointBytes) {
+        ssize_t count = write(fd, checkpointBuffer + written, checkpointBytes - written);
+        if (count < 0 && errno != EINTR) {
+            break;
+        }
+        written += count > 0 ? (size_t)count : 0;
+    }
+    int ok = fd >= 0 && written == checkpointBytes && fsync(fd) == 0;
+    if (fd >= 0 && close(fd) != 0) {
+        ok = 0;
+    }
+    if (!ok || rename(tempPath, checkpointPath) != 0) {
+        fprintf(stderr, "Checkpoint %s failed: %s\n", checkpointPath, strerror(errno));
+        unlink(tempPath);
+    }
+    free(tempPath);
+}
+
+/*
+ * checkpointWriterMain - Body of the checkpoint writer thread
+ *
+ * Sleeps until a snapshot is handed over, writes it, and marks the
+ * mailbox free again.
+ */
+static void *checkpointWriterMain(void *arg) {
+    (void)arg;
+    traceThread("checkpoint writer");
+    pthread_mutex_lock(&checkpointLock);
+    for (;;) {
+        while (!checkpointBusy && !checkpointQuit) {
+            pthread_cond_wait(&checkpointWake, &checkpointLock);
+        }
+        if (!checkpointBusy) {
+            break;
+        }
+        // The snapshot is ours until checkpointBusy is cleared, so the
+        // file can be written without holding the lock
+        pthread_mutex_unlock(&checkpointLock);
+        uint64_t traceStart = traceBegin();
+        writeCheckpointFile();
+        traceEnd(TRACE_CHECKPOINT, traceStart, -1);
+        pthread_mutex_lock(&checkpointLock);
+        checkpointBusy = 0;
+        pthread_cond_broadcast(&checkpointWake);
+    }
+    pthread_mutex_unlock(&checkpointLock);
+    return NULL;
+}
+
+/*
+ * startCheckpointWriter - Allocate the snapshot buffer and start the writer
+ *
+ * Does nothing without --checkpoint. Must be called after allocateGrids().
+ *
+ * Returns:
+ *   1 on success, 0 if memory or threads ran out
+ */
+int startCheckpointWriter(void) {
+    if (checkpointPath == NULL) {
+        return 1;
+    }
+    checkpointBytes = CHECKPOINT_HEADER_BYTES + (size_t)(height + 2) * packedStride * sizeof(uint64_t);
+    // Page-aligned, so the board part starts on a page like it does in
+    // the file (aligned_alloc wants a whole number of pages)
+    size_t pages = (checkpointBytes + CHECKPOINT_HEADER_BYTES - 1) / CHECKPOINT_HEADER_BYTES;
+    checkpointBuffer = aligned_alloc(CHECKPOINT_HEADER_BYTES, pages * CHECKPOINT_HEADER_BYTES);
+    if (checkpointBuffer == NULL) {
+        return 0;
+    }
+    // The header padding, the ghost rows and the row padding stay zero
+    memset(checkpointBuffer, 0, checkpointBytes);
+
+    checkpointBusy = 0;
+    checkpointQuit = 0;
+    nextCheckpoint = startGeneration + checkpointEvery;
+    if (pthread_create(&checkpointThread, NULL, checkpointWriterMain, NULL) != 0) {
+        free(checkpointBuffer);
+        checkpointBuffer = NULL;
+        return 0;
+    }
+    checkpointWriterRunning = 1;
+    return 1;
+}
+
+/*
+ * takeCheckpoint - Snapshot the current generation for the writer thread
+ *
+ * Called with checkpointLock held and the mailbox free.
+ */
+static void takeCheckpoint(unsigned long long generation) {
+    struct CheckpointHeader header = {0};
+    memcpy(header.magic, CHECKPOINT_MAGIC, 8);
+    header.version = CHECKPOINT_VERSION;
+    header.headerBytes = CHECKPOINT_HEADER_BYTES;
+    header.width = (uint32_t)width;
+    header.height = (uint32_t)height;
+    header.rowWords = packedStride;
+    header.rule = lifeRule;
+    header.generation = generation;
+    memcpy(checkpointBuffer, &header, sizeof header);
+
+    uint64_t *board = (uint64_t *)(checkpointBuffer + CHECKPOINT_HEADER_BYTES);
+    captureFrame(packedRow(board, 0), packedStride);
+
+    checkpointBusy = 1;
+    pthread_cond_broadcast(&checkpointWake);
+}
+
+/*
+ * maybeCheckpoint - Take a checkpoint if one is due
+ *
+ * Called by the simulation after each copyGrid(). It never waits for the
+ * writer: if the previous checkpoint is still being written, it tries
+ * again on the next generation.
+ */
+void maybeCheckpoint(unsigned long long generation) {
+    if (!checkpointWriterRunning || generation < nextCheckpoint) {
+        return;
+    }
+    if (pthread_mutex_trylock(&checkpointLock) != 0) {
+        return;
+    }
+    if (!checkpointBusy) {
+        takeCheckpoint(generation);
+        nextCheckpoint = generation + checkpointEvery;
+    }
+    pthread_mutex_unlock(&checkpointLock);
+}
+
+/*
+ * stopCheckpointWriter - Write a last checkpoint and stop the writer
+ *
+ * Waits for any checkpoint in flight, so the file on disk ends up
+ * holding the final generation.
+ */
+void stopCheckpointWriter(unsigned long long generation) {
+    if (!checkpointWriterRunning) {
+        return;
+    }
+    pthread_mutex_lock(&checkpointLock);
+    while (checkpointBusy) {
+        pthread_cond_wait(&checkpointWake, &checkpointLock);
+    }
+    takeCheckpoint(generation);
+    checkpointQuit = 1;
+    pthread_cond_broadcast(&checkpointWake);
+    pthread_mutex_unlock(&checkpointLock);
+
+    pthread_join(checkpointThread, NULL);
+    checkpointWriterRunning = 0;
+    free(checkpointBuffer);
+    checkpointBuffer = NULL;
+}
+
+// ============================================================================
+// GENERATION DUMPS
+// ============================================================================
+
+/*
+ * dumpWriterMain - Body of the dump writer thread
+ *
+ * Takes every buffer that is ready and writes them all with one
+ * writev(), then hands them back to the simulation.
+ */
+static void *dumpWriterMain(void *arg) {
+    (void)arg;
+    traceThread("dump writer");
+    pthread_mutex_lock(&dumpLock);
+    for (;;) {
+        while (dumpHead == dumpTail && !dumpQuit) {
+            pthread_cond_wait(&dumpWake, &dumpLock);
+        }
+        size_t head = dumpHead;
+        size_t tail = dumpTail;
+        if (head == tail) {
+            break;
+        }
+        pthread_mutex_unlock(&dumpLock);
+
+        // The buffers from tail to head are ours until dumpTail moves
+        struct iovec pieces[DUMP_BUFFERS];
+        int count = 0;
+        for (size_t frame = tail; frame != head; frame++) {
+            pieces[count].iov_base = dumpBuffers[frame % DUMP_BUFFERS];
+            pieces[count].iov_len = dumpLengths[frame % DUMP_BUFFERS];
+            count++;
+        }
+        // writev() may stop part way; go on from where it stopped
+        uint64_t traceStart = traceBegin();
+        struct iovec *piece = pieces;
+        while (!dumpFailed && count > 0) {
+            ssize_t written = writev(dumpFd, piece, count);
+            if (written < 0) {
+                if (errno != EINTR) {
+                    fprintf(stderr, "Writing %s failed: %s\n", dumpPath, strerror(errno));
+                    dumpFailed = 1;
+                }
+                continue;
+            }
+            while (count > 0 && (size_t)written >= piece->iov_len) {
+                written -= (ssize_t)piece->iov_len;
+                piece++;
+                count--;
+            }
+            if (count > 0) {
+                piece->iov_base = (char *)piece->iov_base + written;
+                piece->iov_len -= (size_t)written;
+            }
+        }
+        traceEnd(TRACE_DUMP, traceStart, -1);
+
+        pthread_mutex_lock(&dumpLock);
+        dumpTail = head;
+    }
+    pthread_mutex_unlock(&dumpLock);
+    return NULL;
+}
+
+/*
+ * startDumpWriter - Open --dump, allocate the buffers and start the writer
+ *
+ * Does nothing without --dump.
+ *
+ * Returns:
+ *   1 on success, 0 after printing what went wrong
+ */
+int startDumpWriter(void) {
+    if (dumpPath == NULL) {
+        return 1;
+    }
+    size_t words = (size_t)(width + WORD_BITS - 1) / WORD_BITS;
+    if (dumpFormat == DUMP_PBM) {
+        // Header: "P4\n# generation N\nW H\n", at most about 60 bytes
+        dumpCapacity = 64 + (size_t)height * (((size_t)width + 7) / 8);
+        dumpScratch = malloc(words * (size_t)height * sizeof(uint64_t));
+    } else {
+        dumpCapacity = sizeof(uint64_t) + words * (size_t)height * sizeof(uint64_t);
+    }
+    int ok = dumpFormat != DUMP_PBM || dumpScratch != NULL;
+    for (int i = 0; i < DUMP_BUFFERS; i++) {
+        dumpBuffers[i] = ok ? malloc(dumpCapacity) : NULL;
+        ok = ok && dumpBuffers[i] != NULL;
+    }
+    dumpFd = ok ? open(dumpPath, O_WRONLY | O_CREAT | O_TRUNC, 0644) : -1;
+
+    dumpHead = dumpTail = 0;
+    dumpQuit = 0;
+    dumpFailed = 0;
+    dumpRetries = 0;
+    nextDump = startGeneration;
+    if (dumpFd < 0 || pthread_create(&dumpThread, NULL, dumpWriterMain, NULL) != 0) {
+        fprintf(stderr, "Cannot start dumping to %s: %s\n", dumpPath,
+                ok ? strerror(errno) : "out of memory");
+        if (dumpFd >= 0) {
+            close(dumpFd);
+            dumpFd = -1;
+        }
+        for (int i = 0; i < DUMP_BUFFERS; i++) {
+            free(dumpBuffers[i]);
+            dumpBuffers[i] = NULL;
+        }
+        free(dumpScratch);
+        dumpScratch = NULL;
+        return 0;
+    }
+    dumpWriterRunning = 1;
+    return 1;
+}
+
+/*
+ * encodeDump - Encode the current generation into a dump buffer
+ *
+ * Returns:
+ *   The number of bytes written to out
+ */
+static size_t encodeDump(unsigned char *out, unsigned long long generation) {
+    size_t words = (size_t)(width + WORD_BITS - 1) / WORD_BITS;
+    if (dumpFormat == DUMP_RAW) {
+        // Host byte order, like the checkpoint files
+        memcpy(out, &generation, sizeof(uint64_t));
+        captureFrame((uint64_t *)(out + sizeof(uint64_t)), words);
+        return sizeof(uint64_t) + words * (size_t)height * sizeof(uint64_t);
+    }
+
+    // PBM stores 8 cells per byte, leftmost cell in the high bit, with 1
+    // meaning black (alive)
+    size_t length = (size_t)snprintf((char *)out, 64, "P4\n# generation %llu\n%d %d\n",
+                                     generation, width, height);
+    size_t rowBytes = ((size_t)width + 7) / 8;
+    captureFrame(dumpScratch, words);
+    for (int y = 0; y < height; y++) {
+        const uint64_t *row = dumpScratch + (size_t)y * words;
+        unsigned char *bytes = out + length + (size_t)y * rowBytes;
+        for (size_t i = 0; i < words; i++) {
+            // Mirror the bits inside each byte; the bytes themselves are
+            // already in order in a little-endian word
+            uint64_t word = row[i];
+            word = ((word >> 1) & UINT64_C(0x5555555555555555)) | ((word & UINT64_C(0x5555555555555555)) << 1);
+            word = ((word >> 2) & UINT64_C(0x3333333333333333)) | ((word & UINT64_C(0x3333333333333333)) << 2);
+            word = ((word >> 4) & UINT64_C(0x0F0F0F0F0F0F0F0F)) | ((word & UINT64_C(0x0F0F0F0F0F0F0F0F)) << 4);
+            size_t byteCount = rowBytes - i * 8 < 8 ? rowBytes - i * 8 : 8;
+            for (size_t b = 0; b < byteCount; b++) {
+                bytes[i * 8 + b] = (unsigned char)(word >> (8 * b));
+            }
+        }
+    }
+    return length + (size_t)height * rowBytes;
+}
+
+/*
+ * maybeDump - Dump the current generation if a dump is due
+ *
+ * Called by the simulation after each copyGrid(). Encoding happens on
+ * this thread, into a buffer the writer is not using; only the hand-over
+ * takes the lock, and the writer never holds it while writing.
+ */
+void maybeDump(unsigned long long generation) {
+    if (!dumpWriterRunning || generation < nextDump) {
+        return;
+    }
+    pthread_mutex_lock(&dumpLock);
+    size_t head = dumpHead;
+    int full = head - dumpTail == DUMP_BUFFERS;
+    pthread_mutex_unlock(&dumpLock);
+    if (full) {
+        dumpRetries++;
+        return;
+    }
+
+    dumpLengths[head % DUMP_BUFFERS] = encodeDump(dumpBuffers[head % DUMP_BUFFERS], generation);
+    nextDump = generation + dumpEvery;
+
+    pthread_mutex_lock(&dumpLock);
+    dumpHead = head + 1;
+    pthread_cond_signal(&dumpWake);
+    pthread_mutex_unlock(&dumpLock);
+}
+
+/*
+ * stopDumpWriter - Write out the remaining dumps and stop the writer
+ */
+void stopDumpWriter(void) {
+    if (!dumpWriterRunning) {
+        return;
+    }
+    pthread_mutex_lock(&dumpLock);
+    dumpQuit = 1;
+    pthread_cond_signal(&dumpWake);
+    pthread_mutex_unlock(&dumpLock);
+    pthread_join(dumpThread, NULL);
+    dumpWriterRunning = 0;
+
+    if (close(dumpFd) != 0 && !dumpFailed) {
+        fprintf(stderr, "Writing %s failed: %s\n", dumpPath, strerror(errno));
+    }
+    dumpFd = -1;
+    if (dumpRetries > 0) {
+        fprintf(stderr, "Dumps were delayed %llu times waiting for the disk\n", dumpRetries);
+    }
+    for (int i = 0; i < DUMP_BUFFERS; i++) {
+        free(dumpBuffers[i]);
+        dumpBuffers[i] = NULL;
+    }
+    free(dumpScratch);
+    dumpScratch = NULL;
+}
+
+// ============================================================================
+// CYCLE DETECTION
+// ============================================================================
+
+/*
+ * resetCycles - Forget the generations hashed so far
+ *
+ * Called when a new board is seeded. The first generation hashed after
+ * this hashes every tile.
+ */
+void resetCycles(void) {
+    cycleObservations = 0;
+    cycleCandidate = 0;
+    atomic_store(&cyclePeriod, 0);
+    cycleJumpFrom = cycleJumpTo = 0;
+    tileHashSum = 0;
+    if (tileHashes != NULL) {
+        memset(tileHashes, 0, sizeof(uint64_t) * (size_t)numTiles);
+    }
+}
+
+/*
+ * mixHash - Scramble a 64-bit value so every input bit reaches every output bit
+ *
+ * The finalizer of SplitMix64.
+ */
+static inline uint64_t mixHash(uint64_t x) {
+    x = (x ^ (x >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+    x = (x ^ (x >> 27)) * UINT64_C(0x94d049bb133111eb);
+    return x ^ (x >> 31);
+}
+
+/*
+ * hashBytes - Fold a run of bytes into four hash lanes
+ *
+ * One multiply chain would wait on itself for every word; four
+ * independent lanes keep the multiplier busy.
+ */
+static inline void hashBytes(uint64_t lanes[4], const void *data, size_t length) {
+    const unsigned char *bytes = data;
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        for (int lane = 0; lane < 4; lane++) {
+            uint64_t word;
+            memcpy(&word, bytes + i + 8 * lane, 8);
+            lanes[lane] = (lanes[lane] ^ word) * UINT64_C(0x9e3779b97f4a7c15);
+            lanes[lane] ^= lanes[lane] >> 32;
+        }
+    }
+    // The last partial block, zero-padded, goes into lane 0
+    for (; i < length; i += 8) {
+        uint64_t word = 0;
+        memcpy(&word, bytes + i, length - i < 8 ? length - i : 8);
+        lanes[0] = (lanes[0] ^ word) * UINT64_C(0x9e3779b97f4a7c15);
+        lanes[0] ^= lanes[0] >> 32;
+    }
+}
+
+/*
+ * packCharCells - Up to 64 char cells as one word, cell x in bit x
+ *
+ * A cell's state is bit 0 of its char (ALIVE is odd, DEAD even). On x86
+ * SSE2 movemask gathers 16 of those bits per instruction; elsewhere eight
+ * loads of eight chars are masked and shifted into place.
+ */
+#ifdef HAVE_X86_SIMD
+__attribute__((target("sse2")))
+static uint64_t packCharCellsSse2(const char *row) {
+    uint64_t word = 0;
+    for (int i = 0; i < 4; i++) {
+        __m128i chars = _mm_loadu_si128((const __m128i *)(row + 16 * i));
+        // Bit 0 moves up to bit 7, where movemask picks it up
+        word |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_slli_epi16(chars, 7)) << (16 * i);
+    }
+    return word;
+}
+#endif
+
+static inline uint64_t packCharCells(const char *row, int count) {
+    char chars[WORD_BITS];
+    if (count < WORD_BITS) {
+        memset(chars, DEAD, sizeof chars);
+        memcpy(chars, row, (size_t)count);
+        row = chars;
+    }
+#ifdef HAVE_X86_SIMD
+    return packCharCellsSse2(row);
+#else
+    uint64_t word = 0;
+    for (int b = 0; b < 8; b++) {
+        uint64_t eight;
+        memcpy(&eight, row + 8 * b, 8);
+        word |= (eight & UINT64_C(0x0101010101010101)) << b;
+    }
+    return word;
+#endif
+}
+
+/*
+ * hashTile - 64-bit hash of one tile of the current or the next generation
+ *
+ * The tile number goes into the hash too, so the same contents in two
+ * different tiles do not cancel out in the XOR of all tiles.
+ *
+ * Parameters:
+ *   tile - Tile to hash
+ *   next - Hash nextCells rather than cells
+ */
+uint64_t hashTile(int tile, int next) {
+    int xBegin, yBegin, xEnd, yEnd;
+    tileBounds(tile, &xBegin, &yBegin, &xEnd, &yEnd);
+    uint64_t lanes[4];
+    for (int i = 0; i < 4; i++) {
+        lanes[i] = mixHash((uint64_t)tile * 4 + (uint64_t)i + 1);
+    }
+
+    for (int y = yBegin; y < yEnd; y++) {
+        if (storageMode == STORAGE_PACKED) {
+            int firstWord = xBegin / WORD_BITS;
+            int lastWord = (xEnd + WORD_BITS - 1) / WORD_BITS;
+            hashBytes(lanes, packedRow(next ? packedNextCells : packedCells, y) + firstWord,
+                      sizeof(uint64_t) * (size_t)(lastWord - firstWord));
+        } else {
+            const char *row = cellRow(next ? nextCells : cells, y);
+            uint64_t words[TILE_WIDTH / WORD_BITS];
+            int count = 0;
+            for (int x = xBegin; x < xEnd; x += WORD_BITS) {
+                words[count++] = packCharCells(row + x, xEnd - x);
+            }
+            hashBytes(lanes, words, sizeof(uint64_t) * (size_t)count);
+        }
+    }
+    return mixHash(lanes[0] ^ mixHash(lanes[1] ^ mixHash(lanes[2] ^ mixHash(lanes[3]))));
+}
+
+/*
+ * planeHash - 64-bit hash of the whole unbounded plane
+ *
+ * The chunked plane reaches past the board, so boardChecksum() would miss
+ * a glider that has flown off. Every chunk with live cells is hashed with
+ * its coordinates and the hashes are XORed, which does not depend on
+ * where the chunks happen to sit in the map.
+ */
+static uint64_t planeHash(void) {
+    uint64_t hash = 0;
+    for (size_t slot = 0; slot < chunkMapCapacity; slot++) {
+        const struct Chunk *chunk = chunkMap[slot];
+        if (chunk == NULL) {
+            continue;
+        }
+        uint64_t lanes[4];
+        uint64_t live = 0;
+        for (int i = 0; i < 4; i++) {
+            lanes[i] = mixHash(((uint64_t)(uint32_t)chunk->cx << 32 | (uint32_t)chunk->cy) + (uint64_t)i);
+        }
+        for (int y = 0; y < CHUNK_SIZE; y++) {
+            live |= chunk->rows[chunkCurrent][y];
+        }
+        if (live != 0) {
+            hashBytes(lanes, chunk->rows[chunkCurrent], sizeof chunk->rows[chunkCurrent]);
+            hash ^= mixHash(lanes[0] ^ mixHash(lanes[1] ^ mixHash(lanes[2] ^ mixHash(lanes[3]))));
+        }
+    }
+    return hash;
+}
+
+/*
+ * generationHash - 64-bit hash of the current generation
+ *
+ * When generations are stepped tile by tile, stepTile has already hashed
+ * the tiles that changed (those flagged in tileChanged) and only their
+ * hashes are swapped into the sum; the others keep the hash they had.
+ * The first generation, and boards stepped in bands or with --temporal,
+ * hash every tile here. The sparse engine has no tiles and hashes the
+ * whole board with boardChecksum(); the chunked one uses planeHash().
+ */
+static uint64_t generationHash(void) {
+    if (storageMode == STORAGE_CHUNKED) {
+        return planeHash();
+    }
+    if (tileHashes == NULL) {
+        return boardChecksum();
+    }
+    int everyTile = !usingTiles() || cycleObservations == 0;
+    for (int tile = 0; tile < numTiles; tile++) {
+        if (everyTile || tileChanged[tile]) {
+            uint64_t hash = everyTile ? hashTile(tile, 0) : tileHashesNext[tile];
+            tileHashSum ^= tileHashes[tile] ^ hash;
+            tileHashes[tile] = hash;
+        }
+    }
+    return tileHashSum;
+}
+
+/*
+ * watchForCycles - Hash the current generation and look for a cycle
+ *
+ * A hash that matches the one p generations back makes p a candidate
+ * period; it is confirmed once p more generations have matched too,
+ * which rules out a chance collision of two hashes. The cycle is then
+ * traced back through the ring to the first generation in it. With
+ * --temporal K only every K-th generation is seen, so the period found
+ * is a multiple of K.
+ *
+ * Parameters:
+ *   generation - Generation of the current board
+ *   target     - Generation to jump towards with --cycles jump
+ *
+ * Returns:
+ *   The generation the current board stands for: generation itself, or
+ *   the last generation before target in the same phase of the cycle
+ *   if whole periods were just skipped
+ */
+unsigned long long watchForCycles(unsigned long long generation, unsigned long long target) {
+    if (atomic_load_explicit(&cyclePeriod, memory_order_relaxed) > 0) {
+        return generation;      // Nothing more to learn
+    }
+
+    uint64_t hash = generationHash();
+    unsigned long long n = cycleObservations++;
+    cycleHistory[n % CYCLE_HISTORY].generation = generation;
+    cycleHistory[n % CYCLE_HISTORY].hash = hash;
+
+    // A candidate must keep matching, or we look for a new one
+    if (cycleCandidate > 0 && cycleHistory[(n - cycleCandidate) % CYCLE_HISTORY].hash != hash) {
+        cycleCandidate = 0;
+    }
+    if (cycleCandidate == 0) {
+        unsigned long long longest = n < CYCLE_HISTORY - 1 ? n : CYCLE_HISTORY - 1;
+        for (unsigned long long p = 1; p <= longest; p++) {
+            if (cycleHistory[(n - p) % CYCLE_HISTORY].hash == hash) {
+                cycleCandidate = (int)p;
+                candidateSince = n;
+                break;
+            }
+        }
+        return generation;
+    }
+    if (n - candidateSince < (unsigned long long)cycleCandidate) {
+        return generation;
+    }
+
+    // Confirmed. Walk back to the first generation that the one a
+    // period later repeats, as far as the ring remembers
+    unsigned long long p = (unsigned long long)cycleCandidate;
+    unsigned long long oldest = n >= CYCLE_HISTORY - 1 ? n - (CYCLE_HISTORY - 1) : 0;
+    unsigned long long first = candidateSince - p;
+    while (first > oldest && cycleHistory[(first - 1) % CYCLE_HISTORY].hash
+                             == cycleHistory[(first - 1 + p) % CYCLE_HISTORY].hash) {
+        first--;
+    }
+    unsigned long long period = generation - cycleHistory[(n - p) % CYCLE_HISTORY].generation;
+    cycleStart = cycleHistory[first % CYCLE_HISTORY].generation;
+    if (cycleMode == CYCLES_JUMP && target > generation) {
+        cycleJumpFrom = generation;
+        cycleJumpTo = generation + (target - generation) / period * period;
+        generation = cycleJumpTo;
+    }
+    // Release: the details are written before the renderer can see the period
+    atomic_store_explicit(&cyclePeriod, (int)period, memory_order_release);
+    return generation;
+}
+
+/*
+ * describeCycle - One line about the cycle found, for the status line and reports
+ *
+ * Returns:
+ *   1 if a cycle has been found and text holds its description, 0 if not
+ */
+int describeCycle(char *text, size_t size) {
+    int period = atomic_load_explicit(&cyclePeriod, memory_order_acquire);
+    if (period == 0) {
+        return 0;
+    }
+    int length;
+    if (period == 1) {
+        length = snprintf(text, size, "Still life since generation %llu", cycleStart);
+    } else {
+        length = snprintf(text, size, "Period-%d cycle since generation %llu", period, cycleStart);
+    }
+    if (cycleJumpTo > cycleJumpFrom && length >= 0 && (size_t)length < size) {
+        snprintf(text + length, size - (size_t)length, ", jumped from %llu to %llu",
+                 cycleJumpFrom, cycleJumpTo);
+    }
+    return 1;
+}
+
+// ============================================================================
+// STATISTICS
+// ============================================================================
+
+/*
+ * gatherStats - Add up the stats the kernels left for the last step
+ *
+ * With tiles every tile counts with the numbers of the last time it was
+ * stepped: a skipped tile still holds the same cells. Only the tiles
+ * stepped this time can have changed cells. Otherwise each thread left
+ * the numbers of its band.
+ */
+void gatherStats(void) {
+    struct RegionStats total = EMPTY_REGION;
+
+    if (usingTiles()) {
+        for (int tile = 0; tile < numTiles; tile++) {
+            mergeRegionStats(&total, &tileStats[tile]);
+        }
+        total.changed = 0;
+        for (int i = 0; i < numActiveTiles; i++) {
+            total.changed += tileStats[activeTiles[i]].changed;
+        }
+    } else {
+        for (int worker = 0; worker < numThreads; worker++) {
+            mergeRegionStats(&total, &workerStats[worker]);
+        }
+    }
+    stepStats = total;
+    stepStatsValid = 1;
+}
+
+/*
+ * measureBoard - Population and box of the current board, the slow way
+ *
+ * Only used for the first record, before any step has counted anything.
+ */
+static struct RegionStats measureBoard(void) {
+    struct RegionStats stats = EMPTY_REGION;
+
+    if (storageMode == STORAGE_CHUNKED) {
+        for (size_t slot = 0; slot < chunkMapCapacity; slot++) {
+            const struct Chunk *chunk = chunkMap != NULL ? chunkMap[slot] : NULL;
+            if (chunk == NULL) {
+                continue;
+            }
+            for (int r = 0; r < CHUNK_SIZE; r++) {
+                uint64_t word = chunk->rows[chunkCurrent][r];
+                if (word != 0) {
+                    stats.population += __builtin_popcountll(word);
+                    growBoxWords(&stats, &word, 1, (long long)chunk->cx * CHUNK_SIZE,
+                                 (long long)chunk->cy * CHUNK_SIZE + r);
+                }
+            }
+        }
+        return stats;
+    }
+
+    size_t live = 0;    // Next live cell of a sparse board
+    for (int y = 0; y < height; y++) {
+        long long rowStart = stats.population;
+        if (storageMode == STORAGE_SPARSE) {
+            uint64_t end = cellKey(0, y + 1);
+            for (; live < numLiveCells && liveCells[live] < end; live++) {
+                long long x = (long long)(liveCells[live] % (uint64_t)width);
+                stats.xMin = x < stats.xMin ? x : stats.xMin;
+                stats.xMax = x > stats.xMax ? x : stats.xMax;
+                stats.population++;
+            }
+            if (stats.population > rowStart) {
+                growBoxRow(&stats, y);
+            }
+        } else if (storageMode == STORAGE_PACKED) {
+            const uint64_t *row = packedRow(packedCells, y);
+            for (int i = 0; i < wordsPerRow; i++) {
+                stats.population += __builtin_popcountll(row[i]);
+            }
+            if (stats.population > rowStart) {
+                growBoxWords(&stats, row, wordsPerRow, 0, y);
+            }
+        } else {
+            const char *row = cellRow(cells, y);
+            for (int x = 0; x < width; x++) {
+                stats.population += row[x] == ALIVE;
+            }
+            if (stats.population > rowStart) {
+                growBoxChars(&stats, row, 0, width, y);
+            }
+        }
+    }
+    return stats;
+}
+
+/*
+ * openStats - Create the --stats file and write the CSV header
+ *
+ * The file gets a large stdio buffer: a record is only a few dozen
+ * bytes, so the disk is written once every few thousand generations.
+ *
+ * Returns:
+ *   1 on success (or without --stats), 0 if the file could not be created
+ */
+int openStats(void) {
+    stepStatsValid = 0;
+    if (statsPath == NULL) {
+        return 1;
+    }
+    statsFile = fopen(statsPath, statsFormat == STATS_BINARY ? "wb" : "w");
+    if (statsFile == NULL) {
+        fprintf(stderr, "Could not create %s: %s\n", statsPath, strerror(errno));
+        return 0;
+    }
+    setvbuf(statsFile, NULL, _IOFBF, 1 << 20);
+    statsFailed = 0;
+    if (statsFormat == STATS_CSV) {
+        fprintf(statsFile, "generation,population,births,deaths,min_x,min_y,max_x,max_y\n");
+    }
+    return 1;
+}
+
+/*
+ * recordStats - Append the record of the current generation to the --stats file
+ *
+ * The numbers come from the step that made the current board. Births
+ * and deaths are counted against the previous record: with --temporal K
+ * that is K generations back.
+ *
+ * Parameters:
+ *   generation - Generation of the current board
+ */
+void recordStats(unsigned long long generation) {
+    if (statsFile == NULL || statsFailed) {
+        return;
+    }
+
+    struct StatsRecord record = { .generation = generation };
+    struct RegionStats stats;
+    if (stepStatsValid) {
+        stats = stepStats;
+        // changed = births + deaths, and births - deaths = the growth
+        long long growth = stats.population - statsPopulation;
+        record.births = (stats.changed + growth) / 2;
+        record.deaths = (stats.changed - growth) / 2;
+    } else {
+        stats = measureBoard();
+    }
+    statsPopulation = stats.population;
+    record.population = stats.population;
+    if (stats.population > 0) {
+        record.xMin = stats.xMin;
+        record.yMin = stats.yMin;
+        record.xMax = stats.xMax;
+        record.yMax = stats.yMax;
+    } else {
+        record.xMax = record.yMax = -1;
+    }
+
+    int ok;
+    if (statsFormat == STATS_BINARY) {
+        ok = fwrite(&record, sizeof record, 1, statsFile) == 1;
+    } else if (stats.population > 0) {
+        ok = fprintf(statsFile, "%llu,%lld,%lld,%lld,%lld,%lld,%lld,%lld\n", generation,
+                     (long long)record.population, (long long)record.births, (long long)record.deaths,
+                     (long long)record.xMin, (long long)record.yMin,
+                     (long long)record.xMax, (long long)record.yMax) > 0;
+    } else {
+        // No live cells, no box
+        ok = fprintf(statsFile, "%llu,0,%lld,%lld,,,,\n", generation,
+                     (long long)record.births, (long long)record.deaths) > 0;
+    }
+    if (!ok) {
+        fprintf(stderr, "Writing %s failed: %s\n", statsPath, strerror(errno));
+        statsFailed = 1;
+    }
+}
+
+/*
+ * closeStats - Flush and close the --stats file
+ */
+void closeStats(void) {
+    if (statsFile == NULL) {
+        return;
+    }
+    if (fclose(statsFile) != 0 && !statsFailed) {
+        fprintf(stderr, "Writing %s failed: %s\n", statsPath, strerror(errno));
+    }
+    statsFile = NULL;
+}
+
+// ============================================================================
+// TRACING
+// ============================================================================
+
+// Names in the trace and the histograms, and what the event argument is
+static const struct {
+    const char *name;
+    const char *arg;        // NULL: the event has no argument
+} tracePhases[NUM_TRACE_PHASES] = {
+    [TRACE_STEP] = { "calculateNextGeneration", NULL },
+    [TRACE_TILE] = { "stepTile", "tile" },
+    [TRACE_BAND] = { "stepBand", "worker" },
+    [TRACE_WAIT] = { "waitForWorkers", "worker" },
+    [TRACE_COPY] = { "copyGrid", NULL },
+    [TRACE_CLEAR] = { "clearScreen", NULL },
+    [TRACE_PRINT] = { "printGrid", NULL },
+    [TRACE_DRAW] = { "drawFrame", NULL },
+    [TRACE_CHECKPOINT] = { "writeCheckpoint", NULL },
+    [TRACE_DUMP] = { "writeDump", NULL },
+    [TRACE_SOUP] = { "runSoup", "soup" },
+};
+
+/*
+ * traceClock - Nanoseconds on CLOCK_MONOTONIC
+ */
+static inline uint64_t traceClock(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+/*
+ * traceBegin - Start timing a phase
+ *
+ * Pass the result to traceEnd when the phase is over:
+ *
+ *   uint64_t traceStart = traceBegin();
+ *   copyGrid();
+ *   traceEnd(TRACE_COPY, traceStart, -1);
+ *
+ * Returns:
+ *   The start time, or 0 while tracing is off (traceEnd then does nothing)
+ */
+uint64_t traceBegin(void) {
+    return atomic_load_explicit(&tracing, memory_order_relaxed) ? traceClock() : 0;
+}
+
+/*
+ * openTrace - Set up tracing for --trace and --histograms
+ *
+ * Makes room for a buffer per thread - the workers, the simulation and
+ * the writer threads - registers the calling thread as "main" and lets
+ * SIGUSR1 switch the timers on and off. Must run before any of the other
+ * threads start. Does nothing without --trace or --histograms.
+ *
+ * Returns:
+ *   1 on success, 0 if memory ran out
+ */
+int openTrace(void) {
+    if (tracePath == NULL && !showHistograms) {
+        return 1;
+    }
+    traceCapacity = numThreads + 4;
+    traceBuffers = calloc((size_t)traceCapacity, sizeof(struct TraceBuffer *));
+    if (traceBuffers == NULL) {
+        fprintf(stderr, "Not enough memory for tracing\n");
+        return 0;
+    }
+    traceOrigin = traceClock();
+    traceThread("main");
+    signal(SIGUSR1, toggleTracing);
+    atomic_store(&tracing, !tracePaused);
+    return 1;
+}
+
+/*
+ * traceThread - Give the calling thread a trace buffer
+ *
+ * Called once at the start of every thread. A thread that finds no
+ * buffer (no tracing, or out of memory) is simply not timed.
+ *
+ * Parameters:
+ *   name - How the thread is labeled in the trace
+ */
+void traceThread(const char *name) {
+    if (traceBuffers == NULL) {
+        return;
+    }
+    int slot = atomic_fetch_add(&numTraceBuffers, 1);
+    if (slot >= traceCapacity) {
+        return;
+    }
+    struct TraceBuffer *buffer = calloc(1, sizeof(struct TraceBuffer));
+    if (buffer == NULL) {
+        return;
+    }
+    snprintf(buffer->name, sizeof buffer->name, "%s", name);
+    traceBuffers[slot] = buffer;
+    threadTrace = buffer;
+}
+
+/*
+ * traceEnd - Record a phase started with traceBegin
+ *
+ * Only the calling thread writes its buffer. The histograms count every
+ * event; the event itself is kept while the buffer has room.
+ *
+ * Parameters:
+ *   phase - Which phase ended
+ *   start - What traceBegin returned
+ *   arg   - Tile or worker number for the trace, -1 for none
+ */
+void traceEnd(enum TracePhase phase, uint64_t start, int arg) {
+    struct TraceBuffer *buffer = threadTrace;
+    if (start == 0 || buffer == NULL) {
+        return;
+    }
+    uint64_t end = traceClock();
+    uint64_t nanos = end - start;
+
+    int bucket = 63 - __builtin_clzll(nanos | 1);
+    buffer->histogram[phase][bucket < TRACE_BUCKETS ? bucket : TRACE_BUCKETS - 1]++;
+    buffer->totalNanos[phase] += nanos;
+    if (nanos > buffer->longestNanos[phase]) {
+        buffer->longestNanos[phase] = nanos;
+    }
+
+    size_t count = atomic_load_explicit(&buffer->count, memory_order_relaxed);
+    if (count == TRACE_EVENTS) {
+        buffer->dropped++;
+        return;
+    }
+    buffer->events[count] = (struct TraceEvent){ start, end, (int32_t)phase, arg };
+    atomic_store_explicit(&buffer->count, count + 1, memory_order_release);
+}
+
+/*
+ * toggleTracing - SIGUSR1 handler: switch the timers on or off
+ *
+ * Parameters:
+ *   signal - The signal number (unused)
+ */
+void toggleTracing(int signal) {
+    (void)signal;
+    if (traceBuffers != NULL) {
+        atomic_fetch_xor(&tracing, 1);
+    }
+}
+
+/*
+ * writeTrace - Write every recorded event as Chrome trace JSON
+ *
+ * The file loads in chrome://tracing or Perfetto: one row per thread,
+ * one bar per phase. Times are microseconds since openTrace.
+ *
+ * Returns:
+ *   1 on success, 0 if the file could not be written
+ */
+static int writeTrace(const char *path) {
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        fprintf(stderr, "Could not create %s: %s\n", path, strerror(errno));
+        return 0;
+    }
+    setvbuf(file, NULL, _IOFBF, 1 << 20);
+
+    int threads = atomic_load(&numTraceBuffers);
+    threads = threads < traceCapacity ? threads : traceCapacity;
+    const char *separator = "";
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    for (int tid = 0; tid < threads; tid++) {
+        const struct TraceBuffer *buffer = traceBuffers[tid];
+        if (buffer == NULL) {
+            continue;
+        }
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                      "\"args\":{\"name\":\"%s\"}}",
+                separator, tid, buffer->name);
+        separator = ",\n";
+
+        size_t count = atomic_load_explicit(&buffer->count, memory_order_acquire);
+        for (size_t i = 0; i < count; i++) {
+            const struct TraceEvent *event = &buffer->events[i];
+            const char *arg = tracePhases[event->phase].arg;
+            fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+                    tracePhases[event->phase].name, tid,
+                    (double)(event->start - traceOrigin) / 1e3, (double)(event->end - event->start) / 1e3);
+            if (arg != NULL && event->arg >= 0) {
+                fprintf(file, ",\"args\":{\"%s\":%d}", arg, event->arg);
+            }
+            fputc('}', file);
+        }
+        if (buffer->dropped > 0) {
+            fprintf(stderr, "%s: trace buffer full, %zu events of thread %s left out\n",
+                    path, buffer->dropped, buffer->name);
+        }
+    }
+    fprintf(file, "\n]}\n");
+
+    int failed = ferror(file);
+    if (fclose(file) != 0 || failed) {
+        fprintf(stderr, "Writing %s failed\n", path);
+        return 0;
+    }
+    return 1;
+}
+
+/*
+ * formatNanos - Write a duration with a unit that fits it
+ */
+static void formatNanos(char *text, size_t size, double nanos) {
+    if (nanos < 1e3) {
+        snprintf(text, size, "%.0f ns", nanos);
+    } else if (nanos < 1e6) {
+        snprintf(text, size, "%.1f us", nanos / 1e3);
+    } else if (nanos < 1e9) {
+        snprintf(text, size, "%.1f ms", nanos / 1e6);
+    } else {
+        snprintf(text, size, "%.2f s", nanos / 1e9);
+    }
+}
+
+/*
+ * printHistograms - Print a latency histogram of every phase that ran
+ *
+ * All threads are added up. Each bar is one power-of-two range of
+ * durations.
+ */
+static void printHistograms(void) {
+    int threads = atomic_load(&numTraceBuffers);
+    threads = threads < traceCapacity ? threads : traceCapacity;
+
+    printf("\nPhase timings\n");
+    for (int phase = 0; phase < NUM_TRACE_PHASES; phase++) {
+        uint64_t histogram[TRACE_BUCKETS] = { 0 };
+        uint64_t calls = 0, total = 0, longest = 0;
+        for (int tid = 0; tid < threads; tid++) {
+            const struct TraceBuffer *buffer = traceBuffers[tid];
+            if (buffer == NULL) {
+                continue;
+            }
+            for (int b = 0; b < TRACE_BUCKETS; b++) {
+                histogram[b] += buffer->histogram[phase][b];
+                calls += buffer->histogram[phase][b];
+            }
+            total += buffer->totalNanos[phase];
+            longest = buffer->longestNanos[phase] > longest ? buffer->longestNanos[phase] : longest;
+        }
+        if (calls == 0) {
+            continue;
+        }
+
+        char mean[16], most[16];
+        formatNanos(mean, sizeof mean, (double)total / (double)calls);
+        formatNanos(most, sizeof most, (double)longest);
+        printf("%s: %llu calls, mean %s, max %s\n", tracePhases[phase].name,
+               (unsigned long long)calls, mean, most);
+
+        uint64_t tallest = 0;
+        for (int b = 0; b < TRACE_BUCKETS; b++) {
+            tallest = histogram[b] > tallest ? histogram[b] : tallest;
+        }
+        for (int b = 0; b < TRACE_BUCKETS; b++) {
+            if (histogram[b] == 0) {
+                continue;
+            }
+            char low[16], high[16];
+            formatNanos(low, sizeof low, (double)(UINT64_C(1) << b));
+            formatNanos(high, sizeof high, (double)(UINT64_C(1) << (b + 1)));
+            int bar = (int)((histogram[b] * 40 + tallest - 1) / tallest);
+            printf("  %9s - %-9s %-40.*s %llu\n", low, high, bar,
+                   "########################################", (unsigned long long)histogram[b]);
+        }
+    }
+}
+
+/*
+ * finishTrace - Write --trace, print --histograms and free the buffers
+ *
+ * Call once every other thread has stopped.
+ *
+ * Returns:
+ *   1 on success, 0 if the trace file could not be written
+ */
+int finishTrace(void) {
+    if (traceBuffers == NULL) {
+        return 1;
+    }
+    atomic_store(&tracing, 0);
+    signal(SIGUSR1, SIG_IGN);
+
+    int ok = tracePath == NULL || writeTrace(tracePath);
+    if (showHistograms) {
+        printHistograms();
+    }
+
+    int threads = atomic_load(&numTraceBuffers);
+    for (int tid = 0; tid < threads && tid < traceCapacity; tid++) {
+        free(traceBuffers[tid]);
+    }
+    free(traceBuffers);
+    traceBuffers = NULL;
+    threadTrace = NULL;
+    atomic_store(&numTraceBuffers, 0);
+    return ok;
+}
+
+// ============================================================================
+// RULES
+// ============================================================================
+
+/*
+ * parseRule - Read a rulestring
+ *
+ * Understands the usual notations, in any letter case:
+ *   B36/S23     birth on 3 or 6 neighbors, survival on 2 or 3 (HighLife)
+ *   23/36       the same in the older S/B order
+ *   B2/S/C3     a Generations rule with 3 states (Brian's Brain)
+ *   /2/3        the same in the S/B/C order
+ * G may stand in for C.
+ *
+ * Parameters:
+ *   text   - The rulestring, not necessarily NUL-terminated
+ *   length - Its length
+ *   rule   - Receives the birth/survival bit mask (see lifeRule)
+ *   states - Receives the number of states, 2 for a Life-like rule
+ *
+ * Returns:
+ *   1 on success, 0 if the text is not a rule this program can run
+ */
+int parseRule(const char *text, size_t length, uint32_t *rule, int *states) {
+    // Trim the spaces an RLE header may leave around the value
+    while (length > 0 && (*text == ' ' || *text == '\t')) {
+        text++;
+        length--;
+    }
+    while (length > 0 && (text[length - 1] == ' ' || text[length - 1] == '\t'
+                          || text[length - 1] == '\r')) {
+        length--;
+    }
+    if (length == 0) {
+        return 0;
+    }
+
+    int lettered = 0;
+    for (size_t i = 0; i < length; i++) {
+        lettered |= text[i] != '/' && (text[i] < '0' || text[i] > '9');
+    }
+
+    uint32_t mask = 0;
+    int count = 2;
+    int part = 0;               // Which /-separated part we are in
+    char kind = 0;              // 'B', 'S' or 'C' for the digits that follow
+    int number = -1;            // Digits of a C part
+    for (size_t i = 0; i <= length; i++) {
+        char c = i < length ? text[i] : '/';
+        if (c == '/') {
+            if (kind == 'C') {
+                if (number < 2 || number > GENERATIONS_MAX_STATES) {
+                    return 0;
+                }
+                count = number;
+            }
+            part++;
+            kind = 0;
+            number = -1;
+            continue;
+        }
+        if (lettered && (c < '0' || c > '9')) {
+            // Each part starts with its letter, slash or no slash
+            kind = (char)(c & ~0x20);
+            if (kind == 'G') {
+                kind = 'C';
+            }
+            if (kind != 'B' && kind != 'S' && kind != 'C') {
+                return 0;
+            }
+            continue;
+        }
+        if (!lettered) {
+            kind = part == 0 ? 'S' : part == 1 ? 'B' : 'C';
+        }
+        if (c < '0' || c > '9') {
+            return 0;
+        }
+        if (kind == 'C') {
+            number = (number < 0 ? 0 : number * 10) + (c - '0');
+            if (number > 1000) {
+                return 0;
+            }
+        } else if (c > '8') {
+            return 0;
+        } else {
+            mask |= kind == 'B' ? RULE_BIRTH(c - '0') : RULE_SURVIVAL(c - '0');
+        }
+    }
+    if (part > 3 || (!lettered && part < 2)) {
+        return 0;
+    }
+
+    *rule = mask;
+    *states = count;
+    return 1;
+}
+
+/*
+ * formatRule - Write a rule in the B/S notation
+ *
+ * Parameters:
+ *   text   - Receives the rulestring, e.g. "B36/S23" or "B2/S/C3"
+ *   size   - Size of text
+ *   rule   - Birth/survival bit mask
+ *   states - Number of states
+ */
+void formatRule(char *text, size_t size, uint32_t rule, int states) {
+    char digits[2][10];
+    for (int half = 0; half < 2; half++) {
+        int length = 0;
+        for (int n = 0; n <= 8; n++) {
+            if (rule & (1u << (16 * half + n))) {
+                digits[half][length++] = (char)('0' + n);
+            }
+        }
+        digits[half][length] = '\0';
+    }
+    if (states > 2) {
+        snprintf(text, size, "B%s/S%s/C%d", digits[0], digits[1], states);
+    } else {
+        snprintf(text, size, "B%s/S%s", digits[0], digits[1]);
+    }
+}
+
+/*
+ * setRule - Make a parsed rule the rule of this run
+ */
+void setRule(uint32_t rule, int states) {
+    ltlRule.radius = 0;
+    lifeRule = rule;
+    ruleStates = states;
+    formatRule(ruleText, sizeof ruleText, rule, states);
+}
+
+/*
+ * compileRule - Build the tables the kernels read the rule from
+ *
+ * ruleTable serves the char kernels and covers every char, dying
+ * states included. The lane tables are shuffle tables for the vector
+ * kernels, indexed by neighbor count, and the words drive the packed
+ * kernels' bit-sliced rule (see packedRuleWord).
+ */
+void compileRule(void) {
+    for (int c = 0; c < 256; c++) {
+        for (int n = 0; n <= 8; n++) {
+            char next = DEAD;
+            if (c == ALIVE) {
+                // A live cell that does not survive starts dying, if the
+                // rule has dying states
+                next = lifeRule & RULE_SURVIVAL(n) ? ALIVE : ruleStates > 2 ? DYING(2) : DEAD;
+            } else if (c == DEAD) {
+                next = lifeRule & RULE_BIRTH(n) ? ALIVE : DEAD;
+            } else if (c >= DYING(2) && c <= DYING(ruleStates - 1)) {
+                // Dying cells ignore their neighbors and age by one state
+                int state = c + 1;
+                next = state + 1 < ruleStates ? DYING(state + 1) : DEAD;
+            }
+            ruleTable[c][n] = next;
+        }
+    }
+
+    for (int n = 0; n < 16; n++) {
+        ruleBirthLanes[n] = (char)(n <= 8 && (lifeRule & RULE_BIRTH(n)) ? 0xFF : 0);
+        ruleSurvivalLanes[n] = (char)(n <= 8 && (lifeRule & RULE_SURVIVAL(n)) ? 0xFF : 0);
+    }
+    for (int n = 0; n <= 8; n++) {
+        int birth = (lifeRule & RULE_BIRTH(n)) != 0;
+        int survival = (lifeRule & RULE_SURVIVAL(n)) != 0;
+        ruleBirthWords[n] = birth ? ~UINT64_C(0) : 0;
+        ruleFlipWords[n] = birth != survival ? ~UINT64_C(0) : 0;
+    }
+}
+
+// ============================================================================
+// LARGER THAN LIFE
+// ============================================================================
+
+/*
+ * readRuleNumber - Read a decimal number out of a rulestring
+ *
+ * Returns:
+ *   1 on success with *p past the digits, 0 if there were none or the
+ *   number is absurdly long
+ */
+static int readRuleNumber(const char **p, const char *end, int *value) {
+    int number = 0;
+    int digits = 0;
+    while (*p < end && **p >= '0' && **p <= '9' && digits < 7) {
+        number = number * 10 + (**p - '0');
+        (*p)++;
+        digits++;
+    }
+    *value = number;
+    return digits > 0 && (*p == end || **p < '0' || **p > '9');
+}
+
+/*
+ * parseLtlRule - Read a Larger-than-Life rulestring
+ *
+ * Understands Golly's notation, e.g. R5,C0,M1,S34..58,B34..45,NM
+ * (Bosco's Rule): radius 5, 2 states, the cell counts itself, survival
+ * on 34 to 58 live cells and birth on 34 to 45. A range may be a single
+ * count. C and M are optional; C must be 0 or 2 and the neighborhood
+ * the Moore box (NM), which is what a summed-area table can sum.
+ *
+ * Parameters:
+ *   text   - The rulestring, not necessarily NUL-terminated
+ *   length - Its length
+ *   rule   - Receives the rule
+ *
+ * Returns:
+ *   1 on success, 0 if the text is not a rule this program can run
+ */
+int parseLtlRule(const char *text, size_t length, struct LtlRule *rule) {
+    const char *p = text;
+    const char *end = text + length;
+    struct LtlRule parsed = { 0, 0, -1, -1, -1, -1 };
+
+    while (end > p && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r')) {
+        end--;
+    }
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        p++;
+    }
+
+    while (p < end) {
+        char letter = (char)(*p++ & ~0x20);
+        int low, high, value;
+        switch (letter) {
+        case 'R':
+            if (!readRuleNumber(&p, end, &value) || value < 1 || value > LTL_MAX_RADIUS) {
+                return 0;
+            }
+            parsed.radius = value;
+            break;
+        case 'C':
+            if (!readRuleNumber(&p, end, &value) || (value != 0 && value != 2)) {
+                return 0;
+            }
+            break;
+        case 'M':
+            if (!readRuleNumber(&p, end, &value) || value > 1) {
+                return 0;
+            }
+            parsed.middle = value;
+            break;
+        case 'N':
+            if (p == end || (*p++ & ~0x20) != 'M') {
+                return 0;
+            }
+            break;
+        case 'S':
+        case 'B':
+            if (!readRuleNumber(&p, end, &low)) {
+                return 0;
+            }
+            high = low;
+            if (end - p >= 2 && p[0] == '.' && p[1] == '.') {
+                p += 2;
+                if (!readRuleNumber(&p, end, &high) || high < low) {
+                    return 0;
+                }
+            }
+            if (letter == 'S') {
+                parsed.survivalMin = low;
+                parsed.survivalMax = high;
+            } else {
+                parsed.birthMin = low;
+                parsed.birthMax = high;
+            }
+            break;
+        default:
+            return 0;
+        }
+        if (p < end && *p++ != ',') {
+            return 0;
+        }
+    }
+
+    // The largest count is the whole box
+    int cells = (2 * parsed.radius + 1) * (2 * parsed.radius + 1);
+    if (parsed.radius == 0 || parsed.birthMin < 0 || parsed.survivalMin < 0
+        || parsed.birthMax > cells || parsed.survivalMax > cells) {
+        return 0;
+    }
+    *rule = parsed;
+    return 1;
+}
+
+/*
+ * formatLtlRule - Write a Larger-than-Life rule in Golly's notation
+ */
+void formatLtlRule(char *text, size_t size, const struct LtlRule *rule) {
+    snprintf(text, size, "R%d,C0,M%d,S%d..%d,B%d..%d,NM", rule->radius, rule->middle,
+             rule->survivalMin, rule->survivalMax, rule->birthMin, rule->birthMax);
+}
+
+/*
+ * setLtlRule - Make a parsed Larger-than-Life rule the rule of this run
+ */
+void setLtlRule(const struct LtlRule *rule) {
+    ltlRule = *rule;
+    lifeRule = CONWAY_RULE;
+    ruleStates = 2;
+    formatLtlRule(ruleText, sizeof ruleText, rule);
+}
+
+/*
+ * allocateLtlSums - Allocate the summed-area table for the board
+ *
+ * One entry per cell of the board widened by the radius on every side,
+ * plus a zero row and column in front.
+ *
+ * Returns:
+ *   1 on success, 0 if memory ran out
+ */
+int allocateLtlSums(void) {
+    size_t r = (size_t)ltlRule.radius;
+    ltlSumsStride = (size_t)width + 2 * r + 1;
+    ltlSums = calloc(((size_t)height + 2 * r + 1) * ltlSumsStride, sizeof(uint32_t));
+    return ltlSums != NULL;
+}
+
+/*
+ * ltlBoxCount - Live cells in the box around a cell, from the table
+ *
+ * Board cell (x, y) sits at table row y + r + 1 and column x + r + 1, so
+ * its box spans table rows y + 1 .. y + 2r + 1 and the same for columns.
+ * The entries wrap around on very large boards, but the count itself is
+ * small and unsigned arithmetic gets it exactly.
+ */
+static inline uint32_t ltlBoxCount(const uint32_t *top, const uint32_t *bottom, int x, int span) {
+    return bottom[x + span] - top[x + span] - bottom[x] + top[x];
+}
+
+/*
+ * stepLtlWorker - One thread's share of a Larger-than-Life generation
+ *
+ * Counting the (2r+1)^2 cells of each box directly costs O(r^2) per
+ * cell. Instead every generation builds a summed-area table: entry
+ * (i, j) is the number of live cells above and left of it, on the board
+ * widened by r wrapped-around cells on every side. Any box is then four
+ * lookups, whatever the radius.
+ *
+ * The table is built in two passes, each split between the threads:
+ * running sums along each row (bands of rows), then down each column
+ * (runs of columns). After a third barrier every thread steps its band
+ * of the board from the finished table. A single thread folds the two
+ * passes into one.
+ */
+void stepLtlWorker(int worker) {
+    const int r = ltlRule.radius;
+    const int span = 2 * r + 1;
+    const size_t sumStride = ltlSumsStride;
+    const int tableRows = height + 2 * r;
+    const int tableColumns = width + 2 * r;
+    const int combined = numThreads == 1;
+    uint64_t traceStart = traceBegin();
+
+    // Pass 1: running sums along table rows 1 .. tableRows. Table column
+    // j + 1 holds board column (j - r) mod width
+    int iBegin = 1 + (int)((long long)tableRows * worker / numThreads);
+    int iEnd = 1 + (int)((long long)tableRows * (worker + 1) / numThreads);
+    int xStart = ((-r) % width + width) % width;
+    for (int i = iBegin; i < iEnd; i++) {
+        int y = ((i - 1 - r) % height + height) % height;
+        const char *row = cellRow(cells, y);
+        const uint32_t *above = ltlSums + (size_t)(i - 1) * sumStride + 1;
+        uint32_t *out = ltlSums + (size_t)i * sumStride + 1;
+        uint32_t sum = 0;
+
+        // The row in runs that each end at the edge of the board
+        for (int j = 0, x = xStart; j < tableColumns; x = 0) {
+            int run = width - x < tableColumns - j ? width - x : tableColumns - j;
+            for (int k = 0; k < run; k++) {
+                sum += row[x + k] == ALIVE;
+                out[j + k] = combined ? above[j + k] + sum : sum;
+            }
+            j += run;
+        }
+    }
+
+    // Pass 2: add each row to the one below, column by column
+    if (!combined) {
+        uint64_t waitStart = traceBegin();
+        pthread_barrier_wait(&ltlPhase);
+        traceEnd(TRACE_WAIT, waitStart, worker);
+
+        int jBegin = 1 + (int)((long long)tableColumns * worker / numThreads);
+        int jEnd = 1 + (int)((long long)tableColumns * (worker + 1) / numThreads);
+        for (int i = 2; i <= tableRows; i++) {
+            const uint32_t *above = ltlSums + (size_t)(i - 1) * sumStride;
+            uint32_t *out = ltlSums + (size_t)i * sumStride;
+            for (int j = jBegin; j < jEnd; j++) {
+                out[j] += above[j];
+            }
+        }
+
+        waitStart = traceBegin();
+        pthread_barrier_wait(&ltlPhase);
+        traceEnd(TRACE_WAIT, waitStart, worker);
+    }
+
+    // Pass 3: the rules, from four lookups per cell. Unsigned compares
+    // test min <= count <= max in one go
+    const uint32_t birthMin = (uint32_t)ltlRule.birthMin;
+    const uint32_t birthRange = (uint32_t)(ltlRule.birthMax - ltlRule.birthMin);
+    const uint32_t survivalMin = (uint32_t)ltlRule.survivalMin;
+    const uint32_t survivalRange = (uint32_t)(ltlRule.survivalMax - ltlRule.survivalMin);
+    const uint32_t middle = (uint32_t)ltlRule.middle;
+    const int countStats = collectStats;    // Read once: the stores below may alias it
+    struct RegionStats stats = EMPTY_REGION;
+    int yBegin = (int)((long long)height * worker / numThreads);
+    int yEnd = (int)((long long)height * (worker + 1) / numThreads);
+    for (int y = yBegin; y < yEnd; y++) {
+        const uint32_t *top = ltlSums + (size_t)y * sumStride;
+        const uint32_t *bottom = ltlSums + (size_t)(y + span) * sumStride;
+        const char *row = cellRow(cells, y);
+        char *next = cellRow(nextCells, y);
+        long long rowStart = stats.population;
+
+        for (int x = 0; x < width; x++) {
+            uint32_t self = row[x] == ALIVE;
+            uint32_t count = ltlBoxCount(top, bottom, x, span) - (self & ~middle);
+            int alive = self ? count - survivalMin <= survivalRange : count - birthMin <= birthRange;
+            next[x] = alive ? ALIVE : DEAD;
+            if (countStats) {
+                stats.population += alive;
+                stats.changed += (uint32_t)alive != self;
+            }
+        }
+        if (countStats && stats.population > rowStart) {
+            growBoxChars(&stats, next, 0, width, y);
+        }
+    }
+    workerStats[worker] = stats;
+    traceEnd(TRACE_BAND, traceStart, worker);
+}
+
+/*
+ * nextLtlCellNaive - A Larger-than-Life cell the slow way
+ *
+ * Counts the whole box cell by cell, wrapping every coordinate. Only
+ * used by verifyLtl as the reference for the summed-area engine.
+ */
+static char nextLtlCellNaive(int x, int y) {
+    int r = ltlRule.radius;
+    int count = 0;
+    for (int dy = -r; dy <= r; dy++) {
+        const char *row = cellRow(cells, ((y + dy) % height + height) % height);
+        for (int dx = -r; dx <= r; dx++) {
+            count += row[((x + dx) % width + width) % width] == ALIVE;
+        }
+    }
+    int self = cellRow(cells, y)[x] == ALIVE;
+    if (!ltlRule.middle) {
+        count -= self;
+    }
+    int alive = self ? count >= ltlRule.survivalMin && count <= ltlRule.survivalMax
+                     : count >= ltlRule.birthMin && count <= ltlRule.birthMax;
+    return alive ? ALIVE : DEAD;
+}
+
+/*
+ * verifyLtl - Check the summed-area engine against the naive count
+ *
+ * The Larger-than-Life counterpart of verifyKernels: a single-threaded
+ * run of nextLtlCellNaive records the checksum and population of every
+ * generation, then the engine runs from the same soup through
+ * calculateNextGeneration with the selected --threads and must match.
+ *
+ * Parameters:
+ *   generations - How many generations to compare
+ *
+ * Returns:
+ *   1 if every generation matched, 0 on the first mismatch
+ */
+int verifyLtl(int generations) {
+    unsigned int seed = (unsigned int)rand();
+    uint64_t *expected = malloc(sizeof(uint64_t) * ((size_t)generations + 1));
+    long long *expectedPopulation = malloc(sizeof(long long) * ((size_t)generations + 1));
+    int requestedStats = collectStats;
+    int ok = 1;
+    collectStats = 1;
+
+    storageMode = STORAGE_CHAR;
+    for (int run = 0; run < 2 && ok; run++) {
+        if (expected == NULL || expectedPopulation == NULL || !allocateGrids(1, 0)) {
+            fprintf(stderr, "Not enough memory for a %dx%d board\n", width, height);
+            ok = 0;
+            break;
+        }
+        srand(seed);
+        initializeGrid();
+        for (int gen = 0; gen <= generations; gen++) {
+            copyGrid();
+            if (run == 0) {
+                long long population = 0;
+                expected[gen] = boardChecksum();
+                for (int y = 0; y < height; y++) {
+                    for (int x = 0; x < width; x++) {
+                        cellRow(nextCells, y)[x] = nextLtlCellNaive(x, y);
+                        population += cellRow(cells, y)[x] == ALIVE;
+                    }
+                }
+                expectedPopulation[gen] = population;
+            } else {
+                if (boardChecksum() != expected[gen]) {
+                    printf("Mismatch in the summed-area engine at generation %d\n", gen);
+                    ok = 0;
+                    break;
+                }
+                if (gen > 0 && stepStats.population != expectedPopulation[gen]) {
+                    printf("Stats mismatch in the summed-area engine at generation %d\n", gen);
+                    ok = 0;
+                    break;
+                }
+                calculateNextGeneration();
+            }
+        }
+        freeGrids();
+    }
+    free(expected);
+    free(expectedPopulation);
+    collectStats = requestedStats;
+
+    if (ok) {
+        printf("Verified %d generations of %s on a %dx%d board: the summed-area engine"
+               " matches the naive count\n", generations, ruleText, width, height);
+    }
+    return ok;
+}
+
+// ============================================================================
+// SOUP CENSUS
+// ============================================================================
+
+// Soups a thread takes from censusNextSoup at a time
+#define CENSUS_BATCH 16
+
+/*
+ * censusRandom - Next number of a splitmix64 stream
+ */
+static uint64_t censusRandom(uint64_t *state) {
+    uint64_t z = (*state += UINT64_C(0x9E3779B97F4A7C15));
+    z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+    return z ^ (z >> 31);
+}
+
+// Cell (x, y) of a census board; x and y must already be wrapped
+static inline int censusCell(uint64_t board[][CENSUS_WORDS], int x, int y) {
+    return (int)(board[y][x / WORD_BITS] >> (x % WORD_BITS)) & 1;
+}
+
+/*
+ * seedSoup - Clear a worker's board and put soup number soup in the middle
+ *
+ * Like initializeGrid, every cell of the soup is alive with probability
+ * 1/2. Each soup gets a random stream of its own, started from the seed
+ * and its number alone, so the census comes out the same with any
+ * number of threads.
+ */
+static void seedSoup(struct CensusWorker *worker, unsigned long long soup) {
+    uint64_t state = ((uint64_t)censusSeed << 32) ^ (soup * UINT64_C(0xD1B54A32D192ED03));
+    int offset = (CENSUS_SIZE - censusSoupSize) / 2;
+
+    worker->current = 0;
+    memset(worker->board[0], 0, sizeof worker->board[0]);
+    for (int y = 0; y < censusSoupSize; y++) {
+        uint64_t bits = censusRandom(&state);
+        for (int x = 0; x < censusSoupSize; x++) {
+            int cx = offset + x;
+            worker->board[0][offset + y][cx / WORD_BITS] |= ((bits >> x) & 1) << (cx % WORD_BITS);
+        }
+    }
+}
+
+/*
+ * censusRecount - Count a worker's board after it was changed by hand
+ *
+ * Also marks every word changed, so the next censusStep works out the
+ * whole board.
+ *
+ * Returns:
+ *   The population
+ */
+static uint32_t censusRecount(struct CensusWorker *worker) {
+    uint32_t population = 0;
+    for (int y = 0; y < CENSUS_SIZE; y++) {
+        for (int i = 0; i < CENSUS_WORDS; i++) {
+            population += (uint32_t)__builtin_popcountll(worker->board[worker->current][y][i]);
+        }
+    }
+    for (int y = 0; y < CENSUS_SIZE; y++) {
+        worker->changed[y] = (1u << (3 * CENSUS_WORDS)) - 1;
+    }
+    worker->live = population;
+    return population;
+}
+
+/*
+ * censusStepBody - One generation of a worker's board
+ *
+ * The packed kernel's adder tree on a torus of CENSUS_WORDS words per
+ * row. A soup soon calms down to a few spots of activity among still
+ * lifes, so only words next to a change in the last step are worked
+ * out. Every other word is the same in both boards already: it did not
+ * change between them. For each row, worker->changed has a bit per word
+ * that changed at all, then per word whose first cell did, then per word
+ * whose last cell did; only those affect the words either side. The
+ * population is kept up to date from the words that change.
+ *
+ * Inlined into the wrappers below with anyRule a constant.
+ *
+ * Returns:
+ *   The population of the new generation
+ */
+static inline __attribute__((always_inline))
+uint32_t censusStepBody(struct CensusWorker *worker, const int anyRule) {
+    const unsigned allWords = (1u << CENSUS_WORDS) - 1;
+    uint64_t (*in)[CENSUS_WORDS] = worker->board[worker->current];
+    uint64_t (*out)[CENSUS_WORDS] = worker->board[!worker->current];
+    uint16_t changed[CENSUS_SIZE];
+    uint32_t live = worker->live;
+
+    for (int y = 0; y < CENSUS_SIZE; y++) {
+        int up = (y - 1) & (CENSUS_SIZE - 1);
+        int down = (y + 1) & (CENSUS_SIZE - 1);
+        unsigned near = worker->changed[up] | worker->changed[y] | worker->changed[down];
+        changed[y] = 0;
+        if (near == 0) {
+            continue;
+        }
+        // A word sees the last cell of the word before it and the first
+        // of the word after it
+        unsigned first = (near >> CENSUS_WORDS) & allWords;
+        unsigned last = near >> (2 * CENSUS_WORDS);
+        unsigned words = near & allWords;
+        words |= ((last << 1) | (last >> (CENSUS_WORDS - 1))) & allWords;
+        words |= (first >> 1) | (first << (CENSUS_WORDS - 1));
+        words &= allWords;
+
+        const uint64_t *above = in[up];
+        const uint64_t *row = in[y];
+        const uint64_t *below = in[down];
+        // Columns wrap from the last word to the first
+        #define CENSUS_WEST(p) (((p)[i] << 1) | ((p)[(i + CENSUS_WORDS - 1) % CENSUS_WORDS] >> (WORD_BITS - 1)))
+        #define CENSUS_EAST(p) (((p)[i] >> 1) | ((p)[(i + 1) % CENSUS_WORDS] << (WORD_BITS - 1)))
+        for (int i = 0; i < CENSUS_WORDS; i++) {
+            if (!(words & (1u << i))) {
+                continue;
+            }
+            uint64_t next = packedNextWord(CENSUS_WEST(above), above[i], CENSUS_EAST(above),
+                                           CENSUS_WEST(row), row[i], CENSUS_EAST(row),
+                                           CENSUS_WEST(below), below[i], CENSUS_EAST(below),
+                                           anyRule);
+            out[y][i] = next;
+            uint64_t difference = next ^ row[i];
+            if (difference != 0) {
+                changed[y] |= (uint16_t)((1u << i) | (unsigned)(difference & 1) << (CENSUS_WORDS + i)
+                                         | (unsigned)(difference >> (WORD_BITS - 1)) << (2 * CENSUS_WORDS + i));
+                live += (uint32_t)__builtin_popcountll(next) - (uint32_t)__builtin_popcountll(row[i]);
+            }
+        }
+        #undef CENSUS_WEST
+        #undef CENSUS_EAST
+    }
+    memcpy(worker->changed, changed, sizeof changed);
+    worker->live = live;
+    worker->current ^= 1;
+    return live;
+}
+
+static uint32_t censusStepPlain(struct CensusWorker *worker) {
+    return lifeRule == CONWAY_RULE ? censusStepBody(worker, 0) : censusStepBody(worker, 1);
+}
+
+#ifdef HAVE_X86_SIMD
+__attribute__((target("popcnt")))
+static uint32_t censusStepPopcnt(struct CensusWorker *worker) {
+    return lifeRule == CONWAY_RULE ? censusStepBody(worker, 0) : censusStepBody(worker, 1);
+}
+#endif
+
+// censusStepPlain, or censusStepPopcnt where the CPU has it; set by runCensus
+static uint32_t (*censusStep)(struct CensusWorker *worker) = censusStepPlain;
+
+/*
+ * censusPeriod - Whether the population has started to repeat
+ *
+ * A settled soup repeats its population with the period of everything
+ * left on the board, spaceships included, since they keep their cells
+ * wherever they are. The population must have repeated for a good while
+ * before this counts; settleSoup makes sure of the rest.
+ *
+ * Returns:
+ *   The shortest period that fits, or 0 if none does yet
+ */
+static int censusPeriod(const struct CensusWorker *worker, int generation) {
+    for (int period = 1; period <= CENSUS_MAX_PERIOD; period++) {
+        int span = 2 * period + 16;
+        if (generation < span + period) {
+            break;
+        }
+        int k = 0;
+        while (k < span && worker->population[(generation - k) % CENSUS_HISTORY]
+                           == worker->population[(generation - k - period) % CENSUS_HISTORY]) {
+            k++;
+        }
+        if (k == span) {
+            return period;
+        }
+    }
+    return 0;
+}
+
+/*
+ * collectObject - Take one group of cells out of a mask
+ *
+ * Flood-fills from cell (x, y), clearing mask cells as it goes. The
+ * queue ends up with the torus coordinates of every cell, and unwrapped
+ * ones: a group across the edge of the torus comes out in one piece.
+ *
+ * Parameters:
+ *   mask   - The cells to take from
+ *   queue  - Receives 4 ints per cell
+ *   x, y   - The first cell, on the torus
+ *   ux, uy - Its unwrapped coordinates
+ *   reach  - How far apart cells of one group may be: 1 for cells that
+ *            touch, 2 to keep the parts of an object together
+ *
+ * Returns:
+ *   The number of cells
+ */
+static int collectObject(uint64_t mask[][CENSUS_WORDS], int *queue, int x, int y, int ux, int uy, int reach) {
+    int head = 0;
+    int tail = 1;
+
+    mask[y][x / WORD_BITS] &= ~(UINT64_C(1) << (x % WORD_BITS));
+    queue[0] = x;
+    queue[1] = y;
+    queue[2] = ux;
+    queue[3] = uy;
+    while (head < tail) {
+        const int *cell = queue + 4 * head++;
+        for (int dy = -reach; dy <= reach; dy++) {
+            for (int dx = -reach; dx <= reach; dx++) {
+                int nx = (cell[0] + dx) & (CENSUS_SIZE - 1);
+                int ny = (cell[1] + dy) & (CENSUS_SIZE - 1);
+                uint64_t bit = UINT64_C(1) << (nx % WORD_BITS);
+                if (mask[ny][nx / WORD_BITS] & bit) {
+                    mask[ny][nx / WORD_BITS] &= ~bit;
+                    int *added = queue + 4 * tail++;
+                    added[0] = nx;
+                    added[1] = ny;
+                    added[2] = cell[2] + dx;
+                    added[3] = cell[3] + dy;
+                }
+            }
+        }
+    }
+    return tail;
+}
+
+/*
+ * planeClear - Empty a plane
+ *
+ * Only the boxes that may still hold live cells are cleared, not the
+ * whole plane.
+ */
+static void planeClear(struct CensusPlane *plane) {
+    for (int b = 0; b < 2; b++) {
+        int *dirty = plane->dirty[b];
+        for (int y = dirty[1]; y <= dirty[3]; y++) {
+            memset(plane->cells[b] + (size_t)y * CENSUS_PLANE + dirty[0], 0, (size_t)(dirty[2] - dirty[0] + 1));
+        }
+        dirty[0] = dirty[1] = CENSUS_PLANE;
+        dirty[2] = dirty[3] = -1;
+    }
+    plane->current = 0;
+    plane->box[0] = plane->box[1] = CENSUS_PLANE;
+    plane->box[2] = plane->box[3] = -1;
+    plane->population = 0;
+}
+
+/*
+ * planePlace - Add cells to a plane
+ *
+ * Parameters:
+ *   cells  - Unwrapped x, y per cell
+ *   count  - How many
+ *   dx, dy - Added to every cell; the cells must land well inside the plane
+ */
+static void planePlace(struct CensusPlane *plane, const int *cells, int count, int dx, int dy) {
+    unsigned char *out = plane->cells[plane->current];
+    int *box = plane->box;
+    for (int i = 0; i < count; i++) {
+        int x = cells[2 * i] + dx;
+        int y = cells[2 * i + 1] + dy;
+        plane->population += !out[(size_t)y * CENSUS_PLANE + x];
+        out[(size_t)y * CENSUS_PLANE + x] = 1;
+        box[0] = x < box[0] ? x : box[0];
+        box[1] = y < box[1] ? y : box[1];
+        box[2] = x > box[2] ? x : box[2];
+        box[3] = y > box[3] ? y : box[3];
+    }
+    int *dirty = plane->dirty[plane->current];
+    dirty[0] = box[0] < dirty[0] ? box[0] : dirty[0];
+    dirty[1] = box[1] < dirty[1] ? box[1] : dirty[1];
+    dirty[2] = box[2] > dirty[2] ? box[2] : dirty[2];
+    dirty[3] = box[3] > dirty[3] ? box[3] : dirty[3];
+}
+
+/*
+ * planeStep - One generation of a plane
+ *
+ * Works out the box of the live cells plus one cell all round.
+ *
+ * Returns:
+ *   1 on success, 0 if the object came too near the edge of the plane
+ */
+static int planeStep(struct CensusPlane *plane) {
+    const unsigned char *in = plane->cells[plane->current];
+    unsigned char *next = plane->cells[!plane->current];
+    int *dirty = plane->dirty[!plane->current];
+    int *box = plane->box;
+
+    for (int y = dirty[1]; y <= dirty[3]; y++) {
+        memset(next + (size_t)y * CENSUS_PLANE + dirty[0], 0, (size_t)(dirty[2] - dirty[0] + 1));
+    }
+    dirty[0] = dirty[1] = CENSUS_PLANE;
+    dirty[2] = dirty[3] = -1;
+    plane->current ^= 1;
+    if (plane->population == 0) {
+        return 1;   // Nothing is ever born next to nothing
+    }
+    int x0 = box[0] - 1, y0 = box[1] - 1, x1 = box[2] + 1, y1 = box[3] + 1;
+    if (x0 < 1 || y0 < 1 || x1 > CENSUS_PLANE - 2 || y1 > CENSUS_PLANE - 2) {
+        return 0;
+    }
+
+    int nx0 = CENSUS_PLANE, ny0 = CENSUS_PLANE, nx1 = -1, ny1 = -1;
+    int population = 0;
+    for (int y = y0; y <= y1; y++) {
+        const unsigned char *above = in + (size_t)(y - 1) * CENSUS_PLANE;
+        const unsigned char *row = in + (size_t)y * CENSUS_PLANE;
+        const unsigned char *below = in + (size_t)(y + 1) * CENSUS_PLANE;
+        unsigned char *out = next + (size_t)y * CENSUS_PLANE;
+        for (int x = x0; x <= x1; x++) {
+            int numNeighbors = above[x - 1] + above[x] + above[x + 1] + row[x - 1] + row[x + 1]
+                             + below[x - 1] + below[x] + below[x + 1];
+            unsigned char alive = (lifeRule >> (numNeighbors + (row[x] ? 16 : 0))) & 1;
+            out[x] = alive;
+            if (alive) {
+                population++;
+                nx0 = x < nx0 ? x : nx0;
+                nx1 = x > nx1 ? x : nx1;
+                ny0 = y < ny0 ? y : ny0;
+                ny1 = y > ny1 ? y : ny1;
+            }
+        }
+    }
+    dirty[0] = x0;
+    dirty[1] = y0;
+    dirty[2] = x1;
+    dirty[3] = y1;
+    box[0] = nx0;
+    box[1] = ny0;
+    box[2] = nx1;
+    box[3] = ny1;
+    plane->population = population;
+    return 1;
+}
+
+/*
+ * planeOverlays - Whether plane a is just planes b and c laid over each other
+ */
+static int planeOverlays(const struct CensusPlane *a, const struct CensusPlane *b, const struct CensusPlane *c) {
+    int x0 = b->box[0] < c->box[0] ? b->box[0] : c->box[0];
+    int y0 = b->box[1] < c->box[1] ? b->box[1] : c->box[1];
+    int x1 = b->box[2] > c->box[2] ? b->box[2] : c->box[2];
+    int y1 = b->box[3] > c->box[3] ? b->box[3] : c->box[3];
+    if (a->box[0] != x0 || a->box[1] != y0 || a->box[2] != x1 || a->box[3] != y1) {
+        return 0;
+    }
+    const unsigned char *cellsA = a->cells[a->current];
+    const unsigned char *cellsB = b->cells[b->current];
+    const unsigned char *cellsC = c->cells[c->current];
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+            size_t i = (size_t)y * CENSUS_PLANE + x;
+            if (cellsA[i] != (cellsB[i] | cellsC[i])) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/*
+ * wechsler - The extended Wechsler form of an object in one orientation
+ *
+ * The object is cut into strips of 5 rows. Each column of a strip is a
+ * 5-bit number written as one of 0-9a-v, strips are separated by z,
+ * trailing zeros are dropped and runs of zeros shortened: w and x stand
+ * for 2 and 3 zeros, y followed by 0-9a-z for 4 to 39.
+ *
+ * Parameters:
+ *   plane       - The object, CENSUS_PLANE cells per row
+ *   x, y, w, h  - Its bounding box in plane
+ *   orientation - Bit 0 mirrors columns, bit 1 rows, bit 2 swaps the axes
+ *   out         - Receives the form, NUL-terminated
+ *   strip       - Scratch room for one strip
+ */
+static void wechsler(const unsigned char *plane, int x, int y, int w, int h, int orientation,
+                     char *out, char *strip) {
+    static const char digits[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+    int swap = (orientation & 4) != 0;
+    int columns = swap ? h : w;
+    int rows = swap ? w : h;
+    char *p = out;
+
+    for (int top = 0; top < rows; top += 5) {
+        if (top > 0) {
+            *p++ = 'z';
+        }
+        int length = 0;
+        for (int c = 0; c < columns; c++) {
+            int value = 0;
+            for (int r = top; r < top + 5 && r < rows; r++) {
+                int tx = swap ? r : c;
+                int ty = swap ? c : r;
+                int ix = orientation & 1 ? w - 1 - tx : tx;
+                int iy = orientation & 2 ? h - 1 - ty : ty;
+                value |= plane[(size_t)(y + iy) * CENSUS_PLANE + (size_t)(x + ix)] << (r - top);
+            }
+            strip[c] = digits[value];
+            if (value != 0) {
+                length = c + 1;
+            }
+        }
+        for (int c = 0; c < length;) {
+            int zeros = 0;
+            while (c + zeros < length && strip[c + zeros] == '0' && zeros < 39) {
+                zeros++;
+            }
+            if (zeros == 0) {
+                *p++ = strip[c++];
+                continue;
+            }
+            if (zeros == 1) {
+                *p++ = '0';
+            } else if (zeros == 2) {
+                *p++ = 'w';
+            } else if (zeros == 3) {
+                *p++ = 'x';
+            } else {
+                *p++ = 'y';
+                *p++ = digits[zeros - 4];
+            }
+            c += zeros;
+        }
+    }
+    *p = '\0';
+}
+
+/*
+ * nameObjectPhase - Keep the best form of one phase of an object
+ *
+ * Tries all 8 orientations. The canonical form is the shortest, and of
+ * equally short ones the first in ASCII order.
+ */
+static void nameObjectPhase(struct CensusWorker *worker, const unsigned char *plane,
+                            int x, int y, int w, int h) {
+    for (int orientation = 0; orientation < 8; orientation++) {
+        wechsler(plane, x, y, w, h, orientation, worker->candidate, worker->strip);
+        size_t candidateLength = strlen(worker->candidate);
+        size_t bestLength = strlen(worker->code);
+        if (worker->code[0] == '\0' || candidateLength < bestLength
+            || (candidateLength == bestLength && strcmp(worker->candidate, worker->code) < 0)) {
+            memcpy(worker->code, worker->candidate, candidateLength + 1);
+        }
+    }
+}
+
+/*
+ * nameObject - Name the object in worker->objectCells
+ *
+ * Runs the object on its own, on an empty plane, until it comes back to
+ * its first shape. Back in the same place after 1 generation it is a
+ * still life, after more an oscillator; anywhere else a spaceship. The
+ * canonical form is the best over every phase, named on a second run
+ * through one period.
+ *
+ * Parameters:
+ *   count      - Cells in worker->objectCells
+ *   xMin, yMin - The corner of their bounding box
+ *   w, h       - Its size, at most CENSUS_OBJECT_MAX
+ *
+ * Returns:
+ *   1 with the apgcode in worker->code, 0 if the object does not come
+ *   back within CENSUS_MAX_PERIOD generations (it is not on its own yet,
+ *   or not an object at all)
+ */
+static int nameObject(struct CensusWorker *worker, int count, int xMin, int yMin, int w, int h) {
+    // The object with its box at (margin, margin); it can move at most a
+    // cell per generation, so it never reaches the edge of the plane
+    const int margin = CENSUS_MAX_PERIOD + 2;
+    struct CensusPlane *plane = &worker->plane[0];
+    planeClear(plane);
+    planePlace(plane, worker->objectCells, count, margin - xMin, margin - yMin);
+    const unsigned char *cells = plane->cells[plane->current];
+    for (int r = 0; r < h; r++) {
+        memcpy(worker->firstPhase + (size_t)r * w, cells + (size_t)(margin + r) * CENSUS_PLANE + margin,
+               (size_t)w);
+    }
+
+    // Find the period first: what does not come back is mostly debris
+    // still settling, not worth naming
+    int period = 0;
+    int x0 = margin, y0 = margin;
+    for (int t = 1; t <= CENSUS_MAX_PERIOD && period == 0; t++) {
+        if (!planeStep(plane) || plane->population == 0) {
+            return 0;
+        }
+        cells = plane->cells[plane->current];
+        int same = plane->box[2] - plane->box[0] + 1 == w && plane->box[3] - plane->box[1] + 1 == h;
+        for (int r = 0; r < h && same; r++) {
+            same = memcmp(worker->firstPhase + (size_t)r * w,
+                          cells + (size_t)(plane->box[1] + r) * CENSUS_PLANE + plane->box[0], (size_t)w) == 0;
+        }
+        if (same) {
+            period = t;
+            x0 = plane->box[0];
+            y0 = plane->box[1];
+        }
+    }
+    if (period == 0) {
+        return 0;
+    }
+
+    // Then run one period again from the start, naming every phase
+    planeClear(plane);
+    planePlace(plane, worker->objectCells, count, margin - xMin, margin - yMin);
+    worker->code[0] = '\0';
+    for (int t = 0; t < period; t++) {
+        if (t > 0) {
+            planeStep(plane);
+        }
+        nameObjectPhase(worker, plane->cells[plane->current], plane->box[0], plane->box[1],
+                        plane->box[2] - plane->box[0] + 1, plane->box[3] - plane->box[1] + 1);
+    }
+
+    char prefix[32];
+    if (x0 != margin || y0 != margin) {
+        snprintf(prefix, sizeof prefix, "xq%d", period);
+    } else if (period > 1) {
+        snprintf(prefix, sizeof prefix, "xp%d", period);
+    } else {
+        snprintf(prefix, sizeof prefix, "xs%d", count);
+    }
+    // A 128x128 object's form leaves room for the prefix
+    size_t prefixLength = strlen(prefix);
+    memmove(worker->code + prefixLength + 1, worker->code, strlen(worker->code) + 1);
+    memcpy(worker->code, prefix, prefixLength);
+    worker->code[prefixLength] = '_';
+    return 1;
+}
+
+/*
+ * classifyObject - Name the object in worker->objectCells, if need be
+ *
+ * The same few dozen shapes make up nearly all of every soup's debris,
+ * so the name of each shape is kept in worker->shapes, found by a hash
+ * of its cells relative to their bounding box. A shape that could not be
+ * named is kept too.
+ *
+ * Parameters:
+ *   count - Cells in worker->objectCells
+ *
+ * Returns:
+ *   1 with the apgcode in worker->code, 0 if the object cannot be named
+ *   (see nameObject) or is too big to name
+ */
+static int classifyObject(struct CensusWorker *worker, int count) {
+    const int *cells = worker->objectCells;
+    int xMin = INT_MAX, yMin = INT_MAX, xMax = INT_MIN, yMax = INT_MIN;
+    for (int i = 0; i < count; i++) {
+        xMin = cells[2 * i] < xMin ? cells[2 * i] : xMin;
+        xMax = cells[2 * i] > xMax ? cells[2 * i] : xMax;
+        yMin = cells[2 * i + 1] < yMin ? cells[2 * i + 1] : yMin;
+        yMax = cells[2 * i + 1] > yMax ? cells[2 * i + 1] : yMax;
+    }
+    int w = xMax - xMin + 1;
+    int h = yMax - yMin + 1;
+    if (w > CENSUS_OBJECT_MAX || h > CENSUS_OBJECT_MAX) {
+        return 0;
+    }
+
+    // A sum of the cells' hashes does not depend on their order
+    uint64_t key = (uint64_t)count;
+    for (int i = 0; i < count; i++) {
+        uint64_t state = (uint64_t)(cells[2 * i] - xMin) << 32 | (uint64_t)(cells[2 * i + 1] - yMin);
+        key += censusRandom(&state);
+    }
+    key |= 1;
+    struct CensusShape *shape = &worker->shapes[key & (CENSUS_SHAPES - 1)];
+    if (shape->key == key) {
+        if (shape->code == NULL) {
+            return 0;
+        }
+        strcpy(worker->code, shape->code);
+        return 1;
+    }
+
+    int named = nameObject(worker, count, xMin, yMin, w, h);
+    free(shape->code);
+    shape->code = named ? strdup(worker->code) : NULL;
+    shape->key = named && shape->code == NULL ? 0 : key;   // Out of memory: just not kept
+    return named;
+}
+
+/*
+ * censusAdd - Count one object in a census table
+ *
+ * Open addressing on the FNV-1a hash of the apgcode; the table doubles
+ * when half full.
+ *
+ * Returns:
+ *   1 on success, 0 if memory ran out
+ */
+static int censusAdd(struct CensusTable *table, const char *code, unsigned long long count) {
+    uint64_t hash = UINT64_C(0xCBF29CE484222325);
+    for (const char *c = code; *c != '\0'; c++) {
+        hash = (hash ^ (unsigned char)*c) * UINT64_C(0x100000001B3);
+    }
+    hash |= hash == 0;
+
+    if (2 * (table->used + 1) > table->capacity) {
+        size_t capacity = table->capacity == 0 ? 64 : 2 * table->capacity;
+        struct CensusEntry *entries = calloc(capacity, sizeof(struct CensusEntry));
+        if (entries == NULL) {
+            return 0;
+        }
+        for (size_t i = 0; i < table->capacity; i++) {
+            if (table->entries[i].hash != 0) {
+                size_t slot = table->entries[i].hash & (capacity - 1);
+                while (entries[slot].hash != 0) {
+                    slot = (slot + 1) & (capacity - 1);
+                }
+                entries[slot] = table->entries[i];
+            }
+        }
+        free(table->entries);
+        table->entries = entries;
+        table->capacity = capacity;
+    }
+
+    size_t slot = hash & (table->capacity - 1);
+    while (table->entries[slot].hash != 0
+           && (table->entries[slot].hash != hash || strcmp(table->entries[slot].code, code) != 0)) {
+        slot = (slot + 1) & (table->capacity - 1);
+    }
+    struct CensusEntry *entry = &table->entries[slot];
+    if (entry->hash == 0) {
+        entry->code = strdup(code);
+        if (entry->code == NULL) {
+            return 0;
+        }
+        entry->hash = hash;
+        table->used++;
+    }
+    entry->count += count;
+    return 1;
+}
+
+/*
+ * freeCensusTable - Release a census table and its codes
+ */
+static void freeCensusTable(struct CensusTable *table) {
+    for (size_t i = 0; i < table->capacity; i++) {
+        free(table->entries[i].code);
+    }
+    free(table->entries);
+    table->entries = NULL;
+    table->capacity = table->used = 0;
+}
+
+/*
+ * removeEscapees - Count and remove the spaceships near the edge
+ *
+ * A spaceship leaving the soup would wrap around the torus and crash
+ * into the debris from behind. Once it reaches the outer CENSUS_BORDER
+ * cells it is far from everything else, so it is named there and taken
+ * off the board. Anything else near the edge is left alone.
+ *
+ * Returns:
+ *   1 if anything was removed
+ */
+static int removeEscapees(struct CensusWorker *worker) {
+    uint64_t (*board)[CENSUS_WORDS] = worker->board[worker->current];
+    const uint64_t firstColumns = (UINT64_C(1) << CENSUS_BORDER) - 1;
+    const uint64_t lastColumns = firstColumns << (WORD_BITS - CENSUS_BORDER);
+    int removed = 0;
+
+    memcpy(worker->mask, board, sizeof worker->mask);
+    for (int y = 0; y < CENSUS_SIZE; y++) {
+        int edgeRow = y < CENSUS_BORDER || y >= CENSUS_SIZE - CENSUS_BORDER;
+        for (int i = 0; i < CENSUS_WORDS; i++) {
+            uint64_t edge = edgeRow ? ~UINT64_C(0)
+                          : (i == 0 ? firstColumns : 0) | (i == CENSUS_WORDS - 1 ? lastColumns : 0);
+            uint64_t found;
+            while ((found = worker->mask[y][i] & edge) != 0) {
+                int x = i * WORD_BITS + __builtin_ctzll(found);
+                int count = collectObject(worker->mask, worker->queue, x, y, x, y, 2);
+                for (int c = 0; c < count; c++) {
+                    worker->objectCells[2 * c] = worker->queue[4 * c + 2];
+                    worker->objectCells[2 * c + 1] = worker->queue[4 * c + 3];
+                }
+                if (!classifyObject(worker, count) || strncmp(worker->code, "xq", 2) != 0) {
+                    continue;
+                }
+                if (!censusAdd(&worker->table, worker->code, 1)) {
+                    worker->failed = 1;
+                    return removed;
+                }
+                for (int c = 0; c < count; c++) {
+                    int cx = worker->queue[4 * c];
+                    board[worker->queue[4 * c + 1]][cx / WORD_BITS] &= ~(UINT64_C(1) << (cx % WORD_BITS));
+                }
+                removed = 1;
+            }
+        }
+    }
+    return removed;
+}
+
+/*
+ * partsIndependent - Whether two parts of a group leave each other alone
+ *
+ * Runs the two parts together and each on its own. As long as together
+ * they are just the two on their own laid over each other, neither has
+ * changed anything about the other.
+ *
+ * Parameters:
+ *   a, b        - The parts, in worker->partStart
+ *   generations - How long to watch them, at most CENSUS_MAX_PERIOD
+ *
+ * Returns:
+ *   1 if they never affect each other, 0 if they do or are too big to run
+ */
+static int partsIndependent(struct CensusWorker *worker, int a, int b, int generations) {
+    const int *boxA = worker->partBox + 4 * a;
+    const int *boxB = worker->partBox + 4 * b;
+    int xMin = boxA[0] < boxB[0] ? boxA[0] : boxB[0];
+    int yMin = boxA[1] < boxB[1] ? boxA[1] : boxB[1];
+    int xMax = boxA[2] > boxB[2] ? boxA[2] : boxB[2];
+    int yMax = boxA[3] > boxB[3] ? boxA[3] : boxB[3];
+    if (xMax - xMin + 1 > CENSUS_OBJECT_MAX || yMax - yMin + 1 > CENSUS_OBJECT_MAX) {
+        return 0;
+    }
+
+    const int margin = CENSUS_MAX_PERIOD + 2;
+    const int *cellsA = worker->partCells + 2 * worker->partStart[a];
+    const int *cellsB = worker->partCells + 2 * worker->partStart[b];
+    int countA = worker->partStart[a + 1] - worker->partStart[a];
+    int countB = worker->partStart[b + 1] - worker->partStart[b];
+    struct CensusPlane *both = &worker->plane[0];
+    struct CensusPlane *alone = &worker->plane[1];
+    struct CensusPlane *other = &worker->plane[2];
+    planeClear(both);
+    planeClear(alone);
+    planeClear(other);
+    planePlace(both, cellsA, countA, margin - xMin, margin - yMin);
+    planePlace(both, cellsB, countB, margin - xMin, margin - yMin);
+    planePlace(alone, cellsA, countA, margin - xMin, margin - yMin);
+    planePlace(other, cellsB, countB, margin - xMin, margin - yMin);
+    for (int t = 0; t < generations; t++) {
+        if (!planeStep(both) || !planeStep(alone) || !planeStep(other) || !planeOverlays(both, alone, other)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Root of part k in the union-find of worker->partGroup
+static int partRoot(int *group, int k) {
+    while (group[k] != k) {
+        group[k] = group[group[k]];
+        k = group[k];
+    }
+    return k;
+}
+
+// Bounding box of count cells, unwrapped x, y each
+static void cellBox(const int *cells, int count, int *box) {
+    box[0] = box[1] = INT_MAX;
+    box[2] = box[3] = INT_MIN;
+    for (int i = 0; i < count; i++) {
+        box[0] = cells[2 * i] < box[0] ? cells[2 * i] : box[0];
+        box[1] = cells[2 * i + 1] < box[1] ? cells[2 * i + 1] : box[1];
+        box[2] = cells[2 * i] > box[2] ? cells[2 * i] : box[2];
+        box[3] = cells[2 * i + 1] > box[3] ? cells[2 * i + 1] : box[3];
+    }
+}
+
+/*
+ * splitPart - Split a still life into the still lifes it is made of
+ *
+ * Still lifes may touch and still each be stable on their own: a pseudo
+ * still life such as two tubs corner to corner. Cells that share a side
+ * are taken to belong together, and so is a cell with just two live
+ * neighbours and both of them, since it needs both to stay alive. If
+ * that cuts the part into pieces that are each stable on their own,
+ * each piece becomes a part.
+ *
+ * Parameters:
+ *   first - The part, the last in worker->partStart
+ *
+ * Returns:
+ *   The number of parts after it
+ */
+static int splitPart(struct CensusWorker *worker, int first) {
+    int *start = worker->partStart;
+    int begin = start[first];
+    int count = start[first + 1] - begin;
+    const int *cells = worker->partCells + 2 * begin;
+    if (count > CENSUS_PSEUDO_MAX) {
+        return first + 1;
+    }
+
+    // Union-find over the cells, then where each piece starts; partQueue
+    // is free at this point
+    int *link = worker->partQueue;
+    int *pieceStart = worker->partQueue + count;
+    for (int i = 0; i < count; i++) {
+        link[i] = i;
+    }
+    for (int i = 0; i < count; i++) {
+        int neighbors = 0;
+        int needed[2] = { i, i };
+        for (int j = 0; j < count; j++) {
+            int dx = cells[2 * j] - cells[2 * i];
+            int dy = cells[2 * j + 1] - cells[2 * i + 1];
+            if (j == i || dx < -1 || dx > 1 || dy < -1 || dy > 1) {
+                continue;
+            }
+            if (neighbors < 2) {
+                needed[neighbors] = j;
+            }
+            neighbors++;
+            if (dx == 0 || dy == 0) {
+                link[partRoot(link, j)] = partRoot(link, i);
+            }
+        }
+        if (neighbors == 2) {
+            link[partRoot(link, needed[0])] = partRoot(link, i);
+            link[partRoot(link, needed[1])] = partRoot(link, i);
+        }
+    }
+
+    // Gather each piece's cells, and check it is stable alone
+    const int margin = CENSUS_MAX_PERIOD + 2;
+    struct CensusPlane *plane = &worker->plane[0];
+    struct CensusPlane *before = &worker->plane[1];
+    struct CensusPlane *empty = &worker->plane[2];
+    int pieces = 0;
+    int gathered = 0;
+    planeClear(empty);
+    for (int r = 0; r < count; r++) {
+        if (partRoot(link, r) != r) {
+            continue;
+        }
+        pieceStart[pieces] = gathered;
+        for (int i = 0; i < count; i++) {
+            if (partRoot(link, i) == r) {
+                worker->objectCells[2 * gathered] = cells[2 * i];
+                worker->objectCells[2 * gathered + 1] = cells[2 * i + 1];
+                gathered++;
+            }
+        }
+        const int *pieceCells = worker->objectCells + 2 * pieceStart[pieces];
+        int box[4];
+        cellBox(pieceCells, gathered - pieceStart[pieces], box);
+        planeClear(plane);
+        planeClear(before);
+        planePlace(plane, pieceCells, gathered - pieceStart[pieces], margin - box[0], margin - box[1]);
+        planePlace(before, pieceCells, gathered - pieceStart[pieces], margin - box[0], margin - box[1]);
+        if (!planeStep(plane) || !planeOverlays(plane, before, empty)) {
+            return first + 1;
+        }
+        pieces++;
+    }
+    if (pieces == 1) {
+        return first + 1;
+    }
+
+    memcpy(worker->partCells + 2 * begin, worker->objectCells, sizeof(int) * 2 * (size_t)count);
+    for (int k = 0; k < pieces; k++) {
+        start[first + k] = begin + pieceStart[k];
+    }
+    start[first + pieces] = begin + count;
+    for (int k = 0; k < pieces; k++) {
+        cellBox(worker->partCells + 2 * start[first + k], start[first + k + 1] - start[first + k],
+                worker->partBox + 4 * (first + k));
+        worker->partGroup[first + k] = first + k;
+    }
+    return first + pieces;
+}
+
+/*
+ * keepCode - Add worker->code to the objects settleSoup has named
+ *
+ * Returns:
+ *   1 on success, 0 if memory ran out
+ */
+static int keepCode(struct CensusWorker *worker) {
+    if (worker->numCodes == worker->codeCapacity) {
+        size_t capacity = worker->codeCapacity == 0 ? 16 : 2 * worker->codeCapacity;
+        char **grown = realloc(worker->codes, capacity * sizeof(char *));
+        if (grown == NULL) {
+            worker->failed = 1;
+            return 0;
+        }
+        worker->codes = grown;
+        worker->codeCapacity = capacity;
+    }
+    worker->codes[worker->numCodes] = strdup(worker->code);
+    if (worker->codes[worker->numCodes] == NULL) {
+        worker->failed = 1;
+        return 0;
+    }
+    worker->numCodes++;
+    return 1;
+}
+
+/*
+ * nameGroup - Name the objects in one group of cells from settleSoup
+ *
+ * Cells up to two apart form a group, so the parts of an object that do
+ * not touch, like the two halves of a beacon, stay together. But so do
+ * still lifes and oscillators that merely sit close to each other. The
+ * group is cut into parts of cells that touch, still lifes among them
+ * into the still lifes they are made of, and parts come back together
+ * only if they affect each other when run side by side. Each of the
+ * objects left is named from its cells in the current generation.
+ *
+ * Parameters:
+ *   count       - Cells in worker->queue, from collectObject
+ *   generations - How long parts are run side by side, at most
+ *                 CENSUS_MAX_PERIOD
+ *
+ * Returns:
+ *   1 with the codes added by keepCode, 0 if an object could not be named
+ *   or memory ran out
+ */
+static int nameGroup(struct CensusWorker *worker, int count, int generations) {
+    const int *group = worker->queue;
+    int *start = worker->partStart;
+    int parts = 0;
+    int cells = 0;
+
+    for (int c = 0; c < count; c++) {
+        int x = group[4 * c];
+        worker->partMask[group[4 * c + 1]][x / WORD_BITS] |= UINT64_C(1) << (x % WORD_BITS);
+    }
+    for (int c = 0; c < count; c++) {
+        const int *first = group + 4 * c;
+        if (!(worker->partMask[first[1]][first[0] / WORD_BITS] & (UINT64_C(1) << (first[0] % WORD_BITS)))) {
+            continue;
+        }
+        int size = collectObject(worker->partMask, worker->partQueue, first[0], first[1], first[2], first[3], 1);
+        int *box = worker->partBox + 4 * parts;
+        box[0] = box[1] = INT_MAX;
+        box[2] = box[3] = INT_MIN;
+        start[parts] = cells;
+        for (int i = 0; i < size; i++) {
+            const int *cell = worker->partQueue + 4 * i;
+            box[0] = cell[2] < box[0] ? cell[2] : box[0];
+            box[1] = cell[3] < box[1] ? cell[3] : box[1];
+            box[2] = cell[2] > box[2] ? cell[2] : box[2];
+            box[3] = cell[3] > box[3] ? cell[3] : box[3];
+            if (censusCell(worker->board[worker->current], cell[0], cell[1])) {
+                worker->partCells[2 * cells] = cell[2];
+                worker->partCells[2 * cells + 1] = cell[3];
+                cells++;
+            }
+        }
+        if (cells == start[parts]) {
+            continue;   // Only sparks that have died out since
+        }
+        worker->partGroup[parts] = parts;
+        start[++parts] = cells;
+        // Alive all along: a still life. One made of others has two of at
+        // least 4 cells each
+        if (cells - start[parts - 1] == size && size >= 8) {
+            parts = splitPart(worker, parts - 1);
+        }
+    }
+
+    for (int a = 0; a < parts; a++) {
+        for (int b = a + 1; b < parts; b++) {
+            // Parts more than two cells apart over every phase never touch
+            const int *boxA = worker->partBox + 4 * a;
+            const int *boxB = worker->partBox + 4 * b;
+            if (boxA[0] - 2 > boxB[2] || boxB[0] - 2 > boxA[2] || boxA[1] - 2 > boxB[3] || boxB[1] - 2 > boxA[3]) {
+                continue;
+            }
+            int rootA = partRoot(worker->partGroup, a);
+            int rootB = partRoot(worker->partGroup, b);
+            if (rootA != rootB && !partsIndependent(worker, a, b, generations)) {
+                worker->partGroup[rootB] = rootA;
+            }
+        }
+    }
+
+    for (int r = 0; r < parts; r++) {
+        if (partRoot(worker->partGroup, r) != r) {
+            continue;
+        }
+        int objectCount = 0;
+        for (int p = 0; p < parts; p++) {
+            if (partRoot(worker->partGroup, p) == r) {
+                memcpy(worker->objectCells + 2 * objectCount, worker->partCells + 2 * start[p],
+                       sizeof(int) * 2 * (size_t)(start[p + 1] - start[p]));
+                objectCount += start[p + 1] - start[p];
+            }
+        }
+        if (!classifyObject(worker, objectCount) || !keepCode(worker)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * settleSoup - Census a soup whose population has started to repeat
+ *
+ * Runs the board on for at least one more period, marking every cell
+ * that is alive at some point. The marked cells fall into groups, which
+ * nameGroup splits into objects. Only if every object can be named is
+ * the soup done; its objects then go into the worker's table.
+ *
+ * Parameters:
+ *   period     - The period of the population
+ *   generation - The board's generation, advanced here
+ *
+ * Returns:
+ *   1 if the soup is done, 0 if it must run on
+ */
+static int settleSoup(struct CensusWorker *worker, int period, int *generation) {
+    int steps = period > 8 ? period : 8;
+    memcpy(worker->mask, worker->board[worker->current], sizeof worker->mask);
+    for (int t = 0; t < steps; t++) {
+        worker->population[++*generation % CENSUS_HISTORY] = censusStep(worker);
+        const uint64_t (*board)[CENSUS_WORDS] = (const uint64_t (*)[CENSUS_WORDS])worker->board[worker->current];
+        for (int y = 0; y < CENSUS_SIZE; y++) {
+            for (int i = 0; i < CENSUS_WORDS; i++) {
+                worker->mask[y][i] |= board[y][i];
+            }
+        }
+    }
+
+    // Name every object first: the soup may not be settled after all
+    int settled = 1;
+    for (int y = 0; y < CENSUS_SIZE && settled; y++) {
+        for (int i = 0; i < CENSUS_WORDS && settled; i++) {
+            while (settled && worker->mask[y][i] != 0) {
+                int x = i * WORD_BITS + __builtin_ctzll(worker->mask[y][i]);
+                settled = nameGroup(worker, collectObject(worker->mask, worker->queue, x, y, x, y, 2), steps);
+            }
+        }
+    }
+
+    for (size_t c = 0; c < worker->numCodes; c++) {
+        if (settled && !censusAdd(&worker->table, worker->codes[c], 1)) {
+            worker->failed = 1;
+        }
+        free(worker->codes[c]);
+    }
+    worker->numCodes = 0;
+    return settled;
+}
+
+/*
+ * runSoup - Run one soup until it settles and census what is left
+ */
+static void runSoup(struct CensusWorker *worker, unsigned long long soup) {
+    seedSoup(worker, soup);
+    int generation = 0;
+    worker->population[0] = censusRecount(worker);
+
+    while (!worker->failed) {
+        if (generation >= CENSUS_MAX_GENERATIONS) {
+            worker->unsettled++;
+            return;
+        }
+        uint32_t population = censusStep(worker);
+        worker->population[++generation % CENSUS_HISTORY] = population;
+        if (population == 0) {
+            return;     // Died out: nothing to count
+        }
+
+        // Every 32 generations a spaceship moves at most 32 cells, well
+        // inside the border on both sides
+        if (generation % 32 == 0) {
+            if (removeEscapees(worker)) {
+                worker->population[generation % CENSUS_HISTORY] = censusRecount(worker);
+            }
+            int period = censusPeriod(worker, generation);
+            if (period > 0 && settleSoup(worker, period, &generation)) {
+                return;
+            }
+        }
+    }
+}
+
+/*
+ * censusMain - Body of each census thread
+ *
+ * Takes soups from censusNextSoup a batch at a time until all are done.
+ * Worker 0 is the main thread.
+ */
+static void *censusMain(void *arg) {
+    struct CensusWorker *worker = arg;
+    if (worker->index > 0) {
+        char name[32];
+        snprintf(name, sizeof name, "census %d", worker->index);
+        traceThread(name);
+    }
+
+    while (!worker->failed) {
+        unsigned long long first = atomic_fetch_add(&censusNextSoup, CENSUS_BATCH);
+        if (first >= censusSoups) {
+            break;
+        }
+        unsigned long long last = first + CENSUS_BATCH < censusSoups ? first + CENSUS_BATCH : censusSoups;
+        for (unsigned long long soup = first; soup < last && !worker->failed; soup++) {
+            uint64_t traceStart = traceBegin();
+            runSoup(worker, soup);
+            traceEnd(TRACE_SOUP, traceStart, (int)(soup & INT_MAX));
+            worker->soups++;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * compareCensusEntries - qsort order of the census: most common first
+ */
+static int compareCensusEntries(const void *a, const void *b) {
+    const struct CensusEntry *left = a;
+    const struct CensusEntry *right = b;
+    if (left->count != right->count) {
+        return left->count > right->count ? -1 : 1;
+    }
+    return strcmp(left->code, right->code);
+}
+
+/*
+ * freeCensusWorker - Release one census thread's memory
+ */
+static void freeCensusWorker(struct CensusWorker *worker) {
+    if (worker == NULL) {
+        return;
+    }
+    free(worker->queue);
+    free(worker->partQueue);
+    free(worker->partStart);
+    free(worker->partCells);
+    free(worker->partBox);
+    free(worker->partGroup);
+    free(worker->objectCells);
+    for (int p = 0; p < 3; p++) {
+        free(worker->plane[p].cells[0]);
+        free(worker->plane[p].cells[1]);
+    }
+    free(worker->firstPhase);
+    for (int s = 0; worker->shapes != NULL && s < CENSUS_SHAPES; s++) {
+        free(worker->shapes[s].code);
+    }
+    free(worker->shapes);
+    free(worker->codes);
+    freeCensusTable(&worker->table);
+    free(worker);
+}
+
+/*
+ * runCensus - Run soups on every thread and print what they left behind
+ *
+ * Each of the --threads threads keeps its own census table, so counting
+ * takes no lock; the tables are merged once all soups are done.
+ *
+ * Parameters:
+ *   soups - How many soups to run
+ *   seed  - Where the soups' random streams start
+ *
+ * Returns:
+ *   1 on success, 0 if memory ran out or a thread could not start
+ */
+int runCensus(unsigned long long soups, unsigned int seed) {
+    struct CensusWorker **census = calloc((size_t)numThreads, sizeof(struct CensusWorker *));
+    pthread_t *threads = calloc((size_t)numThreads, sizeof(pthread_t));
+    int ok = census != NULL && threads != NULL;
+
+    for (int t = 0; t < numThreads && ok; t++) {
+        struct CensusWorker *worker = calloc(1, sizeof(struct CensusWorker));
+        census[t] = worker;
+        ok = worker != NULL;
+        if (ok) {
+            worker->index = t;
+            worker->queue = malloc(sizeof(int) * 4 * CENSUS_SIZE * CENSUS_SIZE);
+            worker->partQueue = malloc(sizeof(int) * 4 * CENSUS_SIZE * CENSUS_SIZE);
+            worker->partStart = malloc(sizeof(int) * (CENSUS_SIZE * CENSUS_SIZE + 1));
+            worker->partCells = malloc(sizeof(int) * 2 * CENSUS_SIZE * CENSUS_SIZE);
+            worker->partBox = malloc(sizeof(int) * 4 * CENSUS_SIZE * CENSUS_SIZE);
+            worker->partGroup = malloc(sizeof(int) * CENSUS_SIZE * CENSUS_SIZE);
+            worker->objectCells = malloc(sizeof(int) * 2 * CENSUS_SIZE * CENSUS_SIZE);
+            worker->firstPhase = malloc((size_t)CENSUS_OBJECT_MAX * CENSUS_OBJECT_MAX);
+            worker->shapes = calloc(CENSUS_SHAPES, sizeof(struct CensusShape));
+            ok = worker->queue != NULL && worker->partQueue != NULL && worker->partStart != NULL
+              && worker->partCells != NULL && worker->partBox != NULL && worker->partGroup != NULL
+              && worker->objectCells != NULL && worker->firstPhase != NULL && worker->shapes != NULL;
+            // Planes start out empty; after that planeClear keeps them so
+            for (int p = 0; p < 3 && ok; p++) {
+                for (int b = 0; b < 2 && ok; b++) {
+                    worker->plane[p].cells[b] = calloc((size_t)CENSUS_PLANE * CENSUS_PLANE, 1);
+                    ok = worker->plane[p].cells[b] != NULL;
+                    worker->plane[p].dirty[b][0] = worker->plane[p].dirty[b][1] = CENSUS_PLANE;
+                    worker->plane[p].dirty[b][2] = worker->plane[p].dirty[b][3] = -1;
+                }
+            }
+        }
+    }
+    if (!ok) {
+        fprintf(stderr, "Out of memory for the census\n");
+    }
+
+    censusStep = censusStepPlain;
+#ifdef HAVE_X86_SIMD
+    // Every CPU at the AVX2 level also has POPCNT
+    if (detectCpuLevel() >= CPU_AVX2) {
+        censusStep = censusStepPopcnt;
+    }
+#endif
+    censusSoups = soups;
+    censusSeed = seed;
+    atomic_store(&censusNextSoup, 0);
+    int started = 1;
+    double start = monotonicSeconds();
+    for (; started < numThreads && ok; started++) {
+        if (pthread_create(&threads[started], NULL, censusMain, census[started]) != 0) {
+            fprintf(stderr, "Could not start census thread %d\n", started);
+            ok = 0;
+            break;
+        }
+    }
+    if (ok) {
+        censusMain(census[0]);
+    } else {
+        // Let the threads already running finish the soups
+        atomic_store(&censusNextSoup, soups);
+    }
+    for (int t = 1; t < started; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    double seconds = monotonicSeconds() - start;
+
+    // Merge the threads' tables
+    struct CensusTable total = { NULL, 0, 0 };
+    unsigned long long done = 0;
+    unsigned long long unsettled = 0;
+    for (int t = 0; t < numThreads && ok; t++) {
+        struct CensusWorker *worker = census[t];
+        ok = !worker->failed;
+        done += worker->soups;
+        unsettled += worker->unsettled;
+        for (size_t i = 0; i < worker->table.capacity && ok; i++) {
+            const struct CensusEntry *entry = &worker->table.entries[i];
+            ok = entry->hash == 0 || censusAdd(&total, entry->code, entry->count);
+        }
+    }
+
+    if (ok) {
+        // Pack the used slots to the front and sort them
+        size_t kinds = 0;
+        unsigned long long objects = 0;
+        for (size_t i = 0; i < total.capacity; i++) {
+            if (total.entries[i].hash != 0) {
+                objects += total.entries[i].count;
+                total.entries[kinds++] = total.entries[i];
+            }
+        }
+        for (size_t i = kinds; i < total.capacity; i++) {
+            total.entries[i].hash = 0;
+            total.entries[i].code = NULL;
+        }
+        if (kinds > 0) {
+            qsort(total.entries, kinds, sizeof(struct CensusEntry), compareCensusEntries);
+        }
+
+        printf("Census:         %llu soups of %dx%d, seed %u, %d thread%s\n", done, censusSoupSize,
+               censusSoupSize, seed, numThreads, numThreads == 1 ? "" : "s");
+        if (lifeRule != CONWAY_RULE) {
+            printf("Rule:           %s\n", ruleText);
+        }
+        printf("Wall time:      %.3f s\n", seconds);
+        printf("Soups/s:        %.1f\n", (double)done / seconds);
+        printf("Objects:        %llu, %zu kinds\n", objects, kinds);
+        if (unsettled > 0) {
+            printf("Unsettled:      %llu soups after %d generations\n", unsettled, CENSUS_MAX_GENERATIONS);
+        }
+        printf("\n%12s  %s\n", "count", "object");
+        for (size_t i = 0; i < kinds; i++) {
+            printf("%12llu  %s\n", total.entries[i].count, total.entries[i].code);
+        }
+    } else if (census != NULL && threads != NULL) {
+        fprintf(stderr, "Out of memory for the census\n");
+    }
+
+    freeCensusTable(&total);
+    for (int t = 0; census != NULL && t < numThreads; t++) {
+        freeCensusWorker(census[t]);
+    }
+    free(census);
+    free(threads);
+    return ok;
 }